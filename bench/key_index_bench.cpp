@@ -0,0 +1,114 @@
+/**
+ * Micro-benchmark for KeyIndex block lookup.
+ *
+ * Compares the baseline (std::upper_bound over std::vector<std::string>)
+ * against KeyIndex fingerprint search with every kernel the CPU supports.
+ * Keys follow the shapes used by the store ("key<N>", "user:<8 digits>").
+ *
+ * Build with optimizations for meaningful numbers:
+ *   cmake -S . -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build
+ *   ./build/bin/key_index_bench
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "kv/key_index.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kQueries = 1 << 20;
+
+std::vector<std::string> makeKeys(const std::string& shape, size_t n) {
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    char buf[32];
+    for (size_t i = 0; i < n; ++i) {
+        if (shape == "user") {
+            std::snprintf(buf, sizeof(buf), "user:%08zu", i * 7);
+            keys.emplace_back(buf);
+        } else {
+            keys.push_back("key" + std::to_string(i * 7));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+// Keep the optimizer from discarding results
+volatile uint64_t g_sink = 0;
+
+template <typename Fn>
+double nsPerOp(Fn&& fn) {
+    auto start = Clock::now();
+    uint64_t acc = 0;
+    for (size_t i = 0; i < kQueries; ++i) {
+        acc += fn(i);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    g_sink = g_sink + acc;
+    return elapsed / kQueries;
+}
+
+void benchShape(const std::string& shape, size_t indexed_keys) {
+    // Indexed keys are every kIndexInterval-th key of the table
+    std::vector<std::string> table = makeKeys(shape, indexed_keys * kv::KeyIndex::kIndexInterval);
+    std::vector<std::string> indexed;
+    kv::KeyIndex index;
+    for (size_t i = 0; i < table.size(); i += kv::KeyIndex::kIndexInterval) {
+        indexed.push_back(table[i]);
+        index.add(table[i], i * 32);
+    }
+    index.finish(table.size() * 32);
+
+    std::mt19937_64 rng(42);
+    std::vector<std::string> queries(4096);
+    for (auto& q : queries) {
+        q = table[rng() % table.size()];
+    }
+    const size_t mask = queries.size() - 1;
+
+    double baseline = nsPerOp([&](size_t i) {
+        return static_cast<uint64_t>(std::upper_bound(indexed.begin(), indexed.end(), queries[i & mask]) - indexed.begin());
+    });
+    double keyindex = nsPerOp([&](size_t i) {
+        return index.findBlock(queries[i & mask])->first;
+    });
+
+    std::printf("%-5s %7zu indexed keys | string upper_bound %7.1f ns | KeyIndex(%s) %7.1f ns | %.2fx\n",
+                shape.c_str(), indexed.size(), baseline,
+                kv::searchKernelName(kv::detectSearchKernel()), keyindex, baseline / keyindex);
+
+    // Raw fingerprint kernels on the same array
+    std::vector<uint64_t> fps;
+    for (const auto& key : indexed) {
+        fps.push_back(kv::keyFingerprint(key));
+    }
+    std::vector<uint64_t> targets(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        targets[i] = kv::keyFingerprint(queries[i]);
+    }
+    std::vector<kv::SearchKernel> kernels = {kv::SearchKernel::Scalar};
+    if (kv::detectSearchKernel() != kv::SearchKernel::Scalar) kernels.push_back(kv::SearchKernel::SSE42);
+    if (kv::detectSearchKernel() == kv::SearchKernel::AVX2)   kernels.push_back(kv::SearchKernel::AVX2);
+    for (auto kernel : kernels) {
+        double ns = nsPerOp([&](size_t i) {
+            return kv::countLessThan(fps.data(), fps.size(), targets[i & mask], kernel);
+        });
+        std::printf("      countLessThan %-7s %7.1f ns\n", kv::searchKernelName(kernel), ns);
+    }
+}
+
+} // namespace
+
+int main() {
+    for (size_t n : {64, 1024, 16384}) {
+        benchShape("key", n);
+        benchShape("user", n);
+    }
+    return 0;
+}
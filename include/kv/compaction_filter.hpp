@@ -0,0 +1,80 @@
+/**
+ * @file compaction_filter.hpp
+ * @brief Per-entry hook of compaction, and time-to-live expiry built on it.
+ *
+ * A CompactionFilter sees the live value of every key a compaction rewrites
+ * and decides to keep it, drop it or replace its value. Only the version the
+ * latest state reads is offered; versions still pinned by a snapshot are left
+ * alone, so snapshot reads stay repeatable. A dropped entry becomes a
+ * tombstone unless the compaction is bottommost and nothing older is kept,
+ * so older versions in deeper levels cannot come back.
+ *
+ * With Options::ttl set, KVStore stamps every put() with its write time:
+ * the value is stored as value + kWriteTimeMarker + 10 decimal digits of
+ * Unix seconds (the WAL splits on whitespace, so the stamp has none). The
+ * marker keeps a value that merely ends in ten digits from being taken for a
+ * stamp. Reads strip the stamp and treat expired values as not found;
+ * compaction drops them for good. Values without a stamp never expire. Once a TTL was set the store must
+ * keep it: opened without one, reads return the stamps as part of the values.
+ *
+ * Typical usage:
+ *   class DropTemp : public kv::CompactionFilter {
+ *       const char* name() const override { return "DropTemp"; }
+ *       Decision filter(int, const std::string& key, const std::string&, std::string*) const override {
+ *           return key.rfind("tmp:", 0) == 0 ? Decision::Remove : Decision::Keep;
+ *       }
+ *   };
+ *   kv::Options options;
+ *   options.compaction_filter = std::make_shared<DropTemp>();
+ *   options.ttl = std::chrono::hours(24);
+ *   kv::KVStore store("db", lock_mgr, options);
+ *
+ * Used by:
+ *   - KVStore: stamps writes, hides expired values from get(), multiGet() and iterators
+ *   - Compactor: applies the TTL and the store's filter to every merged key
+ */
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace kv {
+
+class CompactionFilter {
+public:
+    enum class Decision {
+        Keep,
+        Remove,      // Drop the key
+        ChangeValue, // Replace the value by *new_value
+    };
+
+    virtual ~CompactionFilter() = default;
+
+    virtual const char* name() const = 0;
+
+    // Called for the live value of each key, from several compaction threads
+    // at once; level is the level the output goes to. With a TTL, value comes
+    // without its write time stamp and a changed value keeps the old stamp.
+    virtual Decision filter(int level, const std::string& key, const std::string& value,
+                            std::string* new_value) const = 0;
+};
+
+// Byte that opens the write time stamp appended to values of stores with a TTL
+constexpr char kWriteTimeMarker = '\x1f';
+// Width of the stamp: the marker and 10 decimal digits
+constexpr size_t kWriteTimeSize = 11;
+
+// Seconds since the Unix epoch
+uint64_t unixSeconds();
+
+// value followed by its write time stamp
+std::string appendWriteTime(const std::string& value, uint64_t write_time);
+
+// Write time stamp at the end of stored, nullopt if it carries none
+std::optional<uint64_t> writeTime(const std::string& stored);
+
+// Stored value without its stamp; nullopt if it was written ttl or longer before now
+std::optional<std::string> unwrapTtl(const std::string& stored, std::chrono::seconds ttl, uint64_t now);
+
+} // namespace kv
@@ -0,0 +1,114 @@
+/**
+ * @file compaction_picker.hpp
+ * @brief Compaction strategies: which tables to merge next, and where to.
+ *
+ * A CompactionPicker looks at the current Version and either returns the next
+ * CompactionJob or nullopt when the tree already has the shape it wants. The
+ * Compactor only executes jobs, so strategies can be swapped per store.
+ *
+ * Two strategies are built in:
+ *   - Leveled: level 0 takes flushes, deeper levels are disjoint and grow by
+ *     a multiplier. Few tables per lookup and little space overhead, paid
+ *     for by rewriting data once per level (write amplification ~ levels x
+ *     multiplier).
+ *   - Universal (size-tiered): every table stays in level 0 as one sorted
+ *     run. Runs of similar size are merged, and everything is merged once
+ *     the newer runs outgrow the oldest by max_size_amplification_percent.
+ *     Data is rewritten far less often, at the cost of more runs per lookup
+ *     and up to that much extra space.
+ *
+ * Leveled also ranks the tables of a level: read heat (seeks charged by
+ * lookups that probed the table in vain) and tombstone density raise a
+ * table's priority, the bytes it would drag along from the next level lower
+ * it. Once a table used up its seek budget it is compacted even if no level
+ * is over its size budget, so the ranges that slow reads down go first.
+ *
+ * Space amplification is estimated from the version: total bytes over the
+ * bytes of the oldest data (deepest level, or oldest run), roughly what the
+ * tree would shrink to if it were fully compacted.
+ *
+ * Typical usage:
+ *   kv::CompactionOptions options;
+ *   options.style = kv::CompactionStyle::Universal;
+ *   auto picker = kv::newCompactionPicker(options, 4);
+ *   if (auto job = picker->pick(*version)) { ... }
+ *
+ * Used by:
+ *   - Compactor: asks its picker for work after every flush
+ */
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "kv/options.hpp"
+#include "kv/version.hpp"
+
+namespace kv {
+
+// One compaction picked from a version
+struct CompactionJob {
+    int level = 0;                  // Level that was over its budget
+    int output_level = 0;           // Level the merged tables are installed at
+    std::vector<std::string> files; // Inputs, oldest first (breaks merge ties)
+    bool bottommost = true;         // Nothing deeper overlaps, tombstones may go
+    uint64_t target_file_size = UINT64_MAX; // Output rolls to a new table past this size
+    bool read_triggered = false;    // Picked for a table out of seek budget, no level was over budget
+};
+
+class CompactionPicker {
+public:
+    virtual ~CompactionPicker() = default;
+
+    virtual const char* name() const = 0;
+
+    // Next compaction to run, nullopt if the version needs none
+    virtual std::optional<CompactionJob> pick(const Version& version) = 0;
+
+    // Total bytes over the bytes of the oldest data, 1 for an empty version
+    virtual double spaceAmplification(const Version& version) const;
+};
+
+class LeveledCompactionPicker : public CompactionPicker {
+public:
+    // level0_trigger: level 0 table count that triggers compaction into level 1
+    LeveledCompactionPicker(size_t level0_trigger, const CompactionOptions& options);
+
+    const char* name() const override;
+    std::optional<CompactionJob> pick(const Version& version) override;
+
+    // >= 1 means the level needs compaction
+    double levelScore(const Version& version, int level) const;
+    uint64_t maxBytesForLevel(int level) const;
+
+    // How much compacting table out of its level pays off, higher goes first
+    double filePriority(const Version& version, const TableFile& table) const;
+
+private:
+    size_t _level0_trigger;
+    CompactionOptions _options;
+    std::vector<std::string> _compact_pointer; // Per level, max key of the last table compacted out of it
+};
+
+class UniversalCompactionPicker : public CompactionPicker {
+public:
+    // run_trigger: number of sorted runs that triggers compaction
+    UniversalCompactionPicker(size_t run_trigger, const CompactionOptions& options);
+
+    const char* name() const override;
+    std::optional<CompactionJob> pick(const Version& version) override;
+
+private:
+    // Merge runs[0, count) (newest first) into one
+    CompactionJob mergeNewest(const Version& version, const std::vector<std::shared_ptr<TableFile>>& runs,
+                              size_t count) const;
+
+    size_t _run_trigger;
+    CompactionOptions _options;
+};
+
+// Built-in picker for options.style
+std::unique_ptr<CompactionPicker> newCompactionPicker(const CompactionOptions& options, size_t trigger);
+
+} // namespace kv
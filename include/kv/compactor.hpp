@@ -1,47 +1,150 @@
+/*
+ * Compactor
+ * - Linked to a KVStore it runs the jobs of a CompactionPicker after every
+ *   flush: leveled or universal (CompactionOptions::style), or a custom
+ *   picker set before start(). See compaction_picker.hpp for the strategies
+ * - Inputs are read and outputs written without any lock. The SSTable write
+ *   lock is only taken to install the result, so reads and flushes do not
+ *   wait for a running compaction
+ * - Inputs that overlap neither each other nor the output level (typical
+ *   for sequential keys) are moved to it by a MANIFEST edit, not rewritten
+ * - A large compaction is split into disjoint key ranges at block keys of
+ *   its inputs. The subcompactions merge in parallel, each into its own
+ *   output tables, and all outputs are installed with one MANIFEST edit
+ * - Writes (and reads, if it throttles them) through the linked store's
+ *   RateLimiter at low priority, so flushes and foreground reads go first
+ * - Drops expired entries of a store with a TTL and runs the store's
+ *   CompactionFilter on the live value of every key (compaction_filter.hpp)
+ * - Drops versions hidden by range tombstones. A tombstone itself goes once
+ *   no snapshot predates it and every table overlapping its range is newer
+ * - Keeps byte counters, so stats() can report the measured write
+ *   amplification next to the picker's space amplification estimate
+ * - Without a KVStore (plain directory, no level information) it falls back
+ *   to merging the oldest compaction_count files once threshold is reached
+ */
 #pragma once
 #include <string>
 #include <thread>
 #include <atomic>
-#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <vector>
 #include <map>
 #include <cstdint>
+#include <functional>
 #include "kv/lock_manager.hpp"
+#include "kv/io_backend.hpp"
+#include "kv/snapshot.hpp"
+#include "kv/options.hpp"
+#include "kv/version.hpp"
+#include "kv/compaction_picker.hpp"
+#include "kv/rate_limiter.hpp"
+#include "kv/compaction_filter.hpp"
+#include <optional>
 
 namespace kv {
 
 // Forward declaration
 class KVStore;
 
+struct CompactionStats {
+    std::string strategy;            // Picker name
+    uint64_t compactions = 0;
+    uint64_t subcompactions = 0;     // Key ranges merged
+    uint64_t trivial_moves = 0;      // Compactions done by relisting the inputs, part of compactions
+    uint64_t read_compactions = 0;   // Picked for a table out of seek budget, part of compactions
+    uint64_t bytes_read = 0;         // Input tables
+    uint64_t bytes_written = 0;      // Output tables
+    uint64_t bytes_flushed = 0;      // Written by the linked store's flushes
+    uint64_t entries_expired = 0;    // Dropped for their TTL
+    uint64_t entries_filtered = 0;   // Removed by the CompactionFilter
+    double   write_amplification = 1; // (flushed + compaction written) / flushed
+    double   space_amplification = 1; // Picker's estimate for the current version
+};
+
 class Compactor {
 public:
     Compactor(const std::string& data_dir,
-              size_t threshold,        // Compaction trigger threshold - sstable counts
-              size_t compaction_count, // For each round of compaction, compact this cnt of tables
-              std::shared_ptr<LockManager> lock_mgr);
+              size_t threshold,        // Level 0 table (universal: sorted run) count that triggers compaction
+              size_t compaction_count, // Without a KVStore, compact this cnt of oldest tables per round
+              std::shared_ptr<LockManager> lock_mgr,
+              const CompactionOptions& options = CompactionOptions());
     ~Compactor();
 
     void start();
     void stop();
+
+    // Ask the thread to re-check the table count, e.g. after a flush. The
+    // thread sleeps otherwise; a linked KVStore calls this on its own.
+    void notify();
     
     // Set KVStore reference after both objects are constructed (breaks circular dependency)
     void setKVStore(KVStore* kv_store);
 
+    // Replace the built-in picker chosen by CompactionOptions::style; call before start()
+    void setPicker(std::unique_ptr<CompactionPicker> picker);
+
+    CompactionStats stats() const;
+
 private:
     void                run();                    // Compactor trigger function call
-    std::vector<std::string> discoverSSTables();  // Get the list of sstables
-    void                performCompaction(const std::vector<std::string>& sstables); // Meat of compaction
-    // Helper for performCompaction
-    std::map<std::string, std::string> performMultiWayMerge(const std::vector<std::string>& files); // Multi-way merge
+    std::vector<std::string> discoverSSTables();  // Get the list of sstables (no KVStore)
+    bool                performCompaction(const CompactionJob& job); // Meat of compaction, true on success
+
+    // Keys [begin, end) of one subcompaction; empty begin / no end are unbounded
+    struct KeyRange {
+        std::string begin;
+        std::optional<std::string> end;
+    };
+    // Inputs can be relisted at the output level as they are
+    bool                isTrivialMove(const CompactionJob& job) const;
+    bool                performTrivialMove(const CompactionJob& job); // true on success
+    // Split a job at block keys sampled from its inputs, one range if it is small
+    std::vector<KeyRange> splitIntoSubcompactions(const CompactionJob& job) const;
+
+    // Helper for performCompaction: streams the merged entries of range to emit
+    // in SSTable order, returns how many were emitted. Versions hidden by a
+    // range tombstone are left out, live values go through filterEntry(); keys
+    // it removed or changed are appended to rewritten.
+    size_t              performMultiWayMerge(const std::vector<std::string>& files,
+                                             const std::vector<SequenceNumber>& snapshots,
+                                             const FragmentedRangeTombstones& range_tombstones,
+                                             bool bottommost,
+                                             int output_level,
+                                             const KeyRange& range,
+                                             const std::function<void(const Entry&)>& emit, // Multi-way merge
+                                             std::vector<std::string>& rewritten);
+    // Apply the TTL and the compaction filter to a live entry; false if it is to be
+    // removed, *changed is set if its value was replaced
+    bool                filterEntry(Entry& entry, int level, uint64_t now, bool* changed = nullptr);
+    // Remove range tombstones that hide nothing anymore; call without the SSTable write lock
+    void                dropObsoleteRangeTombstones();
     uint64_t            generateNewFileNumber();  // Generate new file number for compacted SSTable
     
     std::string         _data_dir;                // Root path of KV store
     size_t              _trigger_threshold;
     size_t              _compaction_count;
+    CompactionOptions   _options;
+    std::unique_ptr<CompactionPicker> _picker;
     std::thread         _thread;
     std::atomic<bool>   _is_running;
+    std::mutex          _work_mutex;
+    std::condition_variable _work_cv;         // Signalled by notify() and stop()
+    bool                _work_pending;
     std::shared_ptr<LockManager> _lock_mgr;
     KVStore*            _kv_store; // Pointer to KVStore for metadata refresh
+    std::shared_ptr<IoBackend> _io; // Batched reads of merge inputs
+    std::shared_ptr<RateLimiter> _rate_limiter; // The linked store's, nullptr = unthrottled
+    std::shared_ptr<CompactionFilter> _compaction_filter; // The linked store's, nullptr = none
+    std::chrono::seconds _ttl;                  // The linked store's, 0 = no expiry
+    std::atomic<uint64_t> _compactions;
+    std::atomic<uint64_t> _subcompactions;
+    std::atomic<uint64_t> _bytes_read;
+    std::atomic<uint64_t> _bytes_written;
+    std::atomic<uint64_t> _trivial_moves;
+    std::atomic<uint64_t> _read_compactions;
+    std::atomic<uint64_t> _entries_expired;
+    std::atomic<uint64_t> _entries_filtered;
 };
 
 } // namespace kv
\ No newline at end of file
@@ -1,14 +1,39 @@
 /*
  * Flusher
- * - Monitor the active memtable size, and once filled, switch to the new memtable
- * - Meanwhile, freeze the old memtable, then sort it and send to SSTablewriter
- * - Lastly, delete the old WAL, and continue to monitor the next memtable
+ * - Sleep until a writer reports the active memtable full (scheduleFlush), then
+ *   switch to the new memtable; an idle store costs no wakeups at all
+ * - Frozen memtables queue up as flush jobs, numbered in freeze order. A pool
+ *   of workers sorts and writes them to SSTables in parallel, so an ingest
+ *   spike is not limited to one table at a time
+ * - Jobs are installed strictly in freeze order: a worker that finishes early
+ *   waits for the older jobs. The MANIFEST's last sequence therefore never
+ *   covers a write whose table is not live yet (WAL replay relies on that)
+ * - File numbers come from the VersionSet, and each flushed table is logged to
+ *   the MANIFEST, so numbering survives restarts and never reuses a file
+ * - Tell the flush listener (e.g. the compactor) a new SSTable is live
+ * - Within one job the flush is a pipeline: key pointers are sorted on several
+ *   threads, then blocks are encoded ahead of the thread writing the file.
+ *   The cores are shared out between the workers
+ * - At most 2 frozen memtables per worker are queued; beyond that the active
+ *   memtable keeps growing until a job is installed
+ * - A job whose table cannot be written or logged stays readable and is
+ *   retried with backoff, newer jobs wait behind it. Once stopping, it is
+ *   given up after a few attempts and nothing is installed after it: the
+ *   WAL still has the writes and replays them on the next open
  */
 #pragma once
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <vector>
 #include "kv/memtable.hpp"
 #include "kv/sstable_writer.hpp"
 #include "kv/lock_manager.hpp"
+#include "kv/version_set.hpp"
 
 namespace kv {
 
@@ -19,35 +44,86 @@ public:
             std::mutex& immu_table_mutex,
             SSTableWriter& writer,
             uint64_t threshold,
-            std::shared_ptr<LockManager> lock_mgr);
+            std::shared_ptr<LockManager> lock_mgr,
+            std::shared_ptr<VersionSet> versions,
+            size_t num_workers = 1);
     
     ~Flusher();
 
-    // start the monitor thread
+    // start the worker threads
     void start();
     
-    // stop the monitor thread, after current flush done
+    // stop the worker threads, after every frozen memtable is flushed
     void stop();
 
+    // Called by writers once the active memtable reached the threshold
+    void scheduleFlush();
+
+    // Frozen memtables not installed yet, newest first. Readers must check
+    // them before the SSTable version, each is dropped after its install.
+    std::vector<std::shared_ptr<MemTable>> immutableTables();
+
+    // Called after every flushed SSTable is installed
+    void setFlushListener(std::function<void()> listener);
+
+    // Bytes of all SSTables flushed so far
+    uint64_t bytesFlushed() const;
+
 private:
+    struct Job {
+        uint64_t ticket; // Freeze order, also the install order
+        std::shared_ptr<MemTable> table;
+    };
+
     void run();
 
+    // Freeze the active memtable if it is full and the queue has room, true if it was
+    bool switchIfFull();
+
+    // Write one sorted memtable as a new SSTable, the edit that installs it
+    // or nullopt on failure; file_size is set to the bytes written
+    std::optional<VersionEdit> writeTable(const MemTable& table, uint64_t& file_size);
+
+    static constexpr int kStopRetries = 3;
+    static constexpr std::chrono::milliseconds kRetryDelay{10};
+    static constexpr std::chrono::milliseconds kMaxRetryDelay{1000};
+
+    // Log the edit to the MANIFEST once every older job is installed, then
+    // drop the job's memtable from the read path. False if the job is still
+    // to be done: the edit is missing or could not be logged. file_size
+    // counts towards flushedBytes() once the table is installed.
+    bool installInOrder(const Job& job, const std::optional<VersionEdit>& edit, uint64_t file_size);
+
     std::shared_ptr<MemTable>& active_table;
     std::mutex& active_table_mutex;
 
     SSTableWriter& writer;
     uint64_t threshold; // threshold to switch table
 
-    std::thread bg_flusher_thread;
-    std::atomic<bool> running; // current state of thread running
+    size_t num_workers;
+    size_t pipeline_threads; // Sort/encode threads per job
+    std::vector<std::thread> workers;
+    std::atomic<bool> running; // current state of the workers
 
-    std::shared_ptr<MemTable> immutable_table;
+    std::deque<std::shared_ptr<MemTable>> immutable_tables; // Oldest first
     std::mutex& immu_table_mutex;
-    std::condition_variable immu_cv;
 
-    std::atomic<uint64_t> next_file_number;
+    std::mutex work_mutex;
+    std::condition_variable work_cv; // Signalled by scheduleFlush(), stop() and installs
+    bool flush_requested;
+    std::deque<Job> pending_jobs;    // Frozen, not picked up by a worker yet
+    uint64_t next_ticket;            // Given to the next frozen memtable
+    uint64_t next_install;           // Ticket allowed to install next
+    bool failed;                     // A job was given up while stopping, nothing installs after it
+
+    std::atomic<uint64_t> bytes_flushed;
+
+    std::mutex listener_mutex;
+    std::function<void()> flush_listener;
+
+    std::shared_ptr<VersionSet> versions;
 
     std::shared_ptr<LockManager> lock_mgr;
 };
 
-}
\ No newline at end of file
+}
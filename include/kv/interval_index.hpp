@@ -0,0 +1,62 @@
+/**
+ * @file interval_index.hpp
+ * @brief Stabbing-query index over SSTable [min_key, max_key] ranges.
+ *
+ * IntervalIndex is a static centered interval tree. Each node holds a center
+ * key and the intervals that contain it, kept twice: sorted by low key
+ * ascending and by high key descending. Intervals entirely left or right of
+ * the center go to the child subtrees. A point query walks one root-to-leaf
+ * path and only scans intervals that actually contain the key, so it costs
+ * O(log n + k) instead of testing all n ranges.
+ *
+ * Interval ids are the table positions in Version::tables (newest
+ * first), so returning ids in ascending order returns tables in recency order.
+ *
+ * Typical usage:
+ *   kv::IntervalIndex index;
+ *   index.build({{"a", "f", 0}, {"d", "k", 1}});
+ *   auto ids = index.find("e");  // -> {0, 1}
+ *
+ * Used by:
+ *   - Version: to find candidate tables for get(), built with each Version
+ */
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace kv {
+
+class IntervalIndex {
+public:
+    struct Interval {
+        std::string low;
+        std::string high;
+        size_t      id;
+    };
+
+    // Replace the index contents
+    void build(std::vector<Interval> intervals);
+
+    // Ids of all intervals with low <= key <= high, ascending
+    std::vector<size_t> find(const std::string& key) const;
+
+    size_t size() const;
+
+private:
+    struct Node {
+        std::string         center;
+        std::vector<size_t> by_low;  // Intervals containing center, low ascending
+        std::vector<size_t> by_high; // Same intervals, high descending
+        int                 left = -1;
+        int                 right = -1;
+    };
+
+    int buildNode(std::vector<size_t> items);
+
+    std::vector<Interval> _intervals;
+    std::vector<Node>     _nodes;
+    int                   _root = -1;
+};
+
+} // namespace kv
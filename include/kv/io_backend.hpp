@@ -0,0 +1,61 @@
+/**
+ * @file io_backend.hpp
+ * @brief Batched positional reads for SSTable I/O.
+ *
+ * Callers describe a batch of (fd, offset, length) reads and hand the whole
+ * batch to readBatch(), which returns once every read has completed. This
+ * keeps many reads in flight at once instead of one blocking read at a time.
+ *
+ * Two backends exist:
+ *   - io_uring: all reads of a batch are queued in the submission ring and
+ *     submitted with a single io_uring_enter() call (Linux only). Batches
+ *     issued concurrently each take their own ring from a pool, so callers
+ *     never wait for one another's I/O
+ *   - pread: blocking pread() calls spread over a few threads; used when
+ *     io_uring is not compiled in or the kernel refuses io_uring_setup()
+ *
+ * Typical usage:
+ *   auto io = kv::IoBackend::create();
+ *   std::vector<kv::ReadRequest> batch = {{fd, 0, 4096}, {fd, 8192, 4096}};
+ *   io->readBatch(batch);  // batch[i].data / batch[i].ok are filled in
+ *
+ * Used by:
+ *   - SSTableReader: block reads for get() and multiGet()
+ *   - Compactor: filling the read buffers of all merge inputs
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kv {
+
+struct ReadRequest {
+    int         fd;
+    uint64_t    offset;
+    size_t      length;
+    std::string data;      // Bytes read, sized to length on success
+    bool        ok = false;
+};
+
+class IoBackend {
+public:
+    static constexpr unsigned kDefaultQueueDepth = 64;
+
+    virtual ~IoBackend() = default;
+
+    // Issue every request of the batch and wait for all of them
+    virtual void readBatch(std::vector<ReadRequest>& requests) = 0;
+
+    virtual const char* name() const = 0;
+
+    // io_uring if available, otherwise the pread fallback
+    static std::shared_ptr<IoBackend> create(unsigned queue_depth = kDefaultQueueDepth);
+
+    // Always the blocking pread backend
+    static std::shared_ptr<IoBackend> createPread();
+};
+
+} // namespace kv
@@ -0,0 +1,94 @@
+/**
+ * @file key_index.hpp
+ * @brief Sparse in-memory key index over one SSTable, searched with SIMD.
+ *
+ * KeyIndex remembers every kIndexInterval-th key of an SSTable together with
+ * its byte offset. The records between two indexed keys form a "block", so a
+ * point lookup only has to read and scan one block instead of the whole file.
+ *
+ * Keys are not compared as std::string on the hot path. After the index is
+ * finished, the prefix shared by all indexed keys is stripped and the next 8
+ * bytes of every key are packed big-endian into a uint64_t "fingerprint".
+ * Comparing fingerprints as unsigned integers gives the same order as
+ * comparing the key bytes, so the search runs over a flat uint64_t array with
+ * SSE4.2 / AVX2 kernels (selected at runtime, scalar fallback elsewhere). Only
+ * keys whose fingerprints tie fall back to a full string compare.
+ *
+ * Typical usage:
+ *   kv::KeyIndex index;
+ *   index.add("apple", 0);  index.add("melon", 512);  // sorted, every N keys
+ *   index.finish(file_size);
+ *   auto block = index.findBlock("banana");           // -> [0, 512)
+ *
+ * Used by:
+ *   - SSTableReader: to jump straight to the block that may hold a key
+ *   - Iterator: to seek and step backwards inside an SSTable
+ *   - Compactor: block keys as subcompaction boundaries
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace kv {
+
+// SIMD kernel used to search fingerprint arrays
+enum class SearchKernel {
+    Scalar,
+    SSE42,
+    AVX2
+};
+
+// Best kernel supported by the running CPU
+SearchKernel detectSearchKernel();
+const char*  searchKernelName(SearchKernel kernel);
+
+// Pack the first 8 bytes of key (starting at skip) big-endian, zero padded
+uint64_t keyFingerprint(std::string_view key, size_t skip = 0);
+
+// Number of entries in the sorted array fps[0, n) that are < target
+size_t countLessThan(const uint64_t* fps, size_t n, uint64_t target, SearchKernel kernel);
+
+class KeyIndex {
+public:
+    static constexpr size_t kIndexInterval = 16; // Records per block
+
+    KeyIndex();
+
+    // Record a block start; keys must be added in ascending order
+    void add(const std::string& key, uint64_t offset);
+
+    // Seal the index: compute shared prefix and fingerprints
+    void finish(uint64_t file_size);
+
+    // Byte range [begin, end) of the only block that may contain key,
+    // or nullopt if key sorts before the first key of the table
+    std::optional<std::pair<uint64_t, uint64_t>> findBlock(const std::string& key) const;
+
+    // Start offset of the block holding the record that ends at offset,
+    // or nullopt if offset is the start of the table
+    std::optional<uint64_t> blockBefore(uint64_t offset) const;
+
+    size_t size() const;
+    uint64_t fileSize() const;
+
+    // First key of every block, ascending
+    const std::vector<std::string>& keys() const;
+
+private:
+    // Index of the first indexed key that is > key
+    size_t upperBound(const std::string& key) const;
+
+    std::vector<std::string> _keys;         // Every kIndexInterval-th key
+    std::vector<uint64_t>    _offsets;      // Byte offset of each indexed key
+    std::vector<uint64_t>    _fingerprints; // Packed key bytes after _prefix_len
+    size_t                   _prefix_len;   // Bytes shared by all indexed keys
+    uint64_t                 _file_size;
+    SearchKernel             _kernel;
+};
+
+} // namespace kv
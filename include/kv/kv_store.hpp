@@ -3,40 +3,138 @@
 #include "kv/file_handle.hpp"
 #include "kv/log_writer.hpp"
 #include "kv/sstable_reader.hpp"
+#include "kv/version_set.hpp"
 #include "kv/lock_manager.hpp"
+#include "kv/iterator.hpp"
+#include "kv/snapshot.hpp"
+#include "kv/options.hpp"
+#include "kv/row_cache.hpp"
+#include "kv/sstable_writer.hpp"
+#include "kv/flusher.hpp"
+#include "kv/rate_limiter.hpp"
+#include "kv/compaction_filter.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
 
 namespace kv {
 
 const std::string TOMB_STONE = "__TOMBSTONE__";
+// WAL value of a range deletion: the marker followed by the range's end key
+const std::string RANGE_TOMB_STONE = "__RANGE_TOMBSTONE__";
 
 class KVStore {
     public:
         // constructor and destructor
-        explicit KVStore(const std::string& db_path, std::shared_ptr<LockManager> lock_mgr);
+        explicit KVStore(const std::string& db_path,
+                         std::shared_ptr<LockManager> lock_mgr,
+                         const Options& options = Options());
         ~KVStore();
 
-        // Durably write by WAL + in-memory insert
+        // Durably write by WAL + in-memory insert, tagged with the next sequence number.
+        // With Options::ttl the value expires that long after this call.
         void put(const std::string& key, const std::string& value);
 
         // Look up value based on key
-        // - First look-up from in-memory lookup MemTable
-        // - Second look-up from persistent sstables (TODO)
-        std::optional<std::string> get(const std::string& key);
+        // - First look-up from in-memory lookup MemTable (active, then the ones being flushed)
+        // - Second look-up from persistent sstables
+        // With a snapshot, the value as of that snapshot is returned.
+        // Latest-state reads go through the row cache when it is enabled.
+        std::optional<std::string> get(const std::string& key,
+                                       const std::shared_ptr<const Snapshot>& snapshot = nullptr);
         
+        // Batched get: one MemTable pass, then each candidate SSTable is visited
+        // once for all remaining keys. Results are in the same order as keys.
+        std::vector<std::optional<std::string>> multiGet(const std::vector<std::string>& keys,
+                                                         const std::shared_ptr<const Snapshot>& snapshot = nullptr);
+
+        // Ordered view over MemTable + SSTables, newest version of each key wins
+        // and deleted keys are skipped. Without a snapshot, the iterator sees
+        // the state at creation time.
+        std::unique_ptr<Iterator> newIterator(const std::shared_ptr<const Snapshot>& snapshot = nullptr);
+
+        // Pin the current state for consistent reads; released with the last copy
+        std::shared_ptr<const Snapshot> getSnapshot();
+
+        // Sequence numbers of live snapshots, ascending (compaction keeps their versions)
+        std::vector<SequenceNumber> liveSnapshots() const;
+
+        SequenceNumber lastSequence() const;
+
+        // Row cache, nullptr unless Options::row_cache_bytes > 0
+        const RowCache* rowCache() const;
+
+        // Called by a linked Compactor once it installed tables in which the
+        // compaction filter or the TTL removed or changed the values of keys
+        void invalidateCachedRows(const std::vector<std::string>& keys);
+
+        // Options::rate_limiter, shared with a linked Compactor; nullptr if unlimited
+        std::shared_ptr<RateLimiter> rateLimiter() const;
+
+        // Options::compaction_filter and Options::ttl, applied by a linked Compactor
+        std::shared_ptr<CompactionFilter> compactionFilter() const;
+        std::chrono::seconds ttl() const;
+
+        // Bytes written to SSTables by flushes since the store was opened
+        uint64_t flushedBytes() const;
+
+        // Called whenever new SSTables become live (flush, import) or reads used
+        // up a table's seek budget, e.g. to wake the compactor. nullptr unregisters.
+        void setSSTableListener(std::function<void()> listener);
+
         // Delete a key by placing a tombstone
         void del(const std::string& key);
+
+        // Delete every key in [begin, end) with a single range tombstone: one WAL
+        // record, no per-key writes. Keys written afterwards are not affected.
+        // Nothing happens if begin >= end.
+        void deleteRange(const std::string& begin, const std::string& end);
         
-        // Refresh SSTable metadata (called after compaction)
+        // Adopt SSTables written into the data directory outside flush/compaction
         void refreshSSTableMetadata();
 
+        // Current set of live SSTables (lock-free snapshot)
+        std::shared_ptr<const Version> currentSSTableVersion() const;
+
+        // MANIFEST-backed table set: file numbers and table set edits (used by compactor)
+        std::shared_ptr<VersionSet> versionSet() const;
+
     private:
         std::string _db_path;
         std::string _wal_path;
         LogWriter _wal;
-        MemTable _memtable;
+        std::shared_ptr<MemTable> _memtable;    // Active MemTable, swapped by the flusher
+        std::mutex _memtable_mutex;             // Guards _memtable (pointer and contents)
+        std::mutex _immutable_mutex;            // Guards the flusher's frozen MemTables
+        std::shared_ptr<VersionSet> _versions;
         SSTableReader _reader;
         std::shared_ptr<LockManager> _lock_mgr;
+        std::atomic<SequenceNumber> _last_sequence; // Newest write visible to readers
+        std::mutex _write_mutex;                    // Orders sequence numbers with WAL appends
+        SnapshotList _snapshots;
+        Options _options;
+        std::unique_ptr<RowCache> _row_cache;
+        std::mutex _listener_mutex;
+        std::function<void()> _sstable_listener;
+        SSTableWriter _writer;
+        std::unique_ptr<Flusher> _flusher; // Declared last: stopped before anything it uses goes away
 
+        void write(const std::string& key, const std::string& value);
+        // snapshot, or a pin of the latest sequence held for the duration of one read
+        ReadPin readSnapshot(const std::shared_ptr<const Snapshot>& snapshot);
+        // get() without the latency measurement: row cache, then resolve()
+        std::optional<std::string> lookup(const std::string& key, const std::shared_ptr<const Snapshot>& snapshot);
+        std::optional<std::string> resolve(const std::string& key, SequenceNumber seq);
+        // Value as the caller sees it: without its write time stamp, nullopt once expired
+        std::optional<std::string> liveValue(std::optional<std::string> stored) const;
+        // Active then frozen MemTable, raw value (tombstones included); its seq goes to found_seq
+        std::optional<std::string> memtableGet(const std::string& key, SequenceNumber seq,
+                                               SequenceNumber* found_seq = nullptr);
+        // Newest range tombstone covering key as of seq, from the MemTables and the SSTable version
+        SequenceNumber rangeTombstoneSeq(const std::string& key, SequenceNumber seq);
+        // All range tombstones visible as of seq, fragmented; nullptr if there are none
+        std::shared_ptr<const FragmentedRangeTombstones> visibleRangeTombstones(SequenceNumber seq);
+        void notifySSTableListener();
         void replayWAL();
 };
 
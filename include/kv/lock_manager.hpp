@@ -1,47 +1,228 @@
 /**
  * LockManager - Centralized Lock Coordination for KV Store Components
- * 
+ *
  * The LockManager provides a single point of control for all locking operations
  * across the KV store system, ensuring proper coordination between components
  * and preventing deadlocks through consistent lock ordering.
- * 
+ *
  * Usage Pattern:
  *   auto lock_mgr = std::make_shared<LockManager>();
  *   KVStore store(db_path, lock_mgr);
- *   Flusher flusher(memtable, mutexes, writer, threshold, lock_mgr);
+ *   Flusher flusher(memtable, mutexes, writer, threshold, lock_mgr, versions);
  *   - All components now coordinate through the same lock manager
- * 
+ *
  * Lock Types:
  * - SSTable Read Lock: Shared lock for concurrent read operations
  * - SSTable Write Lock: Exclusive lock for SSTable modifications
  * - MemTable Lock: Coordination wrapper for memtable mutex operations
+ *
+ * Instrumentation:
+ * Every acquire names its caller site with a LockSite, declared once as a
+ * static at the call site (e.g. "KVStore::write"). A site carries a
+ * process-wide index, so an acquire finds its counters with one atomic load
+ * and without locking; only the first acquire of a site on a manager
+ * registers it. Per lock type
+ * and site the manager counts acquisitions, how many of them found the lock
+ * taken (a failed try-lock before blocking), and keeps histograms of the time
+ * spent waiting for the lock and the time it was held. A lock is held until
+ * its guard is destroyed or unlock() is called on it. stats() reports one
+ * entry per site:
+ *   static const kv::LockSite kSite("Compactor::performCompaction");
+ *   auto lock = lock_mgr->acquireSSTableWriteLock(kSite);
+ *   ...
+ *   for (const auto& site : lock_mgr->stats()) {
+ *       std::cout << kv::lockTypeName(site.type) << " " << site.site << ": "
+ *                 << site.contended << "/" << site.acquisitions << " contended, p99 wait "
+ *                 << site.wait.percentile(0.99) << "ns" << std::endl;
+ *   }
  */
 #pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <shared_mutex>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace kv {
 
+enum class LockType {
+    SSTableRead,
+    SSTableWrite,
+    MemTable,
+};
+
+const char* lockTypeName(LockType type);
+
+// Durations in nanoseconds, bucket i counts values in [2^i, 2^(i+1)) (bucket 0 also takes 0)
+struct LatencyHistogram {
+    static constexpr size_t kBuckets = 40;
+
+    std::array<uint64_t, kBuckets> buckets{};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    static size_t bucketFor(uint64_t nanos);
+
+    void add(uint64_t nanos);
+    void merge(const LatencyHistogram& other);
+    double average() const;
+    // Upper bound of the bucket holding the p-th fraction of the values (capped at max), 0 if empty
+    uint64_t percentile(double p) const;
+};
+
+struct LockSiteStats {
+    LockType         type;
+    std::string      site;
+    uint64_t         acquisitions = 0;
+    uint64_t         contended = 0; // Acquisitions that had to wait
+    LatencyHistogram wait;
+    LatencyHistogram hold;
+};
+
+// Counters of one (lock type, caller site), updated without locking
+class LockSiteCounters {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    LockSiteCounters(LockType type, const char* site) : _type(type), _site(site) {}
+
+    void recordAcquire(bool contended, Clock::duration wait);
+    void recordRelease(Clock::duration hold);
+    LockSiteStats snapshot() const;
+    void reset();
+
+private:
+    struct Histogram {
+        std::array<std::atomic<uint64_t>, LatencyHistogram::kBuckets> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+
+        void add(Clock::duration duration);
+        LatencyHistogram snapshot() const;
+        void reset();
+    };
+
+    LockType    _type;
+    const char* _site;
+    std::atomic<uint64_t> _acquisitions{0};
+    std::atomic<uint64_t> _contended{0};
+    Histogram   _wait;
+    Histogram   _hold;
+};
+
+// Name of a caller site and its slot in every LockManager. Declare sites as
+// statics: the index is drawn once per object and names must outlive it.
+class LockSite {
+public:
+    explicit LockSite(const char* name);
+
+    LockSite(const LockSite&) = delete;
+    LockSite& operator=(const LockSite&) = delete;
+
+    const char* name() const { return _name; }
+    size_t index() const { return _index; }
+
+private:
+    const char* _name;
+    size_t      _index;
+};
+
+// A held lock that reports how long it was held when released
+template <typename Lock>
+class TimedLock {
+public:
+    TimedLock(Lock lock, LockSiteCounters* counters)
+        : _lock(std::move(lock)), _counters(counters), _acquired(LockSiteCounters::Clock::now()) {}
+    TimedLock(TimedLock&& other) noexcept
+        : _lock(std::move(other._lock)), _counters(other._counters), _acquired(other._acquired) {}
+    TimedLock& operator=(TimedLock&&) = delete;
+    ~TimedLock() {
+        if (_lock.owns_lock()) unlock();
+    }
+
+    void unlock() {
+        _lock.unlock();
+        _counters->recordRelease(LockSiteCounters::Clock::now() - _acquired);
+    }
+    bool owns_lock() const { return _lock.owns_lock(); }
+
+private:
+    Lock _lock;
+    LockSiteCounters* _counters;
+    LockSiteCounters::Clock::time_point _acquired;
+};
+
+using SSTableReadLock = TimedLock<std::shared_lock<std::shared_mutex>>;
+using SSTableWriteLock = TimedLock<std::unique_lock<std::shared_mutex>>;
+using MemTableLock = TimedLock<std::unique_lock<std::mutex>>;
+
 class LockManager {
 public:
-    // For operations that read SSTable metadata (e.g. get operations, compaction planning)
-    std::shared_lock<std::shared_mutex> acquireSSTableReadLock() {
-        return std::shared_lock(_sstable_mutex);
+    // For operations that read SSTable metadata (e.g. compaction planning);
+    // get/multiGet/iterators read immutable Versions and do not lock
+    SSTableReadLock acquireSSTableReadLock(const LockSite& site) {
+        return acquire<std::shared_lock<std::shared_mutex>>(LockType::SSTableRead, site, _sstable_mutex);
     }
-    
+
     // For operations that modify SSTable metadata (e.g. flushing new sstables, compaction)
-    std::unique_lock<std::shared_mutex> acquireSSTableWriteLock() {
-        return std::unique_lock(_sstable_mutex);
+    SSTableWriteLock acquireSSTableWriteLock(const LockSite& site) {
+        return acquire<std::unique_lock<std::shared_mutex>>(LockType::SSTableWrite, site, _sstable_mutex);
     }
-    
+
     // For memtable operations
-    std::lock_guard<std::mutex> acquireMemTableLock(std::mutex& memtable_mutex) {
-        return std::lock_guard(memtable_mutex);
+    MemTableLock acquireMemTableLock(std::mutex& memtable_mutex, const LockSite& site) {
+        return acquire<std::unique_lock<std::mutex>>(LockType::MemTable, site, memtable_mutex);
     }
 
+    // One entry per lock type and caller site that acquired a lock, ordered by type, then site
+    std::vector<LockSiteStats> stats() const;
+    void resetStats();
+
 private:
+    // Try first, so an uncontended acquire is not charged a wait
+    template <typename Lock, typename Mutex>
+    TimedLock<Lock> acquire(LockType type, const LockSite& site, Mutex& mutex) {
+        LockSiteCounters* site_counters = counters(type, site);
+        Lock lock(mutex, std::try_to_lock);
+        if (lock.owns_lock()) {
+            site_counters->recordAcquire(false, LockSiteCounters::Clock::duration::zero());
+        } else {
+            auto start = LockSiteCounters::Clock::now();
+            lock.lock();
+            site_counters->recordAcquire(true, LockSiteCounters::Clock::now() - start);
+        }
+        return TimedLock<Lock>(std::move(lock), site_counters);
+    }
+
+    // Sites with a larger index are looked up in _sites under _sites_mutex on every acquire
+    static constexpr size_t kMaxSites = 256;
+
+    LockSiteCounters* counters(LockType type, const LockSite& site) {
+        if (site.index() < kMaxSites) {
+            auto& slot = _slots[static_cast<size_t>(type)][site.index()];
+            if (LockSiteCounters* registered = slot.load(std::memory_order_acquire)) return registered;
+        }
+        return registerSite(type, site);
+    }
+
+    // Counters of (type, site), created on first use; sites are keyed by name
+    // pointer, stats() merges equal names that live at different addresses
+    LockSiteCounters* registerSite(LockType type, const LockSite& site);
+
     std::shared_mutex _sstable_mutex;
+
+    mutable std::shared_mutex _sites_mutex; // Guards _sites, not the counters in it
+    std::unordered_map<const char*, std::unique_ptr<LockSiteCounters>> _sites[3]; // Indexed by LockType
+    // Published by registerSite(), indexed by LockType, then LockSite::index()
+    std::array<std::atomic<LockSiteCounters*>, kMaxSites> _slots[3]{};
 };
 
-} // namespace kv
\ No newline at end of file
+} // namespace kv
@@ -4,11 +4,23 @@
  *
  * MemTable is a basic in-memory key-value store that uses an unordered_map
  * to store key-value pairs. It provides thread-safe put and get operations.
+ *
+ * Each key keeps a short list of versions tagged with sequence numbers, so
+ * reads through a snapshot still find the value that was current back then.
+ * On every put, versions that no live snapshot can see anymore are dropped;
+ * without snapshots a key holds a single version, like a plain hash map.
+ *
+ * Range deletions are kept aside as RangeTombstones; they travel to the
+ * MANIFEST when the table is flushed.
  */
 
 #pragma once
 #include <iostream>
 #include <unordered_map>
+#include <optional>
+#include <vector>
+#include "kv/snapshot.hpp"
+#include "kv/range_tombstone.hpp"
 
 namespace kv {
 
@@ -18,14 +30,44 @@ public:
     ~MemTable() = default;
 
     // Put and get operations
-    void put(const std::string& key, const std::string& value);
+    // oldest_snapshot: versions every snapshot has moved past are dropped
+    void put(const std::string& key, const std::string& value,
+             SequenceNumber seq = 0, SequenceNumber oldest_snapshot = kMaxSequenceNumber);
     std::optional<std::string> get(const std::string& key) const;
 
-    size_t size() const;
-    const std::unordered_map<std::string, std::string>& data() const;
+    // Newest version with seq <= snapshot; its seq is stored in found_seq if given
+    std::optional<std::string> get(const std::string& key, SequenceNumber snapshot,
+                                   SequenceNumber* found_seq = nullptr) const;
+
+    // Delete [begin, end) for every version older than seq
+    void deleteRange(const std::string& begin, const std::string& end, SequenceNumber seq);
+
+    // Newest range tombstone covering key with seq <= snapshot, 0 if none
+    SequenceNumber rangeTombstoneSeq(const std::string& key, SequenceNumber snapshot) const;
+
+    // All range tombstones, in the order they were written
+    const std::vector<RangeTombstone>& rangeTombstones() const;
+
+    size_t size() const; // Number of distinct keys plus range tombstones
+
+    // All versions, sorted by key ascending then seq descending (flush order)
+    std::vector<Entry> entries() const;
+
+    // Same order as entries() without copying keys and values; the keys are
+    // sorted on up to `threads` threads. Valid while the table is unchanged,
+    // meant for frozen tables being flushed.
+    std::vector<EntryRef> sortedRefs(size_t threads = 1) const;
+
+    // Per key, the newest version visible at snapshot (sorted by key)
+    std::vector<Entry> visibleEntries(SequenceNumber snapshot) const;
 
 private:
-    std::unordered_map<std::string, std::string> _map; // Hashmap to store key-value pairs
+    struct VersionedValue {
+        SequenceNumber seq;
+        std::string    value;
+    };
+    std::unordered_map<std::string, std::vector<VersionedValue>> _map; // Versions of a key, oldest first
+    std::vector<RangeTombstone> _range_tombstones; // Few, scanned linearly
 };
 
 } // namespace kv 
\ No newline at end of file
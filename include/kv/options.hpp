@@ -0,0 +1,91 @@
+/**
+ * @file options.hpp
+ * @brief Tunables of a KVStore, passed once at construction.
+ *
+ * Every field has a default that keeps the store behaving as before the
+ * option existed, so callers only set what they want to change.
+ *
+ * Typical usage:
+ *   kv::Options options;
+ *   options.row_cache_bytes = 64 << 20;
+ *   kv::KVStore store("db", lock_mgr, options);
+ *
+ * CompactionOptions shape the leveled LSM tree the Compactor maintains.
+ *
+ * Used by:
+ *   - KVStore: reads the options in its constructor
+ *   - Compactor: reads CompactionOptions in its constructor, takes the
+ *     rate limiter, compaction filter and TTL from its linked KVStore
+ */
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace kv {
+
+class RateLimiter;
+class CompactionFilter;
+
+struct Options {
+    // Distinct keys in the active MemTable before it is frozen and flushed to
+    // an SSTable by the background flusher
+    size_t memtable_flush_threshold = 4096;
+
+    // Background workers writing frozen MemTables to SSTables in parallel
+    size_t flush_threads = 2;
+
+    // Row cache for get(): resolved values and "not found" results of hot keys.
+    // 0 disables the cache.
+    size_t row_cache_bytes = 0;
+    size_t row_cache_shards = 16; // Independent LRU shards, each with its own lock
+
+    // Throttles background I/O: flushes at high, compactions of a linked
+    // Compactor at low priority. May be shared by several stores. nullptr = unlimited.
+    std::shared_ptr<RateLimiter> rate_limiter;
+
+    // Called by a linked Compactor for the live value of every key it rewrites,
+    // may drop or change it. See compaction_filter.hpp. nullptr = keep everything.
+    std::shared_ptr<CompactionFilter> compaction_filter;
+
+    // Puts expire this long after they were written: reads stop returning them
+    // and compaction drops them. Keep the setting once data was written with it.
+    // 0 = never expire.
+    std::chrono::seconds ttl{0};
+};
+
+// See compaction_picker.hpp for the trade-offs
+enum class CompactionStyle {
+    Leveled,   // Read and space friendly
+    Universal, // Write friendly (size-tiered)
+};
+
+struct CompactionOptions {
+    CompactionStyle style = CompactionStyle::Leveled;
+
+    // Compaction output rolls over to a new table past this size
+    uint64_t target_file_size = 64ull << 20;
+
+    // Size budget of level 1; level n+1 may hold level_size_multiplier times
+    // as much as level n. A level over budget is compacted into the next one.
+    uint64_t max_bytes_for_level_base = 256ull << 20;
+    double   level_size_multiplier = 10;
+
+    // Levels 0 .. num_levels-1, the last one is never compacted further
+    int num_levels = 7;
+
+    // A compaction reading at least twice target_file_size is split into up to
+    // this many key ranges, merged in parallel. 1 disables the split.
+    size_t max_subcompactions = 4;
+
+    // Universal: merge the newest runs while the next one is at most this
+    // percent larger than all of them together
+    unsigned size_ratio_percent = 1;
+    // Universal: merge everything once the newer runs are this percent of the oldest
+    unsigned max_size_amplification_percent = 200;
+    // Universal: fewest runs a size-ratio merge takes
+    size_t min_merge_width = 2;
+};
+
+} // namespace kv
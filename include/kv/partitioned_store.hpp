@@ -0,0 +1,118 @@
+/**
+ * @file partitioned_store.hpp
+ * @brief Thread-per-core mode: the keyspace split over independent KVStores.
+ *
+ * A PartitionedStore owns N partitions. Each one is a complete KVStore in its
+ * own subdirectory (part-000, part-001, ...) with its own WAL, MemTables,
+ * flusher, LockManager and Compactor, plus one worker thread that is the only
+ * caller of that store. Partitions share nothing, so writes to different
+ * partitions never meet on a lock and throughput grows with the partition
+ * count.
+ *
+ * Keys are routed by hash (FNV-1a, stable across runs) or by range (ascending
+ * split keys, partition i holds [split_keys[i-1], split_keys[i])). A caller's
+ * operation is queued on its partition's bounded lock-free queue (multiple
+ * producers, the worker consumes) and the caller waits for the worker's
+ * answer, so every call has the same contract as on a single KVStore. A full
+ * queue makes producers back off instead of growing without bound; an idle
+ * worker spins briefly, then sleeps until a producer wakes it.
+ *
+ * Workers are pinned to core i % hardware_concurrency on Linux when
+ * pin_threads is set. The background flush and compaction threads of a
+ * partition are not pinned.
+ *
+ * The routing is part of the on-disk layout: reopen a store with the same
+ * partition count, partitioning and split keys.
+ *
+ * Typical usage:
+ *   kv::PartitionOptions options;
+ *   options.num_partitions = std::thread::hardware_concurrency();
+ *   kv::PartitionedStore store("db", options);
+ *   store.put("user:42", "alice");
+ *   auto value = store.get("user:42");
+ *
+ * Used by:
+ *   - Applications that need write throughput beyond one KVStore; no cross
+ *     partition snapshots or iterators are offered
+ */
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "kv/options.hpp"
+
+namespace kv {
+
+class KVStore;
+
+enum class Partitioning {
+    Hash,  // Even spread, point operations only touch one partition
+    Range, // Ordered by key, range deletions touch only the partitions they span
+};
+
+struct PartitionOptions {
+    size_t num_partitions = 4;
+    Partitioning partitioning = Partitioning::Hash;
+    // Range: num_partitions - 1 ascending keys where the next partition begins
+    std::vector<std::string> split_keys;
+
+    // Pin the worker of partition i to core i % hardware_concurrency (Linux only)
+    bool pin_threads = true;
+    // Operations waiting per partition, rounded up to a power of two
+    size_t queue_capacity = 1024;
+
+    // Every partition is a KVStore with these options and a Compactor linked to it
+    Options store_options;
+    CompactionOptions compaction_options;
+    size_t compaction_trigger = 4; // Level 0 tables that trigger a compaction
+};
+
+class PartitionedStore {
+public:
+    // Open (or create) the partitions under db_path and start their workers.
+    // Throws std::invalid_argument for a partition count of 0 or bad split keys.
+    explicit PartitionedStore(const std::string& db_path, const PartitionOptions& options = PartitionOptions());
+    ~PartitionedStore();
+
+    PartitionedStore(const PartitionedStore&) = delete;
+    PartitionedStore& operator=(const PartitionedStore&) = delete;
+
+    // Same contracts as on KVStore, executed by the key's partition worker
+    void put(const std::string& key, const std::string& value);
+    void del(const std::string& key);
+    std::optional<std::string> get(const std::string& key);
+
+    // Keys are grouped by partition, the partitions work on their groups in
+    // parallel. Results are in the same order as keys.
+    std::vector<std::optional<std::string>> multiGet(const std::vector<std::string>& keys);
+
+    // Forwarded to every partition that may hold keys of [begin, end) and
+    // applied by them in parallel; atomic within each partition, not across
+    // them. Returns once every partition has applied it.
+    void deleteRange(const std::string& begin, const std::string& end);
+
+    size_t numPartitions() const;
+    size_t partitionOf(const std::string& key) const;
+
+    // Operations partition i has executed since the store was opened
+    uint64_t operationsExecuted(size_t partition) const;
+
+    // Direct access for inspection (versions, stats); operations should go through the router
+    KVStore& partition(size_t partition);
+
+private:
+    struct Request;
+    class RequestQueue;
+    struct Partition;
+
+    // Queue request on its partition; the caller waits on the request's future
+    void submit(size_t partition, std::unique_ptr<Request> request);
+    void runWorker(Partition& partition, size_t index);
+
+    PartitionOptions _options;
+    std::vector<std::unique_ptr<Partition>> _partitions;
+};
+
+} // namespace kv
@@ -0,0 +1,69 @@
+/**
+ * @file range_tombstone.hpp
+ * @brief Range deletions and the fragmented index that answers "is this key deleted".
+ *
+ * A RangeTombstone deletes every key in [begin, end) whose version is older
+ * than the tombstone's own sequence number, with a single write. Newer puts
+ * into the range are not affected.
+ *
+ * Overlapping tombstones are cut into fragments: disjoint key ranges, each
+ * listing the sequence numbers of every tombstone that covers it (newest
+ * first). A point query is one binary search over the fragments plus a scan
+ * of the few sequence numbers of the fragment it lands in.
+ *
+ * Tombstones are not written into SSTables. The MemTable keeps the ones it
+ * received, a flush moves them into the MANIFEST together with its table,
+ * and every Version carries the fragmented set of the flushed ones.
+ *
+ * Typical usage:
+ *   kv::FragmentedRangeTombstones tombstones({{"a", "m", 7}, {"f", "z", 9}});
+ *   tombstones.coveringSeq("g");         // -> 9
+ *   tombstones.coveringSeq("g", 8);      // -> 7, as seen by a snapshot at 8
+ *
+ * Used by:
+ *   - MemTable / Version: hold the tombstones written to / flushed from them
+ *   - KVStore: get(), multiGet() and iterators skip covered versions
+ *   - Compactor: drops covered versions, then tombstones that hide nothing
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include "kv/snapshot.hpp"
+
+namespace kv {
+
+struct RangeTombstone {
+    std::string    begin; // Inclusive
+    std::string    end;   // Exclusive
+    SequenceNumber seq;
+
+    bool covers(const std::string& key) const { return begin <= key && key < end; }
+};
+
+class FragmentedRangeTombstones {
+public:
+    FragmentedRangeTombstones() = default;
+    explicit FragmentedRangeTombstones(const std::vector<RangeTombstone>& tombstones);
+
+    bool empty() const;
+
+    // Newest tombstone covering key with seq <= snapshot, 0 if there is none
+    SequenceNumber coveringSeq(const std::string& key, SequenceNumber snapshot = kMaxSequenceNumber) const;
+
+    // True if version (key, seq) is hidden from every reader: a newer tombstone
+    // covers it and no live snapshot (ascending) sits between the two
+    bool deletes(const std::string& key, SequenceNumber seq, const std::vector<SequenceNumber>& snapshots) const;
+
+private:
+    struct Fragment {
+        std::string                 begin, end;
+        std::vector<SequenceNumber> seqs; // Covering tombstones, newest first
+    };
+
+    // Fragment holding key, nullptr if no tombstone covers it
+    const Fragment* find(const std::string& key) const;
+
+    std::vector<Fragment> _fragments; // Disjoint, ordered by begin
+};
+
+} // namespace kv
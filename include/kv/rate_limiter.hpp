@@ -0,0 +1,106 @@
+/**
+ * @file rate_limiter.hpp
+ * @brief Token bucket throttling the background I/O of flushes and compactions.
+ *
+ * Background writers ask for bytes before they write them (and, if enabled,
+ * compaction before it reads them). Tokens refill continuously at
+ * bytes_per_sec; the bucket holds at most one refill period worth of them, so
+ * an idle limiter does not build up a large burst. Requests larger than the
+ * bucket are granted in bucket sized pieces.
+ *
+ * Flushes ask with IoPriority::High, compactions with IoPriority::Low. While a
+ * high priority request waits, low priority ones do not get tokens: a flush
+ * that falls behind stalls writers, a compaction that falls behind does not.
+ *
+ * With auto-tuning enabled, foreground reads report their latency. Every
+ * tuning interval the rate is halved if the average latency was above the
+ * target and raised by a quarter (up to bytes_per_sec) otherwise, so background
+ * I/O backs off while it hurts reads and speeds up again once they recover.
+ * Reads only add to atomic counters; the tune step folds them in under the
+ * limiter's mutex, taken by a read only when the interval is over and the
+ * mutex is free.
+ *
+ * Typical usage:
+ *   auto limiter = std::make_shared<kv::RateLimiter>(32 << 20);   // 32 MiB/s
+ *   limiter->enableAutoTune(std::chrono::microseconds(500), 4 << 20);
+ *   kv::Options options;
+ *   options.rate_limiter = limiter;
+ *   kv::KVStore store("db", lock_mgr, options);
+ *   ...
+ *   limiter->request(block.size(), kv::IoPriority::Low);  // blocks until granted
+ *
+ * Used by:
+ *   - SSTableWriter: flush writes, high priority
+ *   - SSTableBuilder / Compactor: compaction writes and reads, low priority
+ *   - KVStore::get(): reports foreground latency for auto-tuning
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace kv {
+
+enum class IoPriority {
+    Low,  // Compaction
+    High, // Flush
+};
+
+class RateLimiter {
+public:
+    static constexpr std::chrono::microseconds kRefillPeriod{100 * 1000};
+    static constexpr std::chrono::microseconds kTuneInterval{100 * 1000};
+
+    // Limit background I/O to bytes_per_sec; reads are only charged with throttle_reads
+    explicit RateLimiter(uint64_t bytes_per_sec, bool throttle_reads = false);
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    // Block until bytes may be written (or read)
+    void request(uint64_t bytes, IoPriority priority);
+
+    // Change the limit; with auto-tuning this is the upper bound
+    void setBytesPerSecond(uint64_t bytes_per_sec);
+    uint64_t bytesPerSecond() const; // Current rate, below the limit while tuned down
+
+    bool throttlesReads() const;
+
+    // Back off while the average foreground latency exceeds target, never below min_bytes_per_sec
+    void enableAutoTune(std::chrono::microseconds target, uint64_t min_bytes_per_sec);
+    bool autoTuning() const;
+    void recordForegroundLatency(std::chrono::microseconds latency);
+
+    // Bytes granted so far per priority
+    uint64_t totalBytesThrough(IoPriority priority) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Add the tokens earned since the last refill, capped at one period worth; needs _mutex
+    void refill(Clock::time_point now);
+    // Adjust the rate once per tuning interval; needs _mutex
+    void tune(Clock::time_point now);
+    uint64_t burstBytes() const;
+
+    mutable std::mutex      _mutex;
+    std::condition_variable _cv;
+    uint64_t                _max_bytes_per_sec;
+    std::atomic<uint64_t>   _bytes_per_sec;
+    const bool              _throttle_reads;
+    double                  _available;     // Tokens in the bucket
+    Clock::time_point       _last_refill;
+    size_t                  _high_waiting;  // High priority requests blocked on tokens
+    std::atomic<uint64_t>   _total_bytes[2]; // Indexed by IoPriority
+
+    std::atomic<bool>         _auto_tune;
+    std::chrono::microseconds _target_latency;
+    uint64_t                  _min_bytes_per_sec;
+    std::atomic<Clock::time_point> _last_tune;     // Written with _mutex held
+    std::atomic<uint64_t>          _latency_sum_us; // Foreground samples of the current interval
+    std::atomic<uint64_t>          _latency_count;
+};
+
+} // namespace kv
@@ -0,0 +1,103 @@
+/**
+ * @file row_cache.hpp
+ * @brief Sharded LRU cache of fully resolved get() results.
+ *
+ * RowCache maps a user key to what KVStore::get() finally returned for it:
+ * either the value or a "not found" marker (missing or deleted), so hot keys
+ * and repeated misses skip the MemTable and SSTable walk entirely. Keys are
+ * spread over independently locked shards by hash; each shard evicts least
+ * recently used rows once its share of the byte budget is exceeded.
+ *
+ * Writes invalidate the key with their sequence number. A shard remembers
+ * the newest invalidation it has seen and refuses rows resolved at an older
+ * sequence, so a get() racing with a put() can never cache the old value
+ * after the put already invalidated it.
+ *
+ * Compactions change values without a new sequence number (a CompactionFilter
+ * removing or rewriting them). They invalidate their keys afterwards, which
+ * bumps the shard's generation; a read that started before refuses to cache.
+ *
+ * Typical usage:
+ *   kv::RowCache cache(64 << 20, 16);
+ *   if (auto hit = cache.lookup(key)) return *hit;   // value or nullopt
+ *   uint64_t generation = cache.generation(key);
+ *   auto value = slowPath(key);
+ *   cache.insert(key, value, read_seq, generation);
+ *   ...
+ *   cache.erase(key, write_seq);                      // on put/del
+ *   cache.eraseRange(begin, end, write_seq);          // on deleteRange
+ *   cache.invalidate(keys);                           // values changed by compaction
+ *
+ * Used by:
+ *   - KVStore::get(): optional, enabled by Options::row_cache_bytes
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "kv/snapshot.hpp"
+
+namespace kv {
+
+class RowCache {
+public:
+    RowCache(size_t capacity_bytes, size_t shard_count);
+
+    // Outer nullopt: not cached. Inner nullopt: cached "not found".
+    std::optional<std::optional<std::string>> lookup(const std::string& key);
+
+    // Generation of key's shard; take it before a read whose result goes to insert()
+    uint64_t generation(const std::string& key);
+
+    // Cache the result of a read done at read_seq, started at generation
+    void insert(const std::string& key, const std::optional<std::string>& value, SequenceNumber read_seq,
+                uint64_t generation);
+
+    // Drop key because it was written at write_seq
+    void erase(const std::string& key, SequenceNumber write_seq);
+
+    // Drop every key in [begin, end) because the range was deleted at write_seq
+    void eraseRange(const std::string& begin, const std::string& end, SequenceNumber write_seq);
+
+    // Drop keys whose stored value changed without a write (compaction filter)
+    void invalidate(const std::vector<std::string>& keys);
+
+    // Drop everything (e.g. tables were imported behind the store's back);
+    // reads that started before refuse to cache, as after invalidate()
+    void clear();
+
+    size_t usage() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    struct Row {
+        std::string key;
+        std::optional<std::string> value;
+        size_t charge;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Row> lru; // Most recently used first
+        std::unordered_map<std::string, std::list<Row>::iterator> rows;
+        size_t usage = 0;
+        size_t capacity = 0;
+        SequenceNumber last_invalidation = 0;
+        uint64_t generation = 0; // Bumped by invalidate() and clear()
+    };
+
+    Shard& shardFor(const std::string& key);
+    static void evict(Shard& shard, std::list<Row>::iterator it);
+
+    std::vector<Shard> _shards;
+    std::atomic<uint64_t> _hits;
+    std::atomic<uint64_t> _misses;
+};
+
+} // namespace kv
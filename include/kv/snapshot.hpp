@@ -0,0 +1,141 @@
+/**
+ * @file snapshot.hpp
+ * @brief Sequence numbers, versioned entries and read snapshots.
+ *
+ * Every write (put or delete) gets the next global sequence number. The
+ * number travels with the entry through the WAL, the MemTable and the
+ * SSTables, so several versions of one key can coexist. Within one source
+ * they are ordered by key ascending, then sequence descending (newest first).
+ *
+ * A Snapshot pins a sequence number: reads through it only see entries with
+ * seq <= snapshot, no matter what is written afterwards. Snapshots are
+ * handed out as shared_ptrs by a SnapshotList, and drop out of the list when
+ * the last copy is released. Compaction asks the list which sequence numbers
+ * are still pinned and keeps exactly the versions those readers can see.
+ * Reads without a snapshot pin the latest sequence for their duration too,
+ * so a concurrent put cannot prune the MemTable version they are about to read.
+ * Those pins do not touch the list's mutex: a read claims one of a fixed set
+ * of cache line sized slots (starting at one picked per thread) and publishes
+ * its sequence there, and oldest() takes the minimum over the slots as well.
+ * live() only reports snapshots handed out by acquire().
+ *
+ * Entries written before sequence numbers existed carry seq 0.
+ *
+ * Typical usage:
+ *   auto snap = store.getSnapshot();
+ *   store.put("a", "2");
+ *   store.get("a", snap);          // still the value before the put
+ *   auto it = store.newIterator(snap);
+ *
+ * Used by:
+ *   - KVStore: assigns sequence numbers, hands out snapshots
+ *   - MemTable / SSTableWriter / Compactor: store and merge versioned entries
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace kv {
+
+using SequenceNumber = uint64_t;
+
+// Reads with this sequence see everything
+constexpr SequenceNumber kMaxSequenceNumber = UINT64_MAX;
+
+// One version of one key
+struct Entry {
+    std::string    key;
+    SequenceNumber seq;
+    std::string    value;
+};
+
+// One version of one key, borrowed from the MemTable that owns the strings
+struct EntryRef {
+    const std::string* key;
+    SequenceNumber     seq;
+    const std::string* value;
+};
+
+class Snapshot {
+public:
+    explicit Snapshot(SequenceNumber seq) : _seq(seq) {}
+    SequenceNumber sequence() const { return _seq; }
+
+private:
+    SequenceNumber _seq;
+};
+
+// Sequence a single read works at: a caller's snapshot, or the latest
+// sequence pinned in a SnapshotList slot until the pin is dropped
+class ReadPin {
+public:
+    explicit ReadPin(std::shared_ptr<const Snapshot> snapshot);
+    ReadPin(ReadPin&& other) noexcept;
+    ReadPin& operator=(ReadPin&&) = delete;
+    ~ReadPin();
+
+    SequenceNumber sequence() const { return _seq; }
+
+private:
+    friend class SnapshotList;
+    ReadPin(std::atomic<SequenceNumber>* slot, SequenceNumber seq) : _seq(seq), _slot(slot) {}
+
+    SequenceNumber _seq;
+    std::atomic<SequenceNumber>* _slot = nullptr;  // Freed on destruction
+    std::shared_ptr<const Snapshot> _snapshot;     // Kept alive instead when all slots are taken
+};
+
+class SnapshotList {
+public:
+    // Concurrent plain reads pinned without the mutex; more fall back to acquire()
+    static constexpr size_t kReadSlots = 64;
+
+    SnapshotList();
+
+    // Register a snapshot at seq, unregistered when the last copy is dropped
+    std::shared_ptr<const Snapshot> acquire(SequenceNumber seq);
+
+    // Pin the latest value of last_sequence for one read. The sequence is
+    // published in a slot and last_sequence read again until it is unchanged,
+    // so a writer that asks oldest() after that sees the pin, and a writer that
+    // asked before has not published a newer sequence than the pinned one.
+    ReadPin pinLatest(const std::atomic<SequenceNumber>& last_sequence);
+
+    // Sequence numbers of all live snapshots, ascending; read pins held in slots are not included
+    std::vector<SequenceNumber> live() const;
+
+    // Smallest live snapshot or read pin, kMaxSequenceNumber if there is none
+    SequenceNumber oldest() const;
+
+private:
+    friend class ReadPin;
+    static constexpr SequenceNumber kFreeSlot = kMaxSequenceNumber;
+
+    struct State {
+        mutable std::mutex mutex;
+        std::multiset<SequenceNumber> seqs;
+    };
+    struct alignas(64) ReadSlot {
+        std::atomic<SequenceNumber> seq{kFreeSlot};
+    };
+
+    std::shared_ptr<State> _state; // Shared with the deleters of handed out snapshots
+    ReadSlot _read_slots[kReadSlots];
+
+    // Snapshot at seq, already inserted into _state->seqs
+    std::shared_ptr<const Snapshot> handOut(SequenceNumber seq);
+};
+
+// Keep the versions of one key (newest first) that some reader can still see:
+// the newest one, plus the newest one at or below each live snapshot.
+// With bottommost set nothing older exists elsewhere, so trailing tombstones go too.
+std::vector<Entry> retainVisible(std::vector<Entry> versions,
+                                 const std::vector<SequenceNumber>& snapshots,
+                                 bool bottommost);
+
+} // namespace kv
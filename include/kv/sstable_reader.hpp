@@ -8,6 +8,13 @@
  * - It needs to know where does the SSTables reside.
  * - It needs to know what SSTables look like.
  * - It needs to be able to quickly locate the table that contains the key.
+ *   (IntervalIndex over min/max keys, KeyIndex inside each table)
+ * - Reads never lock: they run against the current immutable Version, and
+ *   flush/compaction publish a new Version when they finish.
+ * - Which tables are live is owned by the VersionSet (MANIFEST), the reader
+ *   never lists the directory itself.
+ * - Samples read cost: a get() that had to probe more than one table charges
+ *   a seek to the first one it probed in vain (see TableFile::chargeSeek()).
  * 
  * Future
  * - It needs to be able to detect corruption.
@@ -17,36 +24,73 @@
 #include <optional>
 #include <vector>
 #include <filesystem>
+#include <memory>
+#include <functional>
 #include "kv/lock_manager.hpp"
+#include "kv/iterator.hpp"
+#include "kv/io_backend.hpp"
+#include "kv/version_set.hpp"
 
 namespace kv {
 
-struct SSTableMeta {
-    std::string filename;
-    std::string min_key, max_key;
-};
-
 class SSTableReader {
 public:
-    explicit SSTableReader(const std::string& data_dir, std::shared_ptr<LockManager> lock_mgr);
+    static constexpr size_t kLookupBatch = 4; // Candidate tables probed per I/O batch in get()
+
+    SSTableReader(const std::string& data_dir,
+                  std::shared_ptr<LockManager> lock_mgr,
+                  std::shared_ptr<VersionSet> versions);
 
-    // Scan SSTables newest -> oldest
-    std::optional<std::string> get(const std::string& key) const;
+    // Scan SSTables newest -> oldest for the newest version with seq <= snapshot;
+    // its seq is stored in found_seq if given. Charges read heat, see above.
+    std::optional<std::string> get(const std::string& key, SequenceNumber snapshot = kMaxSequenceNumber,
+                                   SequenceNumber* found_seq = nullptr) const;
     
-    // Refresh metadata after SSTables are modified (called by compactor/flusher)
+    // Batched lookup for keys sorted ascending. Each candidate SSTable is opened
+    // once and all blocks the keys fall into are submitted as one I/O batch. Results are
+    // raw values (tombstones included) in the order of sorted_keys.
+    std::vector<std::optional<std::string>> multiGet(const std::vector<std::string>& sorted_keys,
+                                                     SequenceNumber snapshot = kMaxSequenceNumber) const;
+
+    // Open a cursor on every SSTable, newest -> oldest, seeing only entries with seq <= snapshot
+    std::vector<std::unique_ptr<Cursor>> newCursors(SequenceNumber snapshot = kMaxSequenceNumber) const;
+
+    // Adopt SSTables written into the data directory behind the MANIFEST's back
     void refreshMetadata();
 
+    // Current set of live SSTables, grabbed without locking
+    std::shared_ptr<const Version> currentVersion() const;
+
+    // Called from get() when a table runs out of seek budget, e.g. to wake the
+    // compactor. Set before the first read.
+    void setSeekListener(std::function<void()> listener);
+
 private:
-    // Scan and build SSTables _tables[] cache (newest first)
-    void loadAllTables();
+    // One block of one SSTable, located with its KeyIndex
+    struct BlockRead {
+        const TableFile* table;
+        uint64_t         begin, end;
+    };
+
+    // Read several blocks (possibly of different SSTables) as one I/O batch,
+    // nullopt for blocks that could not be read
+    std::vector<std::optional<std::string>> readBlocks(const std::vector<BlockRead>& blocks) const;
+
+    // A version found in a block
+    struct Found {
+        std::string    value;
+        SequenceNumber seq;
+    };
 
-    // Read from a single SSTable file
-    std::optional<std::string>
-    readOneSSTable(const SSTableMeta& sstable_meta, const std::string& key) const;
+    // Find the newest version of key with seq <= snapshot inside one block read from an SSTable
+    static std::optional<Found>
+    searchBlock(const std::string& block, const std::string& key, SequenceNumber snapshot);
 
     std::string _data_dir;
-    std::vector<SSTableMeta> _tables;
+    std::shared_ptr<VersionSet> _versions;
     std::shared_ptr<LockManager> _lock_mgr;
+    std::shared_ptr<IoBackend> _io; // io_uring or pread
+    std::function<void()> _seek_listener;
 };
 
 } // namespace kv
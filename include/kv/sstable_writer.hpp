@@ -3,28 +3,116 @@
  * @brief Writes SSTable files to disk.
  *
  * SSTableWriter is responsible for writing SSTable files to disk.
- * It takes a map of key-value pairs and writes them to a file.
- * The file is named according to the file number and the current timestamp.
+ * It takes sorted entries (or a map of key-value pairs) and writes them to a file.
+ * Record format: [u32 key_len][key][u64 seq][u32 value_len][value], sorted by
+ * key ascending then seq descending.
+ * The file is named according to the file number (see makeSSTableFileName).
  * The file is written to the data directory.
+ *
+ * SSTableBuilder writes one table incrementally through a fixed size block
+ * buffer, for outputs that should never be held in memory as a whole
+ * (compaction). Both produce the same format.
+ *
+ * Large flushes can be pipelined: the entries are cut into blocks that are
+ * encoded on worker threads while the calling thread appends finished blocks
+ * to the file in order, so encoding overlaps with I/O.
+ *
+ * Both can hand back the written table as a TableFile whose sparse index and
+ * metadata were built from the entries in memory, so VersionSet::logAndApply()
+ * does not have to read the file back to install it.
+ *
+ * With a RateLimiter, bytes are requested before they are written: at high
+ * priority by SSTableWriter (flushes), at low priority by SSTableBuilder
+ * (compactions).
  */
 
 #pragma once
 #include <string>
 #include <map>
+#include <optional>
 #include <cstdint>
+#include <fstream>
+#include <functional>
+#include <vector>
+#include "kv/snapshot.hpp"
+#include "kv/rate_limiter.hpp"
+#include "kv/version.hpp"
 
 namespace kv {
 
+// 8 digit file name of an SSTable (e.g. 5 -> 00000005.sst)
+std::string makeSSTableFileName(uint64_t file_number);
+
+// File number of an SSTable file name, nullopt for anything else
+std::optional<uint64_t> parseSSTableFileName(const std::string& filename);
+
 class SSTableWriter {
 public:
-    explicit SSTableWriter(const std::string& data_dir);
+    explicit SSTableWriter(const std::string& data_dir, std::shared_ptr<RateLimiter> rate_limiter = nullptr);
 
+    // Write and fsync the table, so it is durable before the MANIFEST references it.
+    // sorted_entries must be ordered by key ascending, then seq descending.
+    bool writeSSTable(const std::vector<Entry>& sorted_entries, uint64_t file_number);
+
+    // Borrowed entries (see MemTable::sortedRefs), encoded by up to `threads`
+    // threads ahead of the write. Produces the same file as the overload above.
+    bool writeSSTable(const std::vector<EntryRef>& sorted_entries, uint64_t file_number, size_t threads = 1);
+
+    // Unversioned data, every entry gets seq 0
     bool writeSSTable(const std::map<std::string, std::string>& data, uint64_t file_number);
 
+    // Index the entries just written to file_number without reading the file,
+    // nullptr if there are none
+    std::shared_ptr<TableFile> makeTable(const std::vector<EntryRef>& sorted_entries, uint64_t file_number,
+                                         int level) const;
+
 private:
+    // Write blocks to the file in order and fsync it
+    bool writeFile(uint64_t file_number, const std::function<bool(std::ofstream&)>& write_blocks);
+    // Wait for the rate limiter, if any, before writing bytes
+    void throttle(size_t bytes) const;
+
     std::string _data_dir;
-    // make file name according to file number
-    std::string makeFileName(uint64_t file_number) const;
+    std::shared_ptr<RateLimiter> _rate_limiter;
+};
+
+// Streams entries into one SSTable, memory bounded by one block buffer.
+// Entries must be added in SSTable order (key ascending, then seq descending).
+class SSTableBuilder {
+public:
+    static constexpr size_t kBlockBytes = 64 * 1024;
+
+    SSTableBuilder(const std::string& data_dir, uint64_t file_number,
+                   std::shared_ptr<RateLimiter> rate_limiter = nullptr);
+    ~SSTableBuilder(); // Deletes the file unless finish() succeeded
+
+    SSTableBuilder(const SSTableBuilder&) = delete;
+    SSTableBuilder& operator=(const SSTableBuilder&) = delete;
+
+    bool add(const std::string& key, SequenceNumber seq, const std::string& value);
+
+    // Write the last block and fsync. The builder accepts no entries afterwards.
+    bool finish();
+
+    uint64_t fileNumber() const;
+    uint64_t fileSize() const;   // Bytes added so far, buffered ones included
+    uint64_t numEntries() const;
+
+    // After finish(): the table with the index built while adding, nullptr if it is empty
+    std::shared_ptr<TableFile> table(int level);
+
+private:
+    bool flushBlock();
+
+    std::string _path;
+    uint64_t    _file_number;
+    int         _fd;
+    std::string _block;     // Encoded records not written yet
+    uint64_t    _file_size;
+    uint64_t    _num_entries;
+    bool        _finished;
+    std::shared_ptr<RateLimiter> _rate_limiter;
+    TableIndexBuilder _index;
 };
 
-} // namespace kv
\ No newline at end of file
+} // namespace kv
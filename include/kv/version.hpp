@@ -0,0 +1,158 @@
+/**
+ * @file version.hpp
+ * @brief Immutable, reference-counted snapshots of the live SSTable set.
+ *
+ * A Version lists the SSTables that are live at one point in time, newest
+ * first, together with the key range index over them. Versions are never
+ * modified after construction: flush and compaction build a new Version and
+ * publish it atomically, while readers grab whichever Version is current
+ * without taking any lock and keep using it until they are done.
+ *
+ * Each SSTable is owned by a TableFile shared by every Version that lists
+ * it. When compaction removes a table it only marks the TableFile obsolete;
+ * the file is unlinked once the last Version (and therefore the last reader
+ * or iterator) referencing it is released. A table moved to another level
+ * without being rewritten gets a new TableFile for the same file, which
+ * keeps the old one alive and hands the unlink over to it.
+ *
+ * A Version also carries the range tombstones flushed so far, fragmented
+ * for lookups. They are not stored in any table, so they apply to all of them.
+ *
+ * Tables recovered from the MANIFEST already know their key range, so their
+ * sparse block index is only built by the first read that needs it. Flushes
+ * and compactions build index and metadata with a TableIndexBuilder while
+ * they write, so installing their tables reads nothing back.
+ *
+ * Every TableFile has a seek budget, one seek per 16 KiB of file but at least
+ * 100: about the point where the reads wasted on the table cost as much as
+ * compacting it. A lookup that probes the table and then still has to probe
+ * another one charges a seek. A table that ran out of budget is
+ * a read hotspot the compaction picker moves to the front of the queue.
+ *
+ * Tables are grouped in levels. Level 0 receives flushes and its tables may
+ * overlap; in every deeper level the key ranges are disjoint, and any key's
+ * versions in level n are newer than its versions in level n+1. So a point
+ * lookup walking the tables in order stops at the first version it finds,
+ * and touches at most one table per level below 0.
+ *
+ * Typical usage:
+ *   auto version = reader.currentVersion();   // lock-free
+ *   for (size_t id : version->range_index.find(key)) {
+ *       const SSTableMeta& meta = version->tables[id]->meta();
+ *       ...
+ *   }
+ *
+ * Used by:
+ *   - VersionSet: builds and publishes versions
+ *   - SSTableReader: serves get/multiGet from the current version
+ *   - Iterator: SSTable cursors pin their TableFile while open
+ */
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "kv/key_index.hpp"
+#include "kv/interval_index.hpp"
+#include "kv/range_tombstone.hpp"
+
+namespace kv {
+
+struct SSTableMeta {
+    std::string filename;
+    uint64_t    file_number = 0;
+    int         level = 0;
+    std::string min_key, max_key;
+    uint64_t    max_seq = 0; // Newest entry in the table, orders tables newest first
+    uint64_t    min_seq = 0; // Oldest entry; 0 if unknown (MANIFESTs that did not record it)
+    uint64_t    file_size = 0; // Bytes on disk, sums up to the level sizes compaction balances
+    uint64_t    num_entries = 0;   // Records, every version counts; 0 if unknown
+    uint64_t    num_deletions = 0; // Tombstones among them
+};
+
+// Sparse block index and metadata (key range, seq range, size, entry and
+// deletion counts) of an SSTable, fed its records in file order
+class TableIndexBuilder {
+public:
+    TableIndexBuilder();
+
+    void add(const std::string& key, SequenceNumber seq, uint32_t value_len, bool tombstone);
+    uint64_t numEntries() const { return _record_count; }
+
+    // Fill in meta and return the index; nullptr if no record was added
+    std::shared_ptr<const KeyIndex> finish(SSTableMeta& meta);
+
+private:
+    std::shared_ptr<KeyIndex> _index;
+    SSTableMeta _meta;
+    uint64_t    _offset = 0;
+    uint64_t    _record_count = 0;
+    size_t      _since_indexed;
+    std::string _previous_key;
+};
+
+// Read one SSTable front to back: fill in meta's key range, seq range and size and build
+// its sparse block index. Blocks only start on the first version of a key, so
+// all versions of a key sit in the same block. Returns nullptr if the file cannot be opened or holds no key value pair.
+std::shared_ptr<const KeyIndex> scanSSTable(const std::string& path, SSTableMeta& meta);
+
+class TableFile {
+public:
+    // index may be null, it is then built on first use
+    TableFile(std::string path, SSTableMeta meta, std::shared_ptr<const KeyIndex> index = nullptr);
+    // The file of moved, listed at another level (trivial move)
+    TableFile(std::shared_ptr<TableFile> moved, int level);
+    ~TableFile(); // Unlinks the file if it was marked obsolete
+
+    TableFile(const TableFile&) = delete;
+    TableFile& operator=(const TableFile&) = delete;
+
+    const std::string& path() const;
+    const SSTableMeta& meta() const;
+
+    // Sparse block index, scans the file the first time if it was not given
+    std::shared_ptr<const KeyIndex> index() const;
+
+    // Delete the file once no Version references it anymore
+    void markObsolete();
+
+    // Record a lookup that probed this table in vain; true for the one that used up the budget
+    bool chargeSeek() const;
+    // Seeks charged so far, and the budget they are measured against
+    uint64_t seeksCharged() const;
+    uint64_t seekBudget() const;
+    bool seekBudgetExhausted() const;
+
+private:
+    std::string       _path;
+    SSTableMeta       _meta;
+    mutable std::once_flag _index_once;
+    mutable std::shared_ptr<const KeyIndex> _index;
+    std::atomic<bool> _obsolete;
+    mutable std::atomic<uint64_t> _seeks; // Charged by const readers, so mutable
+    std::shared_ptr<TableFile> _moved_from; // Older versions may still list the file under its old level
+};
+
+struct Version {
+    // tables must be ordered newest -> oldest: level ascending, then max_seq
+    // and file number descending
+    explicit Version(std::vector<std::shared_ptr<TableFile>> tables,
+                     std::vector<RangeTombstone> range_tombstones = {});
+
+    // Tables of one level, in the order of tables
+    std::vector<std::shared_ptr<TableFile>> levelTables(int level) const;
+
+    // Sum of the file sizes of one level
+    uint64_t levelBytes(int level) const;
+
+    // Deepest level holding a table, -1 if there is none
+    int maxLevel() const;
+
+    std::vector<std::shared_ptr<TableFile>> tables;
+    IntervalIndex range_index; // Ids are positions in tables
+    std::vector<RangeTombstone> range_tombstones;    // Flushed range deletions, oldest first
+    FragmentedRangeTombstones range_tombstone_index; // Same, for lookups
+};
+
+} // namespace kv
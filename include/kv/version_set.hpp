@@ -0,0 +1,159 @@
+/**
+ * @file version_set.hpp
+ * @brief MANIFEST-backed owner of the live SSTable set.
+ *
+ * VersionSet is the single source of truth for which SSTables are live. Every
+ * change to the table set (flush, compaction, importing external files) is a
+ * VersionEdit: tables added with their level and key range, tables removed,
+ * tables moved to another level without rewriting them (trivial moves),
+ * range tombstones added (by flushes) or dropped (once they hide nothing),
+ * plus the next file number and the last sequence number. An edit is appended
+ * to the MANIFEST and fsynced before the resulting Version is published, so
+ * the table set on disk changes atomically, one edit at a time.
+ *
+ * Recovery replays the MANIFEST instead of listing the directory: live tables
+ * come back with their key ranges without reading them, files of removed
+ * tables left behind by a crash are deleted, and file numbers continue where
+ * they stopped. A directory without MANIFEST (older stores, or tables written
+ * by hand) is bootstrapped once from its .sst files. On every open the
+ * MANIFEST is rewritten as a single snapshot edit so it does not grow forever.
+ *
+ * MANIFEST record format:
+ *   [u32 payload_len][u32 checksum][payload]
+ *   payload = sequence of [u8 tag][fields], see VersionEdit::encode()
+ * A torn record at the tail (crash mid-append) is ignored on replay.
+ *
+ * Typical usage:
+ *   auto versions = std::make_shared<kv::VersionSet>("db");  // recovers
+ *   uint64_t number = versions->newFileNumber();
+ *   writer.writeSSTable(sorted, number);
+ *   kv::VersionEdit edit;
+ *   edit.addTable(number, 0);  // Or addTable(table) with an index built while writing
+ *   versions->logAndApply(edit);
+ *
+ * Used by:
+ *   - KVStore: owns it, shares it with the reader and the compactor
+ *   - SSTableReader: reads the current version
+ *   - Flusher / Compactor: draw file numbers and install their tables
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+#include "kv/version.hpp"
+
+namespace kv {
+
+struct VersionEdit {
+    struct NewTable {
+        uint64_t    file_number;
+        int         level;
+        std::string min_key, max_key; // Filled in by VersionSet::logAndApply()
+        uint64_t    max_seq = 0;      // Same
+        uint64_t    min_seq = 0;      // Same
+        uint64_t    num_entries = 0;  // Same
+        uint64_t    num_deletions = 0; // Same
+        // Built by the writer, else scanned by logAndApply() before it locks; not logged
+        std::shared_ptr<TableFile> table = nullptr;
+    };
+
+    std::vector<NewTable> added;
+    std::vector<uint64_t> removed;
+    std::vector<NewTable> moved; // Live tables relisted at level; logged as remove + add
+    std::vector<RangeTombstone> added_range_tombstones;
+    std::vector<SequenceNumber> removed_range_tombstones; // By seq, which is unique
+    std::optional<uint64_t> next_file_number;
+    std::optional<uint64_t> last_sequence;
+
+    void addTable(uint64_t file_number, int level);
+    // Add a table whose index and metadata were built while writing it
+    void addTable(std::shared_ptr<TableFile> table);
+    void removeTable(uint64_t file_number);
+    void moveTable(uint64_t file_number, int level);
+    void addRangeTombstone(const RangeTombstone& tombstone);
+    void removeRangeTombstone(SequenceNumber seq);
+
+    std::string encode() const;
+    static std::optional<VersionEdit> decode(const std::string& payload);
+};
+
+class VersionSet {
+public:
+    static constexpr const char* kManifestName = "MANIFEST";
+
+    // Recover the table set of data_dir (creating the directory if needed)
+    explicit VersionSet(const std::string& data_dir);
+    ~VersionSet();
+
+    VersionSet(const VersionSet&) = delete;
+    VersionSet& operator=(const VersionSet&) = delete;
+
+    // Current set of live SSTables, grabbed without locking
+    std::shared_ptr<const Version> current() const;
+
+    // Reserve a file number for a new SSTable
+    uint64_t newFileNumber();
+
+    uint64_t lastSequence() const;
+
+    // Log edit to the MANIFEST, then publish the resulting version. Added
+    // tables must already be written; empty ones are dropped and deleted.
+    // Added tables without a TableFile are scanned before the lock is taken,
+    // so one large install does not hold up the others.
+    // Removed tables are deleted once no reader references them anymore.
+    // Moved tables keep their file and metadata; moves of tables that are not
+    // live are dropped.
+    // Throws if the MANIFEST cannot be written, leaving the version and the
+    // last sequence unchanged and deleting the added tables' files.
+    void logAndApply(VersionEdit edit);
+
+    // Adopt .sst files in the directory that the MANIFEST does not know
+    // (e.g. written by hand or by tools). Returns how many were added.
+    // Numbers newFileNumber() has handed out since the store was opened are
+    // skipped: they belong to flush or compaction outputs still being written
+    // or never installed. Recovery raises the next file number past every
+    // .sst file already on disk.
+    size_t importUntrackedTables();
+
+private:
+    void recover();
+    bool replayManifest(std::vector<VersionEdit::NewTable>& live, std::set<uint64_t>& removed,
+                        std::vector<RangeTombstone>& range_tombstones);
+    void bootstrapFromDirectory(std::vector<std::shared_ptr<TableFile>>& tables);
+
+    // Rewrite the MANIFEST as one edit describing the current version
+    void writeSnapshot();
+    // On a failed append the torn tail is truncated (or the MANIFEST rolled over)
+    bool appendRecord(const VersionEdit& edit);
+
+    // Move the next file number past number, false if it was already handed out
+    bool claimFileNumber(uint64_t number);
+
+    // Forget obsolete tables whose files are gone; called with _mutex held
+    void pruneObsolete();
+
+    // Scan a freshly written table, nullptr if it is empty or unreadable
+    std::shared_ptr<TableFile> loadTable(uint64_t file_number, int level) const;
+
+    // Sort tables newest first (level, max_seq, then file number) and atomically swap them in
+    // together with the range tombstones
+    void install(std::vector<std::shared_ptr<TableFile>> tables, std::vector<RangeTombstone> range_tombstones);
+
+    std::string _data_dir;
+    std::string _manifest_path;
+    std::shared_ptr<const Version> _current; // Only accessed via std::atomic_load/atomic_store
+    std::mutex _mutex;                       // Serializes MANIFEST writes and installs
+    int _manifest_fd;                        // -1 after a failed roll over, the next append retries it
+    uint64_t _manifest_size;                 // Bytes of complete records in the MANIFEST
+    std::atomic<uint64_t> _next_file_number;
+    std::atomic<uint64_t> _last_sequence;
+    uint64_t _untracked_limit;    // Next file number at open, newFileNumber() hands out the ones after it
+    std::set<uint64_t> _obsolete; // Removed tables whose files may still be on disk
+};
+
+} // namespace kv
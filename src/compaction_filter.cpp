@@ -0,0 +1,34 @@
+#include "kv/compaction_filter.hpp"
+#include <algorithm>
+#include <cctype>
+
+namespace kv {
+
+uint64_t unixSeconds() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+std::string appendWriteTime(const std::string& value, uint64_t write_time) {
+    constexpr size_t kDigits = kWriteTimeSize - 1;
+    std::string stamp = std::to_string(write_time);
+    if (stamp.size() < kDigits) stamp.insert(0, kDigits - stamp.size(), '0');
+    return value + kWriteTimeMarker + stamp.substr(stamp.size() - kDigits);
+}
+
+std::optional<uint64_t> writeTime(const std::string& stored) {
+    if (stored.size() < kWriteTimeSize) return std::nullopt;
+    auto stamp = stored.end() - kWriteTimeSize;
+    if (*stamp++ != kWriteTimeMarker) return std::nullopt;
+    if (!std::all_of(stamp, stored.end(), [](unsigned char c) { return std::isdigit(c); })) return std::nullopt;
+    return std::stoull(std::string(stamp, stored.end()));
+}
+
+std::optional<std::string> unwrapTtl(const std::string& stored, std::chrono::seconds ttl, uint64_t now) {
+    auto written = writeTime(stored);
+    if (!written) return stored; // Not stamped: written before the TTL was set, never expires
+    if (*written + static_cast<uint64_t>(ttl.count()) <= now) return std::nullopt;
+    return stored.substr(0, stored.size() - kWriteTimeSize);
+}
+
+} // namespace kv
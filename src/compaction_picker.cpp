@@ -0,0 +1,263 @@
+#include "kv/compaction_picker.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace kv {
+
+static bool overlaps(const SSTableMeta& table, const std::string& low, const std::string& high) {
+    return !(table.max_key < low || table.min_key > high);
+}
+
+// Nothing below output_level overlaps [low, high]
+static bool isBottommost(const Version& version, int output_level, const std::string& low, const std::string& high) {
+    for (const auto& table : version.tables) {
+        if (table->meta().level > output_level && overlaps(table->meta(), low, high)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double CompactionPicker::spaceAmplification(const Version& version) const {
+    uint64_t total = 0;
+    for (const auto& table : version.tables) {
+        total += table->meta().file_size;
+    }
+    // Oldest data: the deepest level, or the oldest level 0 table when that is all there is
+    int deepest = version.maxLevel();
+    uint64_t oldest = 0;
+    if (deepest > 0) {
+        oldest = version.levelBytes(deepest);
+    } else if (deepest == 0) {
+        oldest = version.levelTables(0).back()->meta().file_size;
+    }
+    return oldest == 0 ? 1.0 : static_cast<double>(total) / static_cast<double>(oldest);
+}
+
+LeveledCompactionPicker::LeveledCompactionPicker(size_t level0_trigger, const CompactionOptions& options)
+    : _level0_trigger(std::max<size_t>(1, level0_trigger)),
+      _options(options),
+      _compact_pointer(static_cast<size_t>(std::max(1, options.num_levels)))
+{}
+
+const char* LeveledCompactionPicker::name() const {
+    return "leveled";
+}
+
+uint64_t LeveledCompactionPicker::maxBytesForLevel(int level) const {
+    double bytes = static_cast<double>(_options.max_bytes_for_level_base);
+    for (int i = 1; i < level; ++i) {
+        bytes *= _options.level_size_multiplier;
+    }
+    return static_cast<uint64_t>(bytes);
+}
+
+// Level 0 tables overlap and are all read by a lookup, so their count matters;
+// deeper levels are bounded by size
+double LeveledCompactionPicker::levelScore(const Version& version, int level) const {
+    if (level == 0) {
+        return static_cast<double>(version.levelTables(0).size()) / static_cast<double>(_level0_trigger);
+    }
+    return static_cast<double>(version.levelBytes(level)) / static_cast<double>(std::max<uint64_t>(1, maxBytesForLevel(level)));
+}
+
+// Read heat counts most: a table out of seek budget costs every lookup in its range
+static constexpr double kReadHeatWeight = 4;
+static constexpr double kTombstoneWeight = 2;
+
+// Size enters through the overlap ratio: bytes rewritten per byte moved down a level
+double LeveledCompactionPicker::filePriority(const Version& version, const TableFile& table) const {
+    const SSTableMeta& meta = table.meta();
+    uint64_t overlap = 0;
+    for (const auto& next : version.levelTables(meta.level + 1)) {
+        if (overlaps(next->meta(), meta.min_key, meta.max_key)) overlap += next->meta().file_size;
+    }
+    double overlap_ratio = static_cast<double>(overlap) / static_cast<double>(std::max<uint64_t>(1, meta.file_size));
+    double tombstones = meta.num_entries == 0 ? 0.0
+                        : static_cast<double>(meta.num_deletions) / static_cast<double>(meta.num_entries);
+    double heat = std::min(1.0, static_cast<double>(table.seeksCharged()) / static_cast<double>(table.seekBudget()));
+    return (1 + kReadHeatWeight * heat) * (1 + kTombstoneWeight * tombstones) / (1 + overlap_ratio);
+}
+
+std::optional<CompactionJob> LeveledCompactionPicker::pick(const Version& version) {
+    // The level furthest over its budget goes first; the last level stays put
+    int last_level = std::max(1, _options.num_levels) - 1;
+    int level = -1;
+    double best_score = 1.0;
+    for (int l = 0; l < last_level; ++l) {
+        double score = levelScore(version, l);
+        if (score >= best_score) {
+            best_score = score;
+            level = l;
+        }
+    }
+
+    // Every level fits: compact the hottest table out of seek budget, shallowest level first
+    std::shared_ptr<TableFile> hot;
+    for (int l = 0; level < 0 && l < last_level && !hot; ++l) {
+        double hottest = 0;
+        for (const auto& table : version.levelTables(l)) {
+            if (!table->seekBudgetExhausted()) continue;
+            double priority = filePriority(version, *table);
+            if (!hot || priority > hottest) {
+                hot = table;
+                hottest = priority;
+            }
+        }
+    }
+    if (hot) {
+        level = hot->meta().level;
+        best_score = levelScore(version, level);
+    }
+    if (level < 0) return std::nullopt;
+
+    CompactionJob job;
+    job.level = level;
+    job.output_level = level + 1;
+    job.target_file_size = _options.target_file_size;
+    job.read_triggered = hot != nullptr;
+
+    // Level 0 tables overlap each other: take all of them, so everything left
+    // in level 0 is newer than the output. Deeper levels hand over one table:
+    // the hot one, or the one with the highest priority. Ties go to the first
+    // one past where the previous compaction of that level stopped, so equal
+    // tables take turns.
+    std::vector<std::shared_ptr<TableFile>> inputs;
+    if (level == 0) {
+        inputs = version.levelTables(0);
+    } else if (hot) {
+        inputs.push_back(hot);
+    } else {
+        auto tables = version.levelTables(level);
+        std::sort(tables.begin(), tables.end(), [](const auto& a, const auto& b) {
+            return a->meta().min_key < b->meta().min_key;
+        });
+        const std::string& pointer = _compact_pointer[static_cast<size_t>(level)];
+        size_t start = static_cast<size_t>(std::find_if(tables.begin(), tables.end(), [&](const auto& table) {
+            return pointer.empty() || table->meta().min_key > pointer;
+        }) - tables.begin());
+        std::shared_ptr<TableFile> best;
+        double best_priority = 0;
+        for (size_t i = 0; i < tables.size(); ++i) {
+            const auto& table = tables[(start + i) % tables.size()];
+            double priority = filePriority(version, *table);
+            if (!best || priority > best_priority) {
+                best = table;
+                best_priority = priority;
+            }
+        }
+        inputs.push_back(best);
+    }
+    if (level > 0) {
+        _compact_pointer[static_cast<size_t>(level)] = inputs.back()->meta().max_key;
+    }
+
+    std::string low = inputs.front()->meta().min_key;
+    std::string high = inputs.front()->meta().max_key;
+    for (const auto& table : inputs) {
+        low = std::min(low, table->meta().min_key);
+        high = std::max(high, table->meta().max_key);
+    }
+
+    // Tables of the output level in that range are merged too, keeping it disjoint
+    std::vector<std::shared_ptr<TableFile>> next_level;
+    for (const auto& table : version.levelTables(job.output_level)) {
+        if (overlaps(table->meta(), low, high)) {
+            next_level.push_back(table);
+            low = std::min(low, table->meta().min_key);
+            high = std::max(high, table->meta().max_key);
+        }
+    }
+    job.bottommost = isBottommost(version, job.output_level, low, high);
+
+    // Oldest first: the output level holds older versions than the inputs, and
+    // version order is newest first within a level
+    for (auto it = next_level.rbegin(); it != next_level.rend(); ++it) {
+        job.files.push_back((*it)->meta().filename);
+    }
+    for (auto it = inputs.rbegin(); it != inputs.rend(); ++it) {
+        job.files.push_back((*it)->meta().filename);
+    }
+
+    std::cout << "DEBUG: Compaction picked L" << level << " (score " << best_score
+              << (job.read_triggered ? ", read heat" : "") << ") -> L" << job.output_level
+              << ": " << inputs.size() << " + " << next_level.size() << " tables, range [" << low << ", " << high << "]"
+              << (job.bottommost ? ", bottommost" : "") << std::endl;
+    return job;
+}
+
+UniversalCompactionPicker::UniversalCompactionPicker(size_t run_trigger, const CompactionOptions& options)
+    : _run_trigger(std::max<size_t>(2, run_trigger)),
+      _options(options)
+{}
+
+const char* UniversalCompactionPicker::name() const {
+    return "universal";
+}
+
+// Every level 0 table is one sorted run (outputs never roll over), newest first.
+// Only a prefix of the newest runs is ever merged, so the output stays newer
+// than every run left behind.
+std::optional<CompactionJob> UniversalCompactionPicker::pick(const Version& version) {
+    auto runs = version.levelTables(0);
+    if (runs.size() < _run_trigger) return std::nullopt;
+
+    // 1. Space amplification: the newer runs together are too large next to the oldest
+    uint64_t newer = 0;
+    for (size_t i = 0; i + 1 < runs.size(); ++i) {
+        newer += runs[i]->meta().file_size;
+    }
+    uint64_t oldest = runs.back()->meta().file_size;
+    if (newer * 100 >= oldest * _options.max_size_amplification_percent) {
+        std::cout << "DEBUG: Compaction picked universal full merge: " << newer << " newer bytes over "
+                  << oldest << " oldest bytes" << std::endl;
+        return mergeNewest(version, runs, runs.size());
+    }
+
+    // 2. Size ratio: newest runs of similar size, each at most size_ratio percent
+    //    larger than all newer ones together
+    uint64_t accumulated = runs[0]->meta().file_size;
+    size_t count = 1;
+    while (count < runs.size() &&
+           runs[count]->meta().file_size * 100 <= accumulated * (100 + _options.size_ratio_percent)) {
+        accumulated += runs[count]->meta().file_size;
+        count++;
+    }
+    if (count >= std::max<size_t>(2, _options.min_merge_width)) {
+        std::cout << "DEBUG: Compaction picked universal size-ratio merge of " << count << " runs" << std::endl;
+        return mergeNewest(version, runs, count);
+    }
+
+    // 3. Still too many runs: merge just enough of the newest to get below the trigger
+    count = std::min(runs.size(), runs.size() - _run_trigger + 2);
+    std::cout << "DEBUG: Compaction picked universal run-count merge of " << count << " runs" << std::endl;
+    return mergeNewest(version, runs, count);
+}
+
+CompactionJob UniversalCompactionPicker::mergeNewest(const Version& version, const std::vector<std::shared_ptr<TableFile>>& runs,
+                                                     size_t count) const {
+    CompactionJob job;
+    job.level = 0;
+    job.output_level = 0;
+    std::string low = runs[0]->meta().min_key;
+    std::string high = runs[0]->meta().max_key;
+    for (size_t i = count; i-- > 0;) {
+        job.files.push_back(runs[i]->meta().filename);
+        low = std::min(low, runs[i]->meta().min_key);
+        high = std::max(high, runs[i]->meta().max_key);
+    }
+    job.bottommost = count == runs.size() && isBottommost(version, 0, low, high);
+    return job;
+}
+
+std::unique_ptr<CompactionPicker> newCompactionPicker(const CompactionOptions& options, size_t trigger) {
+    switch (options.style) {
+    case CompactionStyle::Universal:
+        return std::make_unique<UniversalCompactionPicker>(trigger, options);
+    case CompactionStyle::Leveled:
+    default:
+        return std::make_unique<LeveledCompactionPicker>(trigger, options);
+    }
+}
+
+} // namespace kv
@@ -1,95 +1,244 @@
 #include "kv/compactor.hpp"
 #include "kv/sstable_writer.hpp"
 #include "kv/kv_store.hpp"
+#include "kv/key_index.hpp"
+#include "kv/compaction_picker.hpp"
+#include "kv/rate_limiter.hpp"
+#include "kv/compaction_filter.hpp"
 #include <iostream>
 #include <filesystem>
 #include <algorithm>
 #include <vector>
 #include <fstream>
 #include <map>
-#include <queue>
+#include <string_view>
 #include <memory>
 #include <iomanip>
+#include <exception>
+#include <thread>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace kv {
 
 // Helper struct for multi-way merge
+// Reads its SSTable in kChunkBytes chunks through the compactor's IoBackend.
+// The current key and value are views into the read buffer, valid until the next advance()
 struct SSTableIterator {
-    std::ifstream file;
-    std::string current_key;
-    std::string current_value;
+    static constexpr size_t kChunkBytes = 256 * 1024;
+
+    int fd;
+    uint64_t file_size;
+    uint64_t file_offset;  // First file byte not yet in buffer
+    std::string buffer;    // Unparsed bytes start at buffer_pos
+    size_t buffer_pos;
+    std::shared_ptr<IoBackend> io;
+    std::string_view current_key;
+    std::string_view current_value;
+    SequenceNumber current_seq;
+    uint64_t current_fp;  // Packed first 8 key bytes, decides most comparisons without touching the strings
     bool is_valid;
     std::string filename;
     size_t file_age; // Track file age for conflict resolution (higher = newer)
+    std::string begin_key;               // Records before it are skipped
+    std::optional<std::string> end_key;  // Iteration stops at it
+    std::shared_ptr<RateLimiter> rate_limiter; // Charged for reads, if it throttles them
     
-    SSTableIterator(const std::string& filepath)
-        : is_valid(false),
+    // Opens the file only; the first chunk is read by fillAll() or advance()
+    SSTableIterator(const std::string& filepath, std::shared_ptr<IoBackend> io)
+        : fd(-1),
+          file_size(0),
+          file_offset(0),
+          buffer_pos(0),
+          io(std::move(io)),
+          current_seq(0),
+          current_fp(0),
+          is_valid(false),
           filename(filepath),
           file_age(0)
     {
-        file.open(filepath, std::ios::binary);
-        if (file.is_open()) {
-            advance(); // Read first key-value pair
+        fd = ::open(filepath.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && ::fstat(fd, &st) == 0) {
+            file_size = static_cast<uint64_t>(st.st_size);
         }
     }
+
+    ~SSTableIterator() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    bool hasMoreFile() const {
+        return fd >= 0 && file_offset < file_size;
+    }
+
+    // Read request for the next chunk of at least min_bytes
+    ReadRequest nextChunkRequest(size_t min_bytes = 0) const {
+        size_t length = static_cast<size_t>(std::min<uint64_t>(std::max(kChunkBytes, min_bytes),
+                                                               file_size - file_offset));
+        return ReadRequest{fd, file_offset, length, {}, false};
+    }
+
+    bool acceptChunk(const ReadRequest& request) {
+        if (!request.ok) return false;
+        buffer.erase(0, buffer_pos);
+        buffer_pos = 0;
+        buffer.append(request.data);
+        file_offset += request.length;
+        return true;
+    }
+
+    // Make sure n unparsed bytes are buffered, reading more of the file if needed
+    bool ensure(size_t n) {
+        size_t available = buffer.size() - buffer_pos;
+        if (available >= n) return true;
+        if (!hasMoreFile()) return false;
+        std::vector<ReadRequest> batch{nextChunkRequest(n - available)};
+        if (rate_limiter) rate_limiter->request(batch[0].length, IoPriority::Low);
+        io->readBatch(batch);
+        return acceptChunk(batch[0]) && buffer.size() - buffer_pos >= n;
+    }
     
+    // Start reading at a block boundary instead of the beginning of the file
+    void seekTo(uint64_t offset) {
+        file_offset = std::min(offset, file_size);
+    }
+
     void advance() {
-        if (!file.is_open()) {
-            is_valid = false;
-            return;
-        }
-        
-        uint32_t key_len;
-        if (!file.read(reinterpret_cast<char*>(&key_len), sizeof(key_len))) {
-            is_valid = false;
-            return;
-        }
-        
-        current_key.resize(key_len);
-        if (!file.read(current_key.data(), key_len)) {
-            is_valid = false;
+        is_valid = false;
+
+        while (true) {
+            // format: [key_len][key_data][seq][value_len][value_data]
+            uint32_t key_len;
+            if (!ensure(sizeof(key_len))) return;
+            std::memcpy(&key_len, buffer.data() + buffer_pos, sizeof(key_len));
+
+            uint32_t value_len;
+            size_t header = sizeof(key_len) + key_len + sizeof(current_seq) + sizeof(value_len);
+            if (!ensure(header)) return;
+            std::memcpy(&current_seq, buffer.data() + buffer_pos + sizeof(key_len) + key_len, sizeof(current_seq));
+            std::memcpy(&value_len, buffer.data() + buffer_pos + header - sizeof(value_len), sizeof(value_len));
+
+            if (!ensure(header + value_len)) return;
+            const char* record = buffer.data() + buffer_pos;
+            current_key = std::string_view(record + sizeof(key_len), key_len);
+            buffer_pos += header + value_len;
+
+            // Only keys of this iterator's subcompaction range
+            if (current_key < begin_key) continue;
+            if (end_key && current_key >= *end_key) return;
+
+            current_value = std::string_view(record + header, value_len);
+            current_fp = keyFingerprint(current_key);
+            is_valid = true;
             return;
         }
-        
-        uint32_t value_len;
-        if (!file.read(reinterpret_cast<char*>(&value_len), sizeof(value_len))) {
-            is_valid = false;
-            return;
+    }
+};
+
+// Read the first chunk of every merge input as a single I/O batch
+static void fillAll(std::vector<std::unique_ptr<SSTableIterator>>& iterators, IoBackend& io,
+                    RateLimiter* rate_limiter) {
+    std::vector<ReadRequest> batch;
+    std::vector<SSTableIterator*> owners;
+    uint64_t bytes = 0;
+    for (auto& iterator : iterators) {
+        if (iterator->hasMoreFile()) {
+            batch.push_back(iterator->nextChunkRequest());
+            owners.push_back(iterator.get());
+            bytes += batch.back().length;
         }
-        
-        current_value.resize(value_len);
-        if (!file.read(current_value.data(), value_len)) {
-            is_valid = false;
-            return;
+    }
+    if (rate_limiter && bytes > 0) rate_limiter->request(bytes, IoPriority::Low);
+    io.readBatch(batch);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        owners[i]->acceptChunk(batch[i]);
+    }
+}
+
+// Tournament (loser) tree over the merge inputs. Leaves are the inputs, every
+// internal node keeps the loser of the match played there and node 0 the overall
+// winner. After the winner advances only its path to the root is replayed: one
+// comparison per level, no allocation, no heap reshuffling.
+class LoserTree {
+public:
+    explicit LoserTree(std::vector<SSTableIterator*> inputs)
+        : _inputs(std::move(inputs)),
+          _tree(std::max<size_t>(_inputs.size(), 1), 0)
+    {
+        if (_inputs.size() > 1) {
+            _tree[0] = build(1);
         }
-        
-        is_valid = true;
     }
-};
 
-// Comparator for priority queue (min-heap by key, then by file age)
-struct IteratorComparator {
-    bool operator()(const std::shared_ptr<SSTableIterator>& a, 
-                    const std::shared_ptr<SSTableIterator>& b) const {
-        // Primary sort: by key (alphabetical order)
-        if (a->current_key != b->current_key) {
-            return a->current_key > b->current_key; // Min-heap: smaller keys first
+    // Input holding the smallest key (newest version first), nullptr once all are exhausted
+    SSTableIterator* top() const {
+        if (_inputs.empty() || !_inputs[_tree[0]]->is_valid) return nullptr;
+        return _inputs[_tree[0]];
+    }
+
+    // Advance the winner and replay its matches
+    void next() {
+        size_t winner = _tree[0];
+        _inputs[winner]->advance();
+        for (size_t node = (winner + _inputs.size()) / 2; node > 0; node /= 2) {
+            if (before(_tree[node], winner)) std::swap(_tree[node], winner);
         }
-        
-        // Secondary sort: for same key, process older files first (smaller file_age)
-        // This ensures older values are seen first and can be overridden by newer ones
-        return a->file_age > b->file_age; // Min-heap: older files (smaller age) first
+        _tree[0] = winner;
+    }
+
+private:
+    // Leaves sit at nodes k .. 2k-1, so any input count makes a complete tree
+    size_t build(size_t node) {
+        if (node >= _inputs.size()) return node - _inputs.size();
+        size_t left = build(2 * node);
+        size_t right = build(2 * node + 1);
+        bool left_wins = before(left, right);
+        _tree[node] = left_wins ? right : left;
+        return left_wins ? left : right;
+    }
+
+    // Input a's entry comes first: smaller key (fingerprints first), then higher
+    // sequence, then newer file. Exhausted inputs lose against everything
+    bool before(size_t a, size_t b) const {
+        const SSTableIterator& x = *_inputs[a];
+        const SSTableIterator& y = *_inputs[b];
+        if (!x.is_valid || !y.is_valid) return x.is_valid;
+        if (x.current_fp != y.current_fp) return x.current_fp < y.current_fp;
+        int order = x.current_key.compare(y.current_key);
+        if (order != 0) return order < 0;
+        if (x.current_seq != y.current_seq) return x.current_seq > y.current_seq;
+        return x.file_age > y.file_age;
     }
+
+    std::vector<SSTableIterator*> _inputs;
+    std::vector<size_t> _tree;
 };
 
 // Constructor
-Compactor::Compactor(const std::string& data_dir, size_t threshold, size_t compaction_count, std::shared_ptr<LockManager> lock_mgr)
+Compactor::Compactor(const std::string& data_dir, size_t threshold, size_t compaction_count, std::shared_ptr<LockManager> lock_mgr,
+                     const CompactionOptions& options)
     : _data_dir(data_dir),
-      _trigger_threshold(threshold),
+      _trigger_threshold(std::max<size_t>(1, threshold)),
       _compaction_count(compaction_count),
+      _options(options),
+      _picker(newCompactionPicker(options, threshold)),
       _is_running(false),
+      _work_pending(false),
       _lock_mgr(lock_mgr),
-      _kv_store(nullptr)
+      _kv_store(nullptr),
+      _io(IoBackend::create()),
+      _ttl(0),
+      _compactions(0),
+      _subcompactions(0),
+      _bytes_read(0),
+      _bytes_written(0),
+      _trivial_moves(0),
+      _read_compactions(0),
+      _entries_expired(0),
+      _entries_filtered(0)
 {
     std::cout << "DEBUG: Compactor created - data_dir: " << data_dir 
               << ", threshold: " << threshold 
@@ -101,6 +250,9 @@ Compactor::~Compactor() {
     if (_is_running.load()) {
         stop();
     }
+    if (_kv_store) {
+        _kv_store->setSSTableListener(nullptr);
+    }
 }
 
 // Start the compaction thread
@@ -111,6 +263,11 @@ void Compactor::start() {
     }
     
     _is_running.store(true);
+    // Tables may have piled up while we were stopped
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+        _work_pending = true;
+    }
     _thread = std::thread(&Compactor::run, this);
     std::cout << "DEBUG: Compactor thread started" << std::endl;
 }
@@ -122,43 +279,77 @@ void Compactor::stop() {
         return;
     }
     
-    _is_running.store(false);
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+        _is_running.store(false);
+    }
+    _work_cv.notify_all();
     if (_thread.joinable()) {
         _thread.join();
     }
     std::cout << "DEBUG: Compactor thread stopped" << std::endl;
 }
 
-// Main compaction loop - similar to Flusher
+void Compactor::notify() {
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+        _work_pending = true;
+    }
+    _work_cv.notify_one();
+}
+
+// Main compaction loop - similar to Flusher, sleeps until notify() or stop()
 void Compactor::run() {
-    while (_is_running.load()) {
-        try {
-            // Step 1: Discover all SSTable files
-            std::vector<std::string> sstable_files = discoverSSTables();
-            
-            // Step 2: Check if compaction is needed
-            if (sstable_files.size() >= _trigger_threshold) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_work_mutex);
+            _work_cv.wait(lock, [this] { return _work_pending || !_is_running.load(); });
+            if (!_is_running.load()) break;
+            _work_pending = false;
+        }
+
+        // One round may push the next level over its budget, keep going until
+        // every level fits (or a round fails)
+        if (_kv_store) {
+            while (_is_running.load()) {
+                auto job = _picker->pick(*_kv_store->currentSSTableVersion());
+                if (!job || !performCompaction(*job)) break;
+                if (job->read_triggered) _read_compactions.fetch_add(1);
+            }
+            continue;
+        }
+
+        // No level information: stop once a round does not shrink the table count
+        size_t last_count = SIZE_MAX;
+        while (_is_running.load()) {
+            try {
+                // Step 1: Discover all SSTable files
+                std::vector<std::string> sstable_files = discoverSSTables();
+                
+                // Step 2: Check if compaction is needed
+                if (sstable_files.size() < _trigger_threshold || sstable_files.size() >= last_count) {
+                    break;
+                }
+                last_count = sstable_files.size();
                 std::cout << "DEBUG: Compaction triggered - found " << sstable_files.size() 
                           << " SSTables, threshold: " << _trigger_threshold << std::endl;
                 
                 // Step 3: Select files to compact (oldest N files)
                 size_t file_cnt_to_compact = std::min(_compaction_count, sstable_files.size());
-                std::vector<std::string> files_for_compaction(
-                    sstable_files.begin(), 
-                    sstable_files.begin() + file_cnt_to_compact
-                );
+                CompactionJob job;
+                job.target_file_size = _options.target_file_size;
+                job.files.assign(sstable_files.begin(), sstable_files.begin() + file_cnt_to_compact);
                 
-                std::cout << "DEBUG: Selected " << files_for_compaction.size() 
+                std::cout << "DEBUG: Selected " << job.files.size() 
                           << " files for compaction" << std::endl;
                 
                 // Perform actual compaction
-                performCompaction(files_for_compaction);
+                if (!performCompaction(job)) break;
+            } catch (const std::exception& e) {
+                std::cerr << "ERROR: Compaction failed: " << e.what() << std::endl;
+                break;
             }
-        } catch (const std::exception& e) {
-            std::cerr << "ERROR: Compaction failed: " << e.what() << std::endl;
         }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     
     std::cout << "DEBUG: Compactor run loop exiting" << std::endl;
@@ -167,9 +358,42 @@ void Compactor::run() {
 // Set KVStore reference (called after both objects are constructed)
 void Compactor::setKVStore(KVStore* kv_store) {
     _kv_store = kv_store;
+    // New SSTables from the store's flusher wake the compaction thread
+    _kv_store->setSSTableListener([this] { notify(); });
+    // Compaction I/O shares the store's budget, below its flushes
+    _rate_limiter = _kv_store->rateLimiter();
+    // Merges drop expired and filtered entries of the store
+    _compaction_filter = _kv_store->compactionFilter();
+    _ttl = _kv_store->ttl();
     std::cout << "DEBUG: Compactor linked to KVStore for metadata refresh" << std::endl;
 }
 
+void Compactor::setPicker(std::unique_ptr<CompactionPicker> picker) {
+    _picker = std::move(picker);
+}
+
+CompactionStats Compactor::stats() const {
+    CompactionStats stats;
+    stats.strategy = _picker->name();
+    stats.compactions = _compactions.load();
+    stats.subcompactions = _subcompactions.load();
+    stats.trivial_moves = _trivial_moves.load();
+    stats.read_compactions = _read_compactions.load();
+    stats.bytes_read = _bytes_read.load();
+    stats.bytes_written = _bytes_written.load();
+    stats.entries_expired = _entries_expired.load();
+    stats.entries_filtered = _entries_filtered.load();
+    if (_kv_store) {
+        stats.bytes_flushed = _kv_store->flushedBytes();
+        stats.space_amplification = _picker->spaceAmplification(*_kv_store->currentSSTableVersion());
+    }
+    if (stats.bytes_flushed > 0) {
+        stats.write_amplification = static_cast<double>(stats.bytes_flushed + stats.bytes_written) /
+                                    static_cast<double>(stats.bytes_flushed);
+    }
+    return stats;
+}
+
 // Discover all SSTable files in data directory, sorted by filename (oldest first)
 std::vector<std::string> Compactor::discoverSSTables() {
     std::vector<std::string> sstable_files;
@@ -198,126 +422,483 @@ std::vector<std::string> Compactor::discoverSSTables() {
 }
 
 // Meat of the compaction logic
-void Compactor::performCompaction(const std::vector<std::string>& files) {
+bool Compactor::performCompaction(const CompactionJob& job) {
+    const std::vector<std::string>& files = job.files;
     std::cout << "DEBUG: performCompaction called with " << files.size() << " files" << std::endl;
     if (files.empty()) {
         std::cout << "DEBUG: No files to compact" << std::endl;
-        return;
+        return false;
     }
     for (const auto& file : files) {
         std::cout << "DEBUG: Compacting file: " << file << std::endl;
     }
+    if (isTrivialMove(job)) {
+        return performTrivialMove(job);
+    }
 
+    // One key range of the job, merged into its own output tables
+    struct Subcompaction {
+        KeyRange              range;
+        std::vector<uint64_t> outputs; // File numbers of the compacted tables
+        std::vector<std::shared_ptr<TableFile>> tables; // The finished ones, indexed while written
+        std::vector<std::string> rewritten; // Keys whose live value the filter or the TTL took or changed
+        uint64_t              bytes_written = 0;
+        size_t                merged = 0;
+        std::exception_ptr    error;
+    };
+    std::vector<Subcompaction> subcompactions;
+    std::vector<uint64_t> outputs; // Outputs of all subcompactions, in key order
+    std::vector<std::shared_ptr<TableFile>> tables; // Same, ready to install
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
     try {
-        // 1. Acquire SSTable write lock (blocks if flusher is active)
-        std::cout << "DEBUG: Acquiring SSTable write lock..." << std::endl;
-        auto sstable_lock = _lock_mgr->acquireSSTableWriteLock();
-        std::cout << "DEBUG: SSTable write lock acquired" << std::endl;
-
-        // 2. Multi-way merge of selected files
+        // 1. Multi-way merge of selected files, streamed into output tables of
+        //    about the target file size; memory stays at the read chunks plus one block.
+        //    No lock is held: the inputs are immutable and only this thread removes
+        //    tables, flushes keep installing new level 0 tables meanwhile
         std::cout << "DEBUG: Starting multi-way merge..." << std::endl;
-        std::map<std::string, std::string> merged_data = performMultiWayMerge(files);
-        std::cout << "DEBUG: Multi-way merge completed. Merged " << merged_data.size() << " key-value pairs" << std::endl;
+        // Versions still visible to a live snapshot survive the merge
+        std::vector<SequenceNumber> snapshots;
+        if (_kv_store) snapshots = _kv_store->liveSnapshots();
+        // Range deletions flushed so far; later ones only hide versions newer than the inputs
+        FragmentedRangeTombstones range_tombstones;
+        if (_kv_store) range_tombstones = _kv_store->currentSSTableVersion()->range_tombstone_index;
 
-        // 3. Write new compacted SSTable
-        std::cout << "DEBUG: Writing compacted SSTable..." << std::endl;
-        uint64_t new_file_number = generateNewFileNumber();
-        SSTableWriter writer(_data_dir);
-        
-        if (!writer.writeSSTable(merged_data, new_file_number)) {
-            throw std::runtime_error("Failed to write compacted SSTable");
+        for (const auto& filename : files) {
+            std::error_code ec;
+            uint64_t size = std::filesystem::file_size(_data_dir + "/" + filename, ec);
+            if (!ec) bytes_read += size;
         }
-        
-        std::cout << "DEBUG: Compacted SSTable written: " << std::setfill('0') << std::setw(8) << new_file_number << ".sst" << std::endl;
 
-        // 4. Delete old files
-        std::cout << "DEBUG: Deleting old SSTable files..." << std::endl;
-        for (const auto& filename : files) {
-            std::string old_sstable_path = _data_dir + "/" + filename;
-            if (std::filesystem::exists(old_sstable_path)) {
-                std::filesystem::remove(old_sstable_path);
-                std::cout << "DEBUG: Deleted old file: " << filename << std::endl;
+        for (auto& range : splitIntoSubcompactions(job)) {
+            subcompactions.push_back(Subcompaction{std::move(range), {}, {}, {}, 0, 0, nullptr});
+        }
+
+        auto runSubcompaction = [&](Subcompaction& sub) {
+            std::unique_ptr<SSTableBuilder> builder;
+            std::string last_key;
+            auto finishOutput = [&]() {
+                if (!builder->finish()) {
+                    throw std::runtime_error("Failed to write compacted SSTable " + makeSSTableFileName(builder->fileNumber()));
+                }
+                sub.bytes_written += builder->fileSize();
+                if (auto table = builder->table(job.output_level)) sub.tables.push_back(std::move(table));
+                std::cout << "DEBUG: Compacted SSTable written: " << makeSSTableFileName(builder->fileNumber())
+                          << " (" << builder->numEntries() << " entries, " << builder->fileSize() << " bytes)" << std::endl;
+                builder.reset();
+            };
+            try {
+                sub.merged = performMultiWayMerge(files, snapshots, range_tombstones, job.bottommost, job.output_level, sub.range, [&](const Entry& entry) {
+                    // 2. Roll to a new table between keys, all versions of a key stay in one table
+                    if (builder && entry.key != last_key && builder->fileSize() >= job.target_file_size) {
+                        finishOutput();
+                    }
+                    if (!builder) {
+                        builder = std::make_unique<SSTableBuilder>(_data_dir, generateNewFileNumber(), _rate_limiter);
+                        sub.outputs.push_back(builder->fileNumber());
+                    }
+                    if (!builder->add(entry.key, entry.seq, entry.value)) {
+                        throw std::runtime_error("Failed to write compacted SSTable " + makeSSTableFileName(builder->fileNumber()));
+                    }
+                    last_key = entry.key;
+                }, sub.rewritten);
+                if (builder) {
+                    finishOutput();
+                }
+            } catch (...) {
+                sub.error = std::current_exception();
             }
+        };
+
+        // The compactor thread merges the first range itself, the others get a thread each
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < subcompactions.size(); ++i) {
+            workers.emplace_back(runSubcompaction, std::ref(subcompactions[i]));
+        }
+        runSubcompaction(subcompactions[0]);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        size_t merged = 0;
+        for (auto& sub : subcompactions) {
+            outputs.insert(outputs.end(), sub.outputs.begin(), sub.outputs.end());
+            tables.insert(tables.end(), sub.tables.begin(), sub.tables.end());
+            bytes_written += sub.bytes_written;
+            merged += sub.merged;
         }
+        for (auto& sub : subcompactions) {
+            if (sub.error) std::rethrow_exception(sub.error);
+        }
+        std::cout << "DEBUG: Multi-way merge completed. Merged " << merged << " entries into "
+                  << outputs.size() << " SSTables in " << subcompactions.size() << " subcompactions, "
+                  << snapshots.size() << " live snapshots" << std::endl;
 
-        // 5. Refresh SSTable metadata in KVStore (while still holding lock)
+        // 3. Swap old files for the new ones of all subcompactions in the live table set, as one
+        //    MANIFEST edit. Only this step excludes flush installs, and only for the MANIFEST append.
+        std::cout << "DEBUG: Acquiring SSTable write lock for the install..." << std::endl;
+        static const LockSite kSite("Compactor::performCompaction");
+        auto sstable_lock = _lock_mgr->acquireSSTableWriteLock(kSite);
+        if (_kv_store) {
+            // The merge saw exactly these inputs, they must still be live
+            auto version = _kv_store->currentSSTableVersion();
+            for (const auto& filename : files) {
+                bool live = std::any_of(version->tables.begin(), version->tables.end(),
+                                        [&](const auto& table) { return table->meta().filename == filename; });
+                if (!live) {
+                    throw std::runtime_error("Compaction input " + filename + " is no longer live");
+                }
+            }
+            // Readers may still hold the old files; they are deleted once the last one lets go
+            std::cout << "DEBUG: Installing compaction result into the SSTable version..." << std::endl;
+            VersionEdit edit;
+            for (auto& table : tables) edit.addTable(table);
+            for (const auto& filename : files) {
+                if (auto number = parseSSTableFileName(filename)) edit.removeTable(*number);
+            }
+            _kv_store->versionSet()->logAndApply(edit);
+        } else {
+            // No KVStore attached, nobody else can be reading these files
+            std::cout << "DEBUG: Deleting old SSTable files..." << std::endl;
+            for (const auto& filename : files) {
+                std::string old_sstable_path = _data_dir + "/" + filename;
+                if (std::filesystem::exists(old_sstable_path)) {
+                    std::filesystem::remove(old_sstable_path);
+                    std::cout << "DEBUG: Deleted old file: " << filename << std::endl;
+                }
+            }
+        }
+        sstable_lock.unlock();
         if (_kv_store) {
-            std::cout << "DEBUG: Refreshing SSTable metadata after compaction..." << std::endl;
-            _kv_store->refreshSSTableMetadata();
+            // Only once the new tables are live: a read starting before that may not cache
+            for (const auto& sub : subcompactions) _kv_store->invalidateCachedRows(sub.rewritten);
+            dropObsoleteRangeTombstones();
         }
 
-        std::cout << "DEBUG: Compaction completed successfully!" << std::endl;
+        _compactions.fetch_add(1);
+        _subcompactions.fetch_add(subcompactions.size());
+        _bytes_read.fetch_add(bytes_read);
+        _bytes_written.fetch_add(bytes_written);
+        std::cout << "DEBUG: Compaction completed successfully! Read " << bytes_read << " bytes, wrote "
+                  << bytes_written << " bytes" << std::endl;
+        return true;
     } catch (const std::exception& e) {
         std::cerr << "ERROR: Compaction failed: " << e.what() << std::endl;
+        // Finished outputs are not referenced by anything, do not leave them to be imported
+        for (uint64_t number : outputs) {
+            std::error_code ec;
+            std::filesystem::remove(_data_dir + "/" + makeSSTableFileName(number), ec);
+        }
+        return false;
+    }
+}
+
+// Inputs that overlap neither each other nor the output level would come out of the
+// merge unchanged. Not with a TTL or a filter though: those only act on rewritten entries,
+// and a table moved to the last level would never be rewritten again
+bool Compactor::isTrivialMove(const CompactionJob& job) const {
+    if (!_kv_store || job.level == job.output_level || _ttl.count() > 0 || _compaction_filter) {
+        return false;
+    }
+    auto version = _kv_store->currentSSTableVersion();
+    std::vector<const SSTableMeta*> inputs;
+    for (const auto& table : version->tables) {
+        const SSTableMeta& meta = table->meta();
+        bool input = std::find(job.files.begin(), job.files.end(), meta.filename) != job.files.end();
+        if (input && meta.level != job.level) return false; // Output level tables are merged into
+        if (input) inputs.push_back(&meta);
+    }
+    if (inputs.size() != job.files.size()) {
+        return false;
+    }
+
+    std::sort(inputs.begin(), inputs.end(), [](const auto* a, const auto* b) { return a->min_key < b->min_key; });
+    for (size_t i = 1; i < inputs.size(); ++i) {
+        if (inputs[i]->min_key <= inputs[i - 1]->max_key) return false;
+    }
+    for (const auto& table : version->levelTables(job.output_level)) {
+        const SSTableMeta& meta = table->meta();
+        bool overlaps = std::any_of(inputs.begin(), inputs.end(), [&](const auto* input) {
+            return meta.min_key <= input->max_key && input->min_key <= meta.max_key;
+        });
+        if (overlaps) return false;
+    }
+    return true;
+}
+
+// Relist the inputs at the output level in one MANIFEST edit, no byte is read or written
+bool Compactor::performTrivialMove(const CompactionJob& job) {
+    try {
+        static const LockSite kSite("Compactor::performTrivialMove");
+        auto sstable_lock = _lock_mgr->acquireSSTableWriteLock(kSite);
+        auto version = _kv_store->currentSSTableVersion();
+        VersionEdit edit;
+        for (const auto& filename : job.files) {
+            bool live = std::any_of(version->tables.begin(), version->tables.end(),
+                                    [&](const auto& table) { return table->meta().filename == filename; });
+            auto number = parseSSTableFileName(filename);
+            if (!live || !number) {
+                throw std::runtime_error("Trivial move input " + filename + " is no longer live");
+            }
+            edit.moveTable(*number, job.output_level);
+        }
+        _kv_store->versionSet()->logAndApply(edit);
+        sstable_lock.unlock();
+
+        _compactions.fetch_add(1);
+        _trivial_moves.fetch_add(1);
+        std::cout << "DEBUG: Trivial move of " << job.files.size() << " SSTables from level " << job.level
+                  << " to level " << job.output_level << std::endl;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: Trivial move failed: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// A range tombstone hides nothing once no snapshot is older than it (nobody may still
+// read what it covers) and no table holds an older version inside its range. Tables
+// that are newer as a whole are skipped, the others are read from the tombstone's
+// first block until the first older version.
+// The tables are read without the SSTable write lock. Whatever is installed meanwhile
+// cannot make a tombstone useful again: flushes only bring writes newer than every
+// flushed tombstone, compactions and moves only rearrange versions already checked,
+// and new snapshots are newer than the tombstones. Only the edit takes the lock.
+void Compactor::dropObsoleteRangeTombstones() {
+    auto version = _kv_store->currentSSTableVersion();
+    if (version->range_tombstones.empty()) {
+        return;
+    }
+    std::vector<SequenceNumber> snapshots = _kv_store->liveSnapshots();
+
+    VersionEdit edit;
+    for (const auto& tombstone : version->range_tombstones) {
+        if (!snapshots.empty() && snapshots.front() < tombstone.seq) continue;
+        bool hides = std::any_of(version->tables.begin(), version->tables.end(), [&](const auto& table) {
+            const SSTableMeta& meta = table->meta();
+            bool overlaps = meta.min_key < tombstone.end && meta.max_key >= tombstone.begin;
+            if (!overlaps || meta.min_seq > tombstone.seq) return false;
+            SSTableIterator iterator(table->path(), _io);
+            if (iterator.fd < 0) return true; // Cannot tell, keep the tombstone
+            iterator.begin_key = tombstone.begin;
+            iterator.end_key = tombstone.end;
+            if (auto block = table->index()->findBlock(tombstone.begin)) iterator.seekTo(block->first);
+            for (iterator.advance(); iterator.is_valid; iterator.advance()) {
+                if (iterator.current_seq < tombstone.seq) return true;
+            }
+            return false;
+        });
+        if (!hides) {
+            edit.removeRangeTombstone(tombstone.seq);
+        }
+    }
+    if (edit.removed_range_tombstones.empty()) {
+        return;
+    }
+    std::cout << "DEBUG: Dropping " << edit.removed_range_tombstones.size() << " obsolete range tombstones" << std::endl;
+    // The compaction is installed already, a failure here must not undo it
+    try {
+        static const LockSite kSite("Compactor::dropObsoleteRangeTombstones");
+        auto sstable_lock = _lock_mgr->acquireSSTableWriteLock(kSite);
+        _kv_store->versionSet()->logAndApply(edit);
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: Dropping range tombstones failed: " << e.what() << std::endl;
+    }
+}
+
+// Cut a job into at most max_subcompactions key ranges of roughly equal size.
+// Boundaries are block start keys of the inputs, so the split costs no I/O.
+std::vector<Compactor::KeyRange> Compactor::splitIntoSubcompactions(const CompactionJob& job) const {
+    std::vector<KeyRange> ranges(1); // Whole key space
+    if (!_kv_store || _options.max_subcompactions <= 1 || job.target_file_size == 0) {
+        return ranges;
+    }
+
+    auto version = _kv_store->currentSSTableVersion();
+    uint64_t input_bytes = 0;
+    std::vector<std::string> keys;
+    for (const auto& table : version->tables) {
+        const SSTableMeta& meta = table->meta();
+        if (std::find(job.files.begin(), job.files.end(), meta.filename) == job.files.end()) continue;
+        input_bytes += meta.file_size;
+        const auto& block_keys = table->index()->keys();
+        keys.insert(keys.end(), block_keys.begin(), block_keys.end());
+    }
+
+    // Not worth a thread unless every piece still fills a whole output table
+    size_t count = static_cast<size_t>(std::min<uint64_t>(_options.max_subcompactions,
+                                                          input_bytes / job.target_file_size));
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    count = std::min(count, keys.size());
+    if (count <= 1) {
+        return ranges;
+    }
+
+    // Evenly spaced sample keys; the first key of all is skipped as it would leave an empty range
+    for (size_t i = 1; i < count; ++i) {
+        const std::string& boundary = keys[i * keys.size() / count];
+        if (boundary <= ranges.back().begin) continue;
+        ranges.back().end = boundary;
+        ranges.push_back(KeyRange{boundary, std::nullopt});
     }
+    std::cout << "DEBUG: Split compaction of " << input_bytes << " bytes into "
+              << ranges.size() << " subcompactions" << std::endl;
+    return ranges;
 }
 
 // Perform multi-way merge of SSTable files
-std::map<std::string, std::string>
-Compactor::performMultiWayMerge(const std::vector<std::string>& files) {
-    std::map<std::string, std::string> merged_data; // Compacted SSTable data
-    
-    // Create iterators for all input files
-    std::priority_queue<std::shared_ptr<SSTableIterator>,              // What are in the min heap?   
-                        std::vector<std::shared_ptr<SSTableIterator>>, // Container of iterators
-                        IteratorComparator> min_heap;                  // Comparator for min-heap
+size_t
+Compactor::performMultiWayMerge(const std::vector<std::string>& files, const std::vector<SequenceNumber>& snapshots,
+                                const FragmentedRangeTombstones& range_tombstones, bool bottommost, int output_level,
+                                const KeyRange& range, const std::function<void(const Entry&)>& emit,
+                                std::vector<std::string>& rewritten) {
+    size_t merged = 0; // Entries handed to emit
+    uint64_t now = unixSeconds(); // TTL expiry is judged against the start of the merge
+
+    // A range that starts mid-table starts reading at the block holding its first key
+    std::shared_ptr<const Version> version;
+    if (_kv_store && !range.begin.empty()) {
+        version = _kv_store->currentSSTableVersion();
+    }
     
-    // Initialize iterators and add valid ones to heap
+    // Initialize iterators, then read the head of every input in one I/O batch
     // NOTE: files are sorted oldest->newest, so we assign file_age accordingly
+    std::vector<std::unique_ptr<SSTableIterator>> iterators;
     for (size_t file_idx = 0; file_idx < files.size(); ++file_idx) {
-        const auto& filename = files[file_idx];
-        std::string sstable_path = _data_dir + "/" + filename;
-        // Create an iterator for each sstable, and at this point, the iterator points to the first key-value pair
-        auto iterator = std::make_shared<SSTableIterator>(sstable_path);
+        std::string sstable_path = _data_dir + "/" + files[file_idx];
+        auto iterator = std::make_unique<SSTableIterator>(sstable_path, _io);
         iterator->file_age = file_idx; // Track file age (higher index = newer file)
-        
+        iterator->begin_key = range.begin;
+        iterator->end_key = range.end;
+        if (_rate_limiter && _rate_limiter->throttlesReads()) iterator->rate_limiter = _rate_limiter;
+        if (version) {
+            for (const auto& table : version->tables) {
+                if (table->meta().filename != files[file_idx]) continue;
+                if (auto block = table->index()->findBlock(range.begin)) iterator->seekTo(block->first);
+                break;
+            }
+        }
+        iterators.push_back(std::move(iterator));
+    }
+    fillAll(iterators, *_io, _rate_limiter && _rate_limiter->throttlesReads() ? _rate_limiter.get() : nullptr);
+
+    // Position every iterator on its first key-value pair; exhausted ones simply never win
+    std::vector<SSTableIterator*> inputs;
+    for (auto& iterator : iterators) {
+        iterator->advance();
+        inputs.push_back(iterator.get());
         if (iterator->is_valid) {
-            min_heap.push(iterator);
             // Higher file_idx means newer file
-            std::cout << "DEBUG: Added iterator for file: " << filename << " (age: " << file_idx << ")" << std::endl;
+            std::cout << "DEBUG: Added iterator for file: " << iterator->filename << " (age: " << iterator->file_age << ")" << std::endl;
         } else {
-            std::cout << "DEBUG: Failed to open file: " << filename << std::endl;
+            std::cout << "DEBUG: Failed to open file: " << iterator->filename << std::endl;
         }
     }
     
-    // Multi-way merge using min-heap
-    // Based on the comparator, we process:
+    // Multi-way merge using a loser tree
+    // Based on its match order, we process:
     // 1. Keys in alphabetical order
-    // 2. For duplicate keys, older files first, then newer files (which override)
-    while (!min_heap.empty()) {
-        // Get the iterator with the smallest key (and oldest file for duplicate keys)
-        auto current_iter = min_heap.top();
-        min_heap.pop();
-        
-        std::string key = current_iter->current_key;
-        std::string value = current_iter->current_value;
-        
-        // Simple override logic: later values automatically override earlier ones
-        // because the comparator ensures older files are processed first
-        if (merged_data.find(key) != merged_data.end()) {
-            std::cout << "DEBUG: Duplicate key '" << key << "' - overriding with newer value from file age " 
-                      << current_iter->file_age << std::endl;
+    // 2. For duplicate keys, newest version first (sequence, then file age)
+    // All versions of a key are gathered, then only the ones a reader can still see are kept.
+    // When nothing older lies underneath the inputs (bottommost), tombstones at the
+    // bottom of a key's history can go.
+    std::vector<Entry> versions;
+    auto flushKey = [&]() {
+        std::string key = versions.front().key;
+        size_t before = versions.size();
+        if (!range_tombstones.empty()) {
+            versions.erase(std::remove_if(versions.begin(), versions.end(), [&](const Entry& entry) {
+                return range_tombstones.deletes(entry.key, entry.seq, snapshots);
+            }), versions.end());
         }
-        merged_data[key] = value;
-
-        // Handle tombstone
-        if (value == TOMB_STONE) {
-            merged_data.erase(key);
-            std::cout << "DEBUG: Removed deleted key: " << key << std::endl;
+        auto kept = retainVisible(std::move(versions), snapshots, bottommost);
+        // Only the version of the latest state is filtered, snapshot readers keep theirs.
+        // A removed key still needs a tombstone over whatever older versions remain
+        bool changed = false;
+        if (!kept.empty() && (snapshots.empty() || kept.front().seq > snapshots.back()) &&
+            !filterEntry(kept.front(), output_level, now, &changed)) {
+            if (bottommost && kept.size() == 1) {
+                kept.clear();
+            } else {
+                kept.front().value = TOMB_STONE;
+            }
+            changed = true;
         }
+        if (changed) {
+            rewritten.push_back(key);
+        }
+        if (before > 1 || kept.empty()) {
+            std::cout << "DEBUG: Key '" << key << "' - kept " << kept.size() << " of " << before << " versions" << std::endl;
+        }
+        for (const auto& entry : kept) {
+            emit(entry);
+        }
+        merged += kept.size();
+        versions.clear();
+    };
 
-        // Advance the iterator and add back to heap if still valid
-        current_iter->advance();
-        if (current_iter->is_valid) {
-            min_heap.push(current_iter);
+    LoserTree tree(std::move(inputs));
+    while (SSTableIterator* current_iter = tree.top()) {
+        // The iterator with the smallest key (and newest version for duplicate keys);
+        // its views die with the advance, so the version is copied out first
+        if (!versions.empty() && versions.back().key != current_iter->current_key) {
+            flushKey();
         }
+        versions.push_back(Entry{std::string(current_iter->current_key), current_iter->current_seq,
+                                 std::string(current_iter->current_value)});
+        tree.next();
+    }
+    if (!versions.empty()) {
+        flushKey();
     }
     
-    return merged_data;
+    return merged;
+}
+
+// TTL first: an expired entry never reaches the filter, which sees the value without its stamp
+bool Compactor::filterEntry(Entry& entry, int level, uint64_t now, bool* changed) {
+    if (entry.value == TOMB_STONE || (_ttl.count() == 0 && !_compaction_filter)) {
+        return true;
+    }
+    std::string value = entry.value;
+    if (_ttl.count() > 0) {
+        auto live = unwrapTtl(entry.value, _ttl, now);
+        if (!live) {
+            _entries_expired.fetch_add(1);
+            return false;
+        }
+        value = std::move(*live);
+    }
+    if (!_compaction_filter) {
+        return true;
+    }
+
+    std::string new_value;
+    switch (_compaction_filter->filter(level, entry.key, value, &new_value)) {
+    case CompactionFilter::Decision::Keep:
+        return true;
+    case CompactionFilter::Decision::Remove:
+        _entries_filtered.fetch_add(1);
+        return false;
+    case CompactionFilter::Decision::ChangeValue:
+        if (_ttl.count() > 0) {
+            if (auto written = writeTime(entry.value)) new_value = appendWriteTime(new_value, *written);
+        }
+        entry.value = std::move(new_value);
+        if (changed) *changed = true;
+        return true;
+    }
+    return true;
 }
 
 // Generate a new file number for the compacted SSTable
 uint64_t Compactor::generateNewFileNumber() {
+    // The MANIFEST hands out numbers that were never used, even by deleted files
+    if (_kv_store) {
+        return _kv_store->versionSet()->newFileNumber();
+    }
+
     uint64_t max_number = 0;
     
     try {
@@ -1,6 +1,7 @@
 #include "kv/flusher.hpp"
-#include <chrono>
 #include <map>
+#include <algorithm>
+#include <iostream>
 
 namespace kv {
 
@@ -9,14 +10,23 @@ Flusher::Flusher(std::shared_ptr<MemTable>&     active_table,
                  std::mutex&                    immu_table_mutex,
                  SSTableWriter&                 writer,
                  uint64_t                       threshold,
-                 std::shared_ptr<LockManager>   _lock_mgr)
+                 std::shared_ptr<LockManager>   _lock_mgr,
+                 std::shared_ptr<VersionSet>    _versions,
+                 size_t                         _num_workers)
     : active_table(active_table)
     , active_table_mutex(active_table_mutex)
     , writer(writer)
     , threshold(threshold)
+    , num_workers(std::max<size_t>(1, _num_workers))
+    , pipeline_threads(std::max<size_t>(1, std::thread::hardware_concurrency() / num_workers))
     , running(false)
     , immu_table_mutex(immu_table_mutex)
-    , next_file_number(1)
+    , flush_requested(false)
+    , next_ticket(0)
+    , next_install(0)
+    , failed(false)
+    , bytes_flushed(0)
+    , versions(_versions)
     , lock_mgr(_lock_mgr)
 {}
 
@@ -24,83 +34,197 @@ Flusher::~Flusher() {
     stop();
 }
 
-// start the flusher thread
+// start the flush workers
 void Flusher::start() {
     running.store(true);
-    bg_flusher_thread = std::thread(&Flusher::run, this);
+    for (size_t i = 0; i < num_workers; i++) {
+        workers.emplace_back(&Flusher::run, this);
+    }
+    std::cout << "DEBUG: Flusher started " << num_workers << " workers" << std::endl;
 }
 
 void Flusher::stop() {
-    running.store(false);
-    immu_cv.notify_all();
-    if (bg_flusher_thread.joinable()) {
-        bg_flusher_thread.join();
+    {
+        std::lock_guard<std::mutex> lock(work_mutex);
+        running.store(false);
+    }
+    work_cv.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers.clear();
+}
+
+void Flusher::scheduleFlush() {
+    {
+        std::lock_guard<std::mutex> lock(work_mutex);
+        flush_requested = true;
     }
+    work_cv.notify_one();
+}
+
+std::vector<std::shared_ptr<MemTable>> Flusher::immutableTables() {
+    static const LockSite kSite("Flusher::immutableTables");
+    auto immu_lock = lock_mgr->acquireMemTableLock(immu_table_mutex, kSite);
+    return std::vector<std::shared_ptr<MemTable>>(immutable_tables.rbegin(), immutable_tables.rend());
+}
+
+uint64_t Flusher::bytesFlushed() const {
+    return bytes_flushed.load();
 }
 
+void Flusher::setFlushListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(listener_mutex);
+    flush_listener = std::move(listener);
+}
+
+// Called with work_mutex held, so tickets follow the freeze order
+bool Flusher::switchIfFull() {
+    static const LockSite kSite("Flusher::switchIfFull");
+    auto active_lock = lock_mgr->acquireMemTableLock(active_table_mutex, kSite);
+    // check if memstable flush is needed
+    if (active_table->size() < threshold) {
+        return false;
+    }
+    // freeze the active_table, unless the workers are far behind
+    {
+        auto immu_lock = lock_mgr->acquireMemTableLock(immu_table_mutex, kSite);
+        if (immutable_tables.size() >= 2 * num_workers) {
+            return false;
+        }
+        immutable_tables.push_back(active_table);
+    } // drop immu_table_mutex
+    pending_jobs.push_back(Job{next_ticket++, active_table});
+    // redirect write to new table
+    active_table = std::make_shared<MemTable>();
+    return true;
+} // drop active_table_mutex
+
 void Flusher::run() {
-    while (running.load()) {
-        bool should_flush = false;
-        // Step 1: Check and swap active to immu_table
+    while (true) {
+        Job job;
         {
-            lock_mgr->acquireMemTableLock(active_table_mutex);
-            // check if memstable flush is needed
-            if (active_table->size() >= threshold) {
-                // freeze the active_table
-                {
-                    lock_mgr->acquireMemTableLock(immu_table_mutex);
-                    immutable_table = active_table;
-                } // drop immu_table_mutex
-                // redirect write to new table
-                active_table = std::make_shared<MemTable>();
-                should_flush = true;
-                immu_cv.notify_one();
-            } // drop active_table_mutex
-        }
-        // Step 2: Flush the immutable if there is one
-        if (should_flush) {
-            std::shared_ptr<MemTable> table_to_flush;
-            {
-                lock_mgr->acquireMemTableLock(immu_table_mutex);
-                table_to_flush = immutable_table;
-            }
-            if (table_to_flush) {
-                // sort the table first
-                std::map<std::string, std::string> sorted_data;
-                for (auto& [k, v] : table_to_flush->data()) {
-                    sorted_data.emplace(k, v);
-                }
-                // write SSTable
-                {
-                    auto sstable_write_lock = lock_mgr->acquireSSTableWriteLock();
-                    uint64_t sst_file_no = next_file_number.fetch_add(1);
-                    writer.writeSSTable(sorted_data, sst_file_no);
-                }
+            // Step 1: Sleep until a writer asks for a flush, a job is queued or we are stopped
+            std::unique_lock<std::mutex> lock(work_mutex);
+            work_cv.wait(lock, [this] { return flush_requested || !pending_jobs.empty() || !running.load(); });
 
-                // relase the immu_table
-                {
-                    lock_mgr->acquireMemTableLock(immu_table_mutex);
-                    immutable_table.reset();
+            // Step 2: Check and swap active to a new immutable table
+            if (running.load() && flush_requested) {
+                flush_requested = false;
+                if (switchIfFull()) {
+                    // Let an idle worker check whether the new table is full already
+                    flush_requested = true;
+                    work_cv.notify_one();
                 }
             }
-        } else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            // Frozen tables are flushed even when stopping
+            if (pending_jobs.empty()) {
+                if (!running.load()) break;
+                continue;
+            }
+            job = std::move(pending_jobs.front());
+            pending_jobs.pop_front();
         }
+
+        // Step 3: Sort and write in parallel with the other workers, install in order.
+        // A job that fails keeps its memtable readable and blocks the newer ones, so
+        // the MANIFEST never records a sequence beyond writes that are only in the WAL.
+        for (int attempt = 0;; ++attempt) {
+            uint64_t file_size = 0;
+            std::optional<VersionEdit> edit = writeTable(*job.table, file_size);
+            if (installInOrder(job, edit, file_size)) break;
+            if (!running.load() && attempt + 1 >= kStopRetries) {
+                // Give up for good: the WAL still holds the writes, replay restores them
+                std::cerr << "ERROR: Flusher giving up on frozen memtable " << job.ticket
+                          << ", newer flushes are not installed either" << std::endl;
+                std::lock_guard<std::mutex> lock(work_mutex);
+                failed = true;
+                work_cv.notify_all();
+                break;
+            }
+            std::this_thread::sleep_for(std::min(kMaxRetryDelay, kRetryDelay * (1 << std::min(attempt, 10))));
+        }
+    }
+}
+
+std::optional<VersionEdit> Flusher::writeTable(const MemTable& table, uint64_t& file_size) {
+    // sort the table first, every version is kept (snapshots may need them).
+    // The table is frozen, so the entries are borrowed instead of copied.
+    std::vector<EntryRef> sorted_entries = table.sortedRefs(pipeline_threads);
+    SequenceNumber last_sequence = 0;
+    file_size = 0; // [key_len][key][seq][value_len][value] per entry
+    for (const auto& entry : sorted_entries) {
+        last_sequence = std::max(last_sequence, entry.seq);
+        file_size += sizeof(uint32_t) + entry.key->size() + sizeof(entry.seq) + sizeof(uint32_t) + entry.value->size();
     }
 
-    // Final cleanup in case anything is left before stop
+    uint64_t sst_file_no = versions->newFileNumber();
+    if (!writer.writeSSTable(sorted_entries, sst_file_no, pipeline_threads)) {
+        std::cerr << "ERROR: Flusher failed to write SSTable " << sst_file_no << std::endl;
+        return std::nullopt;
+    }
+
+    VersionEdit edit;
+    // Indexed from the entries still in memory, the install does not read the file back
+    if (auto sst = writer.makeTable(sorted_entries, sst_file_no, 0)) {
+        edit.addTable(std::move(sst));
+    } else {
+        edit.addTable(sst_file_no, 0);
+    }
+    // Range deletions become live in the MANIFEST together with the table they came with
+    for (const auto& tombstone : table.rangeTombstones()) {
+        edit.addRangeTombstone(tombstone);
+        last_sequence = std::max(last_sequence, tombstone.seq);
+    }
+    edit.last_sequence = last_sequence;
+    return edit;
+}
+
+bool Flusher::installInOrder(const Job& job, const std::optional<VersionEdit>& edit, uint64_t file_size) {
     {
-        lock_mgr->acquireMemTableLock(immu_table_mutex);
-        if (immutable_table) {
-            std::map<std::string, std::string> sorted_data;
-            for (auto& [k, v] : immutable_table->data())
-                sorted_data.emplace(k, v);
-
-            uint64_t sst_file_no = next_file_number.fetch_add(1);
-            writer.writeSSTable(sorted_data, sst_file_no);
-            immutable_table.reset();
+        std::unique_lock<std::mutex> lock(work_mutex);
+        work_cv.wait(lock, [&] { return next_install == job.ticket || failed; });
+        // An older job was given up: installing this one would cover its writes
+        if (failed) return true;
+    }
+
+    // Only live once the MANIFEST has it
+    if (!edit) return false;
+    static const LockSite kSite("Flusher::installInOrder");
+    try {
+        auto sstable_write_lock = lock_mgr->acquireSSTableWriteLock(kSite);
+        versions->logAndApply(*edit);
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: Flusher failed to install SSTable " << edit->added.front().file_number
+                  << ": " << e.what() << std::endl;
+        return false;
+    }
+    // Counted once per installed table, not per attempt
+    bytes_flushed.fetch_add(file_size);
+
+    // relase the immu_table, the SSTable is already in the version. It is the
+    // oldest one, installs happen in freeze order.
+    {
+        auto immu_lock = lock_mgr->acquireMemTableLock(immu_table_mutex, kSite);
+        immutable_tables.pop_front();
+    }
+    {
+        // The queue has room again, the active table may be waiting for it
+        std::lock_guard<std::mutex> lock(work_mutex);
+        next_install++;
+        flush_requested = true;
+    }
+    work_cv.notify_all();
+
+    {
+        std::lock_guard<std::mutex> lock(listener_mutex);
+        if (flush_listener) {
+            flush_listener();
         }
-    }  
+    }
+    return true;
 }
 
-} // kv namespace
\ No newline at end of file
+} // kv namespace
@@ -0,0 +1,93 @@
+#include "kv/interval_index.hpp"
+#include <algorithm>
+
+namespace kv {
+
+void IntervalIndex::build(std::vector<Interval> intervals) {
+    _intervals = std::move(intervals);
+    _nodes.clear();
+
+    std::vector<size_t> all(_intervals.size());
+    for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+    _root = buildNode(std::move(all));
+}
+
+int IntervalIndex::buildNode(std::vector<size_t> items) {
+    if (items.empty()) {
+        return -1;
+    }
+
+    // Center on the median endpoint, the interval owning it always lands in this node
+    std::vector<const std::string*> endpoints;
+    endpoints.reserve(items.size() * 2);
+    for (size_t i : items) {
+        endpoints.push_back(&_intervals[i].low);
+        endpoints.push_back(&_intervals[i].high);
+    }
+    auto mid = endpoints.begin() + static_cast<std::ptrdiff_t>(endpoints.size() / 2);
+    std::nth_element(endpoints.begin(), mid, endpoints.end(),
+                     [](const std::string* a, const std::string* b) { return *a < *b; });
+    std::string center = **mid;
+
+    std::vector<size_t> left, right, here;
+    for (size_t i : items) {
+        if (_intervals[i].high < center) {
+            left.push_back(i);
+        } else if (_intervals[i].low > center) {
+            right.push_back(i);
+        } else {
+            here.push_back(i);
+        }
+    }
+
+    Node node;
+    node.center = std::move(center);
+    node.by_low = here;
+    std::sort(node.by_low.begin(), node.by_low.end(),
+              [this](size_t a, size_t b) { return _intervals[a].low < _intervals[b].low; });
+    node.by_high = std::move(here);
+    std::sort(node.by_high.begin(), node.by_high.end(),
+              [this](size_t a, size_t b) { return _intervals[a].high > _intervals[b].high; });
+
+    int index = static_cast<int>(_nodes.size());
+    _nodes.push_back(std::move(node));
+    // _nodes may reallocate while recursing, so assign children by index afterwards
+    int left_child = buildNode(std::move(left));
+    int right_child = buildNode(std::move(right));
+    _nodes[static_cast<size_t>(index)].left = left_child;
+    _nodes[static_cast<size_t>(index)].right = right_child;
+    return index;
+}
+
+std::vector<size_t> IntervalIndex::find(const std::string& key) const {
+    std::vector<size_t> ids;
+    int current = _root;
+    while (current != -1) {
+        const Node& node = _nodes[static_cast<size_t>(current)];
+        if (key < node.center) {
+            // Every interval here reaches center, so it contains key iff low <= key
+            for (size_t i : node.by_low) {
+                if (_intervals[i].low > key) break;
+                ids.push_back(_intervals[i].id);
+            }
+            current = node.left;
+        } else if (key > node.center) {
+            for (size_t i : node.by_high) {
+                if (_intervals[i].high < key) break;
+                ids.push_back(_intervals[i].id);
+            }
+            current = node.right;
+        } else {
+            for (size_t i : node.by_low) ids.push_back(_intervals[i].id);
+            break;
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+size_t IntervalIndex::size() const {
+    return _intervals.size();
+}
+
+} // namespace kv
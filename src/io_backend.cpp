@@ -0,0 +1,304 @@
+#include "kv/io_backend.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define KV_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace kv {
+
+namespace {
+
+// Read the full range, retrying short reads
+bool preadFully(ReadRequest& request, size_t already_read = 0) {
+    request.data.resize(request.length);
+    size_t done = already_read;
+    while (done < request.length) {
+        ssize_t n = ::pread(request.fd, request.data.data() + done, request.length - done,
+                            static_cast<off_t>(request.offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+class PreadBackend : public IoBackend {
+public:
+    static constexpr size_t kMaxThreads = 16;
+
+    void readBatch(std::vector<ReadRequest>& requests) override {
+        size_t worker_cnt = std::min<size_t>({requests.size(), kMaxThreads,
+                                              std::max(1u, std::thread::hardware_concurrency())});
+        if (worker_cnt <= 1) {
+            for (auto& request : requests) request.ok = preadFully(request);
+            return;
+        }
+
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers;
+        for (size_t w = 0; w < worker_cnt; ++w) {
+            workers.emplace_back([&]() {
+                for (size_t i = next.fetch_add(1); i < requests.size(); i = next.fetch_add(1)) {
+                    requests[i].ok = preadFully(requests[i]);
+                }
+            });
+        }
+        for (auto& worker : workers) worker.join();
+    }
+
+    const char* name() const override { return "pread"; }
+};
+
+#ifdef KV_HAVE_IO_URING
+// Minimal io_uring client on raw syscalls (no liburing dependency). One ring
+// serves one batch at a time; UringBackend hands rings out to its callers.
+class UringRing {
+public:
+    // Returns nullptr if the kernel does not let us set up a ring
+    static std::unique_ptr<UringRing> tryCreate(unsigned queue_depth) {
+        auto ring = std::unique_ptr<UringRing>(new UringRing());
+        if (!ring->setup(queue_depth)) {
+            return nullptr;
+        }
+        return ring;
+    }
+
+    UringRing(const UringRing&) = delete;
+    UringRing& operator=(const UringRing&) = delete;
+
+    ~UringRing() {
+        if (_sq_ring != MAP_FAILED) ::munmap(_sq_ring, _sq_ring_size);
+        if (_cq_ring != MAP_FAILED && _cq_ring != _sq_ring) ::munmap(_cq_ring, _cq_ring_size);
+        if (_sqes != MAP_FAILED) ::munmap(_sqes, _sqes_size);
+        if (_ring_fd >= 0) ::close(_ring_fd);
+    }
+
+    // A ring whose submit failed is never entered again
+    bool broken() const { return _broken; }
+
+    void readBatch(std::vector<ReadRequest>& requests) {
+        // Submit in rounds of at most _sq_entries reads
+        for (size_t begin = 0; begin < requests.size(); begin += _sq_entries) {
+            size_t end = std::min(requests.size(), begin + _sq_entries);
+            if (_broken) {
+                for (size_t i = begin; i < end; ++i) requests[i].ok = preadFully(requests[i]);
+            } else {
+                submitAndWait(requests, begin, end);
+            }
+        }
+    }
+
+private:
+    UringRing() = default;
+
+    bool setup(unsigned queue_depth) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, queue_depth, &params));
+        if (fd < 0) {
+            return false;
+        }
+        _ring_fd = fd;
+        _sq_entries = params.sq_entries;
+
+        _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+        }
+
+        _sq_ring = ::mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd, IORING_OFF_SQ_RING);
+        if (_sq_ring == MAP_FAILED) return false;
+        _cq_ring = single_mmap ? _sq_ring
+                               : ::mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                        fd, IORING_OFF_CQ_RING);
+        if (_cq_ring == MAP_FAILED) return false;
+        _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        _sqes = ::mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd, IORING_OFF_SQES);
+        if (_sqes == MAP_FAILED) return false;
+
+        auto* sq = static_cast<char*>(_sq_ring);
+        auto* cq = static_cast<char*>(_cq_ring);
+        _sq_tail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        _sq_mask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        _sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        _cq_head  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        _cq_tail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        _cq_mask  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        _cqes     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void submitAndWait(std::vector<ReadRequest>& requests, size_t begin, size_t end) {
+        auto* sqes = static_cast<io_uring_sqe*>(_sqes);
+
+        // Step 1: queue one IORING_OP_READ per request
+        unsigned tail = *_sq_tail;
+        for (size_t i = begin; i < end; ++i) {
+            ReadRequest& request = requests[i];
+            request.data.resize(request.length);
+            request.ok = false;
+
+            unsigned slot = tail & *_sq_mask;
+            io_uring_sqe& sqe = sqes[slot];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode    = IORING_OP_READ;
+            sqe.fd        = request.fd;
+            sqe.off       = request.offset;
+            sqe.addr      = reinterpret_cast<uint64_t>(request.data.data());
+            sqe.len       = static_cast<uint32_t>(request.length);
+            sqe.user_data = i;
+            _sq_array[slot] = slot;
+            tail++;
+        }
+        __atomic_store_n(_sq_tail, tail, __ATOMIC_RELEASE);
+
+        // Step 2: submit the whole round with one call
+        unsigned to_submit = static_cast<unsigned>(end - begin);
+        long submitted = -1;
+        do {
+            submitted = ::syscall(__NR_io_uring_enter, _ring_fd, to_submit, 0, 0, nullptr, 0);
+        } while (submitted < 0 && errno == EINTR);
+        if (submitted < static_cast<long>(to_submit)) {
+            // Entries left in the ring point at caller buffers; never enter this ring again
+            std::cerr << "ERROR: io_uring submit failed, switching to pread" << std::endl;
+            _broken = true;
+        }
+
+        // Step 3: wait for and reap every submitted read
+        unsigned completed = 0;
+        unsigned expected = submitted > 0 ? static_cast<unsigned>(submitted) : 0;
+        while (completed < expected) {
+            unsigned head = *_cq_head;
+            if (head == __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) {
+                long ret = ::syscall(__NR_io_uring_enter, _ring_fd, 0, expected - completed,
+                                     IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (ret < 0 && errno != EINTR) {
+                    std::cerr << "ERROR: io_uring wait failed: " << std::strerror(errno) << std::endl;
+                    std::abort(); // Kernel still owns the buffers, there is no safe way out
+                }
+                continue;
+            }
+            while (head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = _cqes[head & *_cq_mask];
+                ReadRequest& request = requests[cqe.user_data];
+                if (cqe.res >= 0) {
+                    size_t got = static_cast<size_t>(cqe.res);
+                    // Short read, finish it synchronously
+                    request.ok = got == request.length || (got > 0 && preadFully(request, got));
+                }
+                head++;
+                completed++;
+            }
+            __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+        }
+
+        // Anything the ring failed on (old kernel without IORING_OP_READ, enter error) goes through pread
+        for (size_t i = begin; i < end; ++i) {
+            if (!requests[i].ok) requests[i].ok = preadFully(requests[i]);
+        }
+    }
+
+    bool          _broken = false;
+    int           _ring_fd = -1;
+    unsigned      _sq_entries = 0;
+    void*         _sq_ring = MAP_FAILED;
+    void*         _cq_ring = MAP_FAILED;
+    void*         _sqes = MAP_FAILED;
+    size_t        _sq_ring_size = 0;
+    size_t        _cq_ring_size = 0;
+    size_t        _sqes_size = 0;
+    unsigned*     _sq_tail = nullptr;
+    unsigned*     _sq_mask = nullptr;
+    unsigned*     _sq_array = nullptr;
+    unsigned*     _cq_head = nullptr;
+    unsigned*     _cq_tail = nullptr;
+    unsigned*     _cq_mask = nullptr;
+    io_uring_cqe* _cqes = nullptr;
+};
+
+// Concurrent batches each take a ring of their own from a pool, so readers and
+// subcompactions do not wait for each other's I/O. The pool grows to the
+// highest number of batches that were in flight at once.
+class UringBackend : public IoBackend {
+public:
+    // Returns nullptr if the kernel does not let us set up a ring
+    static std::shared_ptr<UringBackend> tryCreate(unsigned queue_depth) {
+        auto ring = UringRing::tryCreate(queue_depth);
+        if (!ring) {
+            return nullptr;
+        }
+        auto backend = std::shared_ptr<UringBackend>(new UringBackend(queue_depth));
+        backend->_idle.push_back(std::move(ring));
+        return backend;
+    }
+
+    void readBatch(std::vector<ReadRequest>& requests) override {
+        std::unique_ptr<UringRing> ring;
+        {
+            std::lock_guard<std::mutex> lock(_mutex); // Only guards the pool, not the I/O
+            if (!_idle.empty()) {
+                ring = std::move(_idle.back());
+                _idle.pop_back();
+            }
+        }
+        if (!ring) ring = UringRing::tryCreate(_queue_depth);
+        if (!ring) {
+            for (auto& request : requests) request.ok = preadFully(request);
+            return;
+        }
+
+        ring->readBatch(requests);
+        if (ring->broken()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _idle.push_back(std::move(ring));
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+private:
+    explicit UringBackend(unsigned queue_depth) : _queue_depth(queue_depth) {}
+
+    unsigned _queue_depth;
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<UringRing>> _idle;
+};
+#endif
+
+} // namespace
+
+std::shared_ptr<IoBackend> IoBackend::create(unsigned queue_depth) {
+#ifdef KV_HAVE_IO_URING
+    if (auto uring = UringBackend::tryCreate(queue_depth)) {
+        std::cout << "DEBUG: IoBackend - using io_uring (queue depth " << queue_depth << ")" << std::endl;
+        return uring;
+    }
+    std::cout << "DEBUG: IoBackend - io_uring unavailable, falling back to pread" << std::endl;
+#else
+    (void)queue_depth;
+#endif
+    return createPread();
+}
+
+std::shared_ptr<IoBackend> IoBackend::createPread() {
+    return std::make_shared<PreadBackend>();
+}
+
+} // namespace kv
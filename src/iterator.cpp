@@ -0,0 +1,365 @@
+#include "kv/iterator.hpp"
+#include "kv/memtable.hpp"
+#include "kv/kv_store.hpp"
+#include "kv/compaction_filter.hpp"
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace kv {
+
+namespace {
+
+// Sorted snapshot of a MemTable, one visible version per key
+class MemTableCursor : public Cursor {
+public:
+    explicit MemTableCursor(std::vector<Entry> entries)
+        : _entries(std::move(entries)), _pos(_entries.size()) {}
+
+    bool valid() const override { return _pos < _entries.size(); }
+    void seekToFirst() override { _pos = 0; }
+    void seekToLast() override { _pos = _entries.empty() ? 0 : _entries.size() - 1; }
+
+    void seek(const std::string& target) override {
+        auto it = std::lower_bound(_entries.begin(), _entries.end(), target,
+                                   [](const Entry& entry, const std::string& t) { return entry.key < t; });
+        _pos = static_cast<size_t>(it - _entries.begin());
+    }
+
+    void next() override { ++_pos; }
+    void prev() override { _pos = _pos == 0 ? _entries.size() : _pos - 1; }
+
+    const std::string& key() const override { return _entries[_pos].key; }
+    const std::string& value() const override { return _entries[_pos].value; }
+    SequenceNumber sequence() const override { return _entries[_pos].seq; }
+
+private:
+    std::vector<Entry> _entries;
+    size_t _pos; // == _entries.size() when not valid
+};
+
+// Record-at-a-time cursor over one SSTable, stopping only on the newest
+// version of each key that is visible at the snapshot
+// format: [key_len][key_data][seq][value_len][value_data]
+class SSTableCursor : public Cursor {
+public:
+    static constexpr size_t kReadaheadBytes = 256 * 1024;
+
+    SSTableCursor(std::shared_ptr<TableFile> table, SequenceNumber snapshot)
+        : _table(std::move(table)),
+          _index(_table->index()),
+          _snapshot(snapshot),
+          _readahead(kReadaheadBytes),
+          _valid(false),
+          _seq(0),
+          _offset(0),
+          _next_offset(0),
+          _stream_pos(UINT64_MAX)
+    {
+        // The buffer must be installed before open() to take effect
+        _in.rdbuf()->pubsetbuf(_readahead.data(), static_cast<std::streamsize>(_readahead.size()));
+        _in.open(_table->path(), std::ios::binary);
+        if (!_in.is_open()) {
+            throw std::runtime_error("Cannot open SSTable for iteration: " + _table->path());
+        }
+    }
+
+    bool valid() const override { return _valid; }
+    void seekToFirst() override { forwardFrom(0, nullptr); }
+    void seekToLast() override { positionBefore(_index->fileSize(), nullptr); }
+
+    void seek(const std::string& target) override {
+        auto block = _index->findBlock(target);
+        uint64_t offset = block ? block->first : 0;
+        while (readAt(offset) && (_key < target || _seq > _snapshot)) {
+            offset = _next_offset;
+        }
+    }
+
+    void next() override {
+        std::string current = _key;
+        forwardFrom(_next_offset, &current);
+    }
+
+    void prev() override {
+        std::string current = _key;
+        positionBefore(_offset, &current);
+    }
+
+    const std::string& key() const override { return _key; }
+    const std::string& value() const override { return _value; }
+    SequenceNumber sequence() const override { return _seq; }
+
+private:
+    // Load the record starting at offset, invalidating the cursor at EOF
+    bool readAt(uint64_t offset) {
+        _valid = false;
+        if (offset >= _index->fileSize()) {
+            return false;
+        }
+        // Seeking drops the stream buffer, only do it when not already there
+        if (_stream_pos != offset) {
+            _in.clear();
+            _in.seekg(static_cast<std::streamoff>(offset));
+        }
+
+        uint32_t key_len, value_len;
+        if (!_in.read(reinterpret_cast<char*>(&key_len), sizeof(key_len))) return fail();
+        _key.resize(key_len);
+        if (!_in.read(_key.data(), key_len)) return fail();
+        if (!_in.read(reinterpret_cast<char*>(&_seq), sizeof(_seq))) return fail();
+        if (!_in.read(reinterpret_cast<char*>(&value_len), sizeof(value_len))) return fail();
+        _value.resize(value_len);
+        if (!_in.read(_value.data(), value_len)) return fail();
+
+        _offset = offset;
+        _next_offset = offset + sizeof(key_len) + key_len + sizeof(_seq) + sizeof(value_len) + value_len;
+        _stream_pos = _next_offset;
+        _valid = true;
+        return true;
+    }
+
+    bool fail() {
+        _stream_pos = UINT64_MAX;
+        _valid = false;
+        return false;
+    }
+
+    // Stop on the first visible record at or after offset whose key is not skip_key
+    void forwardFrom(uint64_t offset, const std::string* skip_key) {
+        while (readAt(offset) && ((skip_key && _key == *skip_key) || _seq > _snapshot)) {
+            offset = _next_offset;
+        }
+    }
+
+    // Position on the visible version of the last key that starts before end
+    // (and sorts before skip_key). Blocks start on a new key, so each key's
+    // versions are in one block.
+    void positionBefore(uint64_t end, const std::string* skip_key) {
+        while (true) {
+            auto start = _index->blockBefore(end);
+            if (!start) {
+                _valid = false;
+                return;
+            }
+            uint64_t offset = *start;
+            uint64_t group_start = offset;
+            std::string group_key;
+            std::optional<uint64_t> visible;
+            bool any = false;
+            while (offset < end && readAt(offset) && !(skip_key && _key == *skip_key)) {
+                if (!any || _key != group_key) {
+                    group_key = _key;
+                    group_start = offset;
+                    visible.reset();
+                    any = true;
+                }
+                if (!visible && _seq <= _snapshot) visible = offset;
+                offset = _next_offset;
+            }
+            if (visible) {
+                readAt(*visible);
+                return;
+            }
+            if (!any) {
+                _valid = false;
+                return;
+            }
+            // Every version of that key is newer than the snapshot, look before it
+            end = group_start;
+            skip_key = nullptr;
+        }
+    }
+
+    std::shared_ptr<TableFile>      _table; // Keeps the file from being deleted
+    std::shared_ptr<const KeyIndex> _index;
+    SequenceNumber    _snapshot;
+    std::vector<char> _readahead;
+    std::ifstream     _in;
+    bool              _valid;
+    std::string       _key;
+    std::string       _value;
+    SequenceNumber    _seq;
+    uint64_t          _offset;      // Offset of the current record
+    uint64_t          _next_offset; // Offset right after the current record
+    uint64_t          _stream_pos;  // Where the next sequential read lands
+};
+
+} // namespace
+
+std::unique_ptr<Cursor> newMemTableCursor(const MemTable& table, SequenceNumber snapshot) {
+    return std::make_unique<MemTableCursor>(table.visibleEntries(snapshot));
+}
+
+std::unique_ptr<Cursor> newSSTableCursor(std::shared_ptr<TableFile> table, SequenceNumber snapshot) {
+    return std::make_unique<SSTableCursor>(std::move(table), snapshot);
+}
+
+Iterator::Iterator(std::vector<std::unique_ptr<Cursor>> sources,
+                   std::shared_ptr<const FragmentedRangeTombstones> range_tombstones,
+                   std::chrono::seconds ttl)
+    : _sources(std::move(sources)),
+      _range_tombstones(std::move(range_tombstones)),
+      _ttl(ttl),
+      _now(ttl.count() > 0 ? unixSeconds() : 0),
+      _direction(Direction::Forward),
+      _valid(false)
+{}
+
+bool Iterator::valid() const {
+    return _valid;
+}
+
+void Iterator::seekToFirst() {
+    for (auto& source : _sources) source->seekToFirst();
+    _direction = Direction::Forward;
+    findNextLive();
+}
+
+void Iterator::seekToLast() {
+    for (auto& source : _sources) source->seekToLast();
+    _direction = Direction::Reverse;
+    findPrevLive();
+}
+
+void Iterator::seek(const std::string& target) {
+    for (auto& source : _sources) source->seek(target);
+    _direction = Direction::Forward;
+    findNextLive();
+}
+
+void Iterator::upperBound(const std::string& target) {
+    seek(target);
+    if (_valid && _key == target) {
+        next();
+    }
+}
+
+void Iterator::next() {
+    if (!_valid) return;
+
+    if (_direction == Direction::Reverse) {
+        // Sources sit at or before _key, move all of them past it
+        for (auto& source : _sources) {
+            source->seek(_key);
+            if (source->valid() && source->key() == _key) source->next();
+        }
+        _direction = Direction::Forward;
+    } else {
+        // Every source holding a version of _key is parked on it
+        for (auto& source : _sources) {
+            if (source->valid() && source->key() == _key) source->next();
+        }
+    }
+    findNextLive();
+}
+
+void Iterator::prev() {
+    if (!_valid) return;
+
+    if (_direction == Direction::Forward) {
+        // Sources sit at or after _key, move all of them before it
+        for (auto& source : _sources) {
+            source->seek(_key);
+            if (source->valid()) {
+                source->prev();
+            } else {
+                source->seekToLast();
+            }
+        }
+        _direction = Direction::Reverse;
+    } else {
+        for (auto& source : _sources) {
+            if (source->valid() && source->key() == _key) source->prev();
+        }
+    }
+    findPrevLive();
+}
+
+const std::string& Iterator::key() const {
+    return _key;
+}
+
+const std::string& Iterator::value() const {
+    return _value;
+}
+
+// Smallest key wins; for equal keys the higher sequence, then the earlier (newer) source
+Cursor* Iterator::pickSmallest() const {
+    Cursor* winner = nullptr;
+    for (auto& source : _sources) {
+        if (!source->valid()) continue;
+        if (!winner || source->key() < winner->key() ||
+            (source->key() == winner->key() && source->sequence() > winner->sequence())) {
+            winner = source.get();
+        }
+    }
+    return winner;
+}
+
+Cursor* Iterator::pickLargest() const {
+    Cursor* winner = nullptr;
+    for (auto& source : _sources) {
+        if (!source->valid()) continue;
+        if (!winner || source->key() > winner->key() ||
+            (source->key() == winner->key() && source->sequence() > winner->sequence())) {
+            winner = source.get();
+        }
+    }
+    return winner;
+}
+
+bool Iterator::isDeleted(const Cursor& newest) const {
+    if (newest.value() == TOMB_STONE) return true;
+    if (_ttl.count() > 0 && !unwrapTtl(newest.value(), _ttl, _now)) return true;
+    return _range_tombstones && _range_tombstones->coveringSeq(newest.key()) > newest.sequence();
+}
+
+void Iterator::settleOn(const Cursor& newest) {
+    _key = newest.key();
+    _value = _ttl.count() > 0 ? *unwrapTtl(newest.value(), _ttl, _now) : newest.value();
+    _valid = true;
+}
+
+void Iterator::findNextLive() {
+    while (true) {
+        Cursor* winner = pickSmallest();
+        if (!winner) {
+            _valid = false;
+            return;
+        }
+        if (!isDeleted(*winner)) {
+            settleOn(*winner);
+            return;
+        }
+
+        // Newest version is deleted, skip the key in every source
+        std::string deleted = winner->key();
+        for (auto& source : _sources) {
+            if (source->valid() && source->key() == deleted) source->next();
+        }
+    }
+}
+
+void Iterator::findPrevLive() {
+    while (true) {
+        Cursor* winner = pickLargest();
+        if (!winner) {
+            _valid = false;
+            return;
+        }
+        if (!isDeleted(*winner)) {
+            settleOn(*winner);
+            return;
+        }
+
+        std::string deleted = winner->key();
+        for (auto& source : _sources) {
+            if (source->valid() && source->key() == deleted) source->prev();
+        }
+    }
+}
+
+} // namespace kv
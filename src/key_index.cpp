@@ -0,0 +1,202 @@
+#include "kv/key_index.hpp"
+#include <algorithm>
+#include <climits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define KV_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace kv {
+
+namespace {
+
+// Binary search narrows the range down to this many fingerprints,
+// the rest is counted branch-free by the selected kernel
+constexpr size_t kLinearWindow = 32;
+
+size_t countScalar(const uint64_t* fps, size_t n, uint64_t target) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        count += fps[i] < target;
+    }
+    return count;
+}
+
+#ifdef KV_X86_KERNELS
+// There is no unsigned 64-bit compare before AVX-512, so both sides are
+// biased by 2^63 and compared as signed integers instead
+__attribute__((target("sse4.2")))
+size_t countSSE42(const uint64_t* fps, size_t n, uint64_t target) {
+    const __m128i bias = _mm_set1_epi64x(LLONG_MIN);
+    const __m128i t = _mm_xor_si128(_mm_set1_epi64x(static_cast<long long>(target)), bias);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(fps + i)), bias);
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(t, x)));
+        count += static_cast<size_t>(__builtin_popcount(mask));
+    }
+    return count + countScalar(fps + i, n - i, target);
+}
+
+__attribute__((target("avx2")))
+size_t countAVX2(const uint64_t* fps, size_t n, uint64_t target) {
+    const __m256i bias = _mm256_set1_epi64x(LLONG_MIN);
+    const __m256i t = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(target)), bias);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(fps + i)), bias);
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(t, x)));
+        count += static_cast<size_t>(__builtin_popcount(mask));
+    }
+    return count + countScalar(fps + i, n - i, target);
+}
+#endif
+
+} // namespace
+
+SearchKernel detectSearchKernel() {
+#ifdef KV_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SearchKernel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return SearchKernel::SSE42;
+    }
+#endif
+    return SearchKernel::Scalar;
+}
+
+const char* searchKernelName(SearchKernel kernel) {
+    switch (kernel) {
+        case SearchKernel::AVX2:  return "avx2";
+        case SearchKernel::SSE42: return "sse4.2";
+        default:                  return "scalar";
+    }
+}
+
+uint64_t keyFingerprint(std::string_view key, size_t skip) {
+    uint64_t fp = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        size_t pos = skip + i;
+        uint8_t byte = pos < key.size() ? static_cast<uint8_t>(key[pos]) : 0;
+        fp = (fp << 8) | byte;
+    }
+    return fp;
+}
+
+size_t countLessThan(const uint64_t* fps, size_t n, uint64_t target, SearchKernel kernel) {
+    size_t lo = 0;
+    size_t len = n;
+    while (len > kLinearWindow) {
+        size_t half = len / 2;
+        if (fps[lo + half] < target) {
+            lo += half + 1;
+            len -= half + 1;
+        } else {
+            len = half;
+        }
+    }
+
+    switch (kernel) {
+#ifdef KV_X86_KERNELS
+        case SearchKernel::AVX2:  return lo + countAVX2(fps + lo, len, target);
+        case SearchKernel::SSE42: return lo + countSSE42(fps + lo, len, target);
+#endif
+        default:                  return lo + countScalar(fps + lo, len, target);
+    }
+}
+
+KeyIndex::KeyIndex()
+    : _prefix_len(0),
+      _file_size(0),
+      _kernel(detectSearchKernel())
+{}
+
+void KeyIndex::add(const std::string& key, uint64_t offset) {
+    _keys.push_back(key);
+    _offsets.push_back(offset);
+}
+
+void KeyIndex::finish(uint64_t file_size) {
+    _file_size = file_size;
+    _prefix_len = 0;
+    _fingerprints.clear();
+    if (_keys.empty()) {
+        return;
+    }
+
+    // Keys are sorted, so the prefix shared by the first and last key is shared by all
+    const std::string& first = _keys.front();
+    const std::string& last = _keys.back();
+    size_t max_prefix = std::min(first.size(), last.size());
+    while (_prefix_len < max_prefix && first[_prefix_len] == last[_prefix_len]) {
+        ++_prefix_len;
+    }
+
+    _fingerprints.reserve(_keys.size());
+    for (const auto& key : _keys) {
+        _fingerprints.push_back(keyFingerprint(key, _prefix_len));
+    }
+}
+
+size_t KeyIndex::upperBound(const std::string& key) const {
+    size_t n = _keys.size();
+
+    // Keys outside the shared prefix sort before or after every indexed key
+    int prefix_cmp = key.compare(0, _prefix_len, _keys.front(), 0, _prefix_len);
+    if (prefix_cmp < 0) return 0;
+    if (prefix_cmp > 0) return n;
+
+    // [lt, le) is the run of fingerprints equal to the target's
+    uint64_t fp = keyFingerprint(key, _prefix_len);
+    size_t lt = countLessThan(_fingerprints.data(), n, fp, _kernel);
+    size_t le = fp == UINT64_MAX ? n : countLessThan(_fingerprints.data(), n, fp + 1, _kernel);
+    if (lt == le) {
+        return lt;
+    }
+
+    // Fingerprints tie, fall back to comparing full keys inside the run
+    auto begin = _keys.begin() + static_cast<std::ptrdiff_t>(lt);
+    auto end = _keys.begin() + static_cast<std::ptrdiff_t>(le);
+    return static_cast<size_t>(std::upper_bound(begin, end, key) - _keys.begin());
+}
+
+std::optional<std::pair<uint64_t, uint64_t>>
+KeyIndex::findBlock(const std::string& key) const {
+    if (_keys.empty()) {
+        return std::nullopt;
+    }
+    size_t ub = upperBound(key);
+    if (ub == 0) {
+        return std::nullopt; // key < first key in the table
+    }
+    size_t block = ub - 1;
+    uint64_t end = block + 1 < _offsets.size() ? _offsets[block + 1] : _file_size;
+    return std::make_pair(_offsets[block], end);
+}
+
+std::optional<uint64_t> KeyIndex::blockBefore(uint64_t offset) const {
+    auto it = std::lower_bound(_offsets.begin(), _offsets.end(), offset);
+    if (it == _offsets.begin()) {
+        return std::nullopt;
+    }
+    return *(it - 1);
+}
+
+size_t KeyIndex::size() const {
+    return _keys.size();
+}
+
+uint64_t KeyIndex::fileSize() const {
+    return _file_size;
+}
+
+const std::vector<std::string>& KeyIndex::keys() const {
+    return _keys;
+}
+
+} // namespace kv
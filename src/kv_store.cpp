@@ -1,46 +1,192 @@
 #include "kv/kv_store.hpp"
+#include "kv/compaction_filter.hpp"
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 
 namespace kv {
 
 // Constructor
-KVStore::KVStore(const std::string& db_path, std::shared_ptr<LockManager> lock_mgr)
+KVStore::KVStore(const std::string& db_path, std::shared_ptr<LockManager> lock_mgr, const Options& options)
     : _db_path {db_path},
       _wal_path {db_path + "/wal.log"},     // WAL inside the directory
       _wal {_wal_path},
-      _memtable {},
-      _reader {db_path, lock_mgr},
-      _lock_mgr {lock_mgr}
+      _memtable {std::make_shared<MemTable>()},
+      _versions {std::make_shared<VersionSet>(db_path)},
+      _reader {db_path, lock_mgr, _versions},
+      _lock_mgr {lock_mgr},
+      _last_sequence {_versions->lastSequence()},
+      _options {options},
+      _writer {db_path, options.rate_limiter}
 {
     // (1) Create db directory if it doesn't exist
     std::filesystem::create_directories(db_path);
 
-    // (2) SSTables min/max key indexes are automatically loaded in SSTableReader constructor
+    // (2) Live SSTables were recovered from the MANIFEST by the VersionSet constructor
     
     // (3) Replay WAL to restore in-memory state
     std::cout << "DEBUG: KVStore created with WAL path: " << _wal_path << std::endl;
     replayWAL();
+
+    // (4) Background flusher, woken by put() once the MemTable is full
+    _flusher = std::make_unique<Flusher>(_memtable, _memtable_mutex, _immutable_mutex, _writer,
+                                         _options.memtable_flush_threshold, _lock_mgr, _versions,
+                                         _options.flush_threads);
+    _flusher->setFlushListener([this] { notifySSTableListener(); });
+    // A read hotspot is compaction work just like a new table
+    _reader.setSeekListener([this] { notifySSTableListener(); });
+    _flusher->start();
+
+    // (5) Optional row cache for hot keys
+    if (_options.row_cache_bytes > 0) {
+        _row_cache = std::make_unique<RowCache>(_options.row_cache_bytes, _options.row_cache_shards);
+        std::cout << "DEBUG: KVStore row cache enabled: " << _options.row_cache_bytes << " bytes in "
+                  << _options.row_cache_shards << " shards" << std::endl;
+    }
 }
 
 KVStore::~KVStore() = default;
 
-// Write to KVStore, first append to WAL, then insert into MemTable
+// Write to KVStore, first append to WAL, then insert into MemTable.
+// With a TTL the write time travels with the value, through the WAL into the SSTables
 void KVStore::put(const std::string& key, const std::string& value) {
-    std::string record = key + " " + value + "\n";
+    if (_options.ttl.count() > 0) {
+        write(key, appendWriteTime(value, unixSeconds()));
+        return;
+    }
+    write(key, value);
+}
+
+// WAL record format: "<seq> <key> <value>"
+void KVStore::write(const std::string& key, const std::string& value) {
+    std::lock_guard<std::mutex> lock(_write_mutex);
+    SequenceNumber seq = _last_sequence.load() + 1;
+    std::string record = std::to_string(seq) + " " + key + " " + value + "\n";
     std::cout << "DEBUG: KVStore::put() - Writing to WAL: '" << record.substr(0, record.length()-1) << "'" << std::endl;
     
     // durable write by WAL first
     _wal.appendRecord(record);   
-    // in-memory insert to MemTable
-    _memtable.put(key, value);
+    // in-memory insert to MemTable, dropping versions no snapshot can see anymore.
+    // A read pinning the latest sequence after oldest() was taken gets seq - 1,
+    // so the newest version at or below seq - 1 is kept as well.
+    bool full;
+    {
+        static const LockSite kSite("KVStore::write");
+        auto memtable_lock = _lock_mgr->acquireMemTableLock(_memtable_mutex, kSite);
+        _memtable->put(key, value, seq, std::min(_snapshots.oldest(), seq - 1));
+        full = _memtable->size() >= _options.memtable_flush_threshold;
+    }
+    if (full) {
+        _flusher->scheduleFlush();
+    }
+    if (_row_cache) {
+        _row_cache->erase(key, seq);
+    }
+    // Readers only see the write once it is fully applied
+    _last_sequence.store(seq);
+}
+
+ReadPin KVStore::readSnapshot(const std::shared_ptr<const Snapshot>& snapshot) {
+    return snapshot ? ReadPin(snapshot) : _snapshots.pinLatest(_last_sequence);
+}
+
+std::optional<std::string> KVStore::get(const std::string& key, const std::shared_ptr<const Snapshot>& snapshot) {
+    // An auto-tuning rate limiter slows background I/O down while reads get slow
+    if (_options.rate_limiter && _options.rate_limiter->autoTuning()) {
+        auto start = std::chrono::steady_clock::now();
+        auto result = lookup(key, snapshot);
+        _options.rate_limiter->recordForegroundLatency(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+        return result;
+    }
+    return lookup(key, snapshot);
+}
+
+// The row cache holds stamped values, so a cached value expires like any other
+std::optional<std::string> KVStore::lookup(const std::string& key, const std::shared_ptr<const Snapshot>& snapshot) {
+    // Snapshot reads want an older state than the cache holds
+    if (snapshot || !_row_cache) {
+        return liveValue(resolve(key, readSnapshot(snapshot).sequence()));
+    }
+
+    if (auto hit = _row_cache->lookup(key)) {
+        std::cout << "DEBUG: KVStore::get() - Row cache hit for key '" << key << "'" << std::endl;
+        return liveValue(*hit);
+    }
+    uint64_t generation = _row_cache->generation(key);
+    auto pin = readSnapshot(nullptr);
+    SequenceNumber seq = pin.sequence();
+    auto result = resolve(key, seq);
+    _row_cache->insert(key, result, seq, generation);
+    return liveValue(std::move(result));
+}
+
+std::optional<std::string> KVStore::liveValue(std::optional<std::string> stored) const {
+    if (!stored || _options.ttl.count() == 0) {
+        return stored;
+    }
+    return unwrapTtl(*stored, _options.ttl, unixSeconds());
 }
 
-// In-memory lookup MemTable
-std::optional<std::string> KVStore::get(const std::string& key) {
+// Frozen MemTables (newest first) are checked before the SSTables: once one is gone its SSTable is live
+std::optional<std::string> KVStore::memtableGet(const std::string& key, SequenceNumber seq, SequenceNumber* found_seq) {
+    {
+        static const LockSite kSite("KVStore::memtableGet");
+        auto memtable_lock = _lock_mgr->acquireMemTableLock(_memtable_mutex, kSite);
+        if (auto v = _memtable->get(key, seq, found_seq)) return v;
+    }
+    for (const auto& immutable : _flusher->immutableTables()) {
+        if (auto v = immutable->get(key, seq, found_seq)) return v;
+    }
+    return std::nullopt;
+}
+
+// Same order as memtableGet(): a flushed tombstone is in the version before its MemTable is dropped
+SequenceNumber KVStore::rangeTombstoneSeq(const std::string& key, SequenceNumber seq) {
+    SequenceNumber newest;
+    {
+        static const LockSite kSite("KVStore::rangeTombstoneSeq");
+        auto memtable_lock = _lock_mgr->acquireMemTableLock(_memtable_mutex, kSite);
+        newest = _memtable->rangeTombstoneSeq(key, seq);
+    }
+    for (const auto& immutable : _flusher->immutableTables()) {
+        newest = std::max(newest, immutable->rangeTombstoneSeq(key, seq));
+    }
+    return std::max(newest, _reader.currentVersion()->range_tombstone_index.coveringSeq(key, seq));
+}
+
+std::shared_ptr<const FragmentedRangeTombstones> KVStore::visibleRangeTombstones(SequenceNumber seq) {
+    std::vector<RangeTombstone> visible;
+    auto collect = [&](const std::vector<RangeTombstone>& tombstones) {
+        for (const auto& tombstone : tombstones) {
+            if (tombstone.seq <= seq) visible.push_back(tombstone);
+        }
+    };
+    {
+        static const LockSite kSite("KVStore::visibleRangeTombstones");
+        auto memtable_lock = _lock_mgr->acquireMemTableLock(_memtable_mutex, kSite);
+        collect(_memtable->rangeTombstones());
+    }
+    for (const auto& immutable : _flusher->immutableTables()) {
+        collect(immutable->rangeTombstones());
+    }
+    collect(_reader.currentVersion()->range_tombstones);
+    if (visible.empty()) {
+        return nullptr;
+    }
+    return std::make_shared<const FragmentedRangeTombstones>(visible);
+}
+
+// In-memory lookup MemTable, then SSTables; tombstones resolve to nullopt, and so
+// do versions older than a range tombstone covering the key
+std::optional<std::string> KVStore::resolve(const std::string& key, SequenceNumber seq) {
+    SequenceNumber range_deleted = rangeTombstoneSeq(key, seq);
+    SequenceNumber found_seq = 0;
+
     // Search in-memory hash table
-    if (auto v = _memtable.get(key)) {
-        if (*v == TOMB_STONE) {
+    if (auto v = memtableGet(key, seq, &found_seq)) {
+        if (*v == TOMB_STONE || found_seq < range_deleted) {
             std::cout << "DEBUG: KVStore::get() - key has been deleted in MemTable" << std::endl;
             return std::nullopt;
         }
@@ -50,8 +196,8 @@ std::optional<std::string> KVStore::get(const std::string& key) {
     std::cout << "DEBUG: KVStore::get() - Key '" << key << "' not found in memory, scanning on-disk SSTables" << std::endl;
 
     // Fall back to SSTables read
-    auto result = _reader.get(key);
-    if (result && *result == TOMB_STONE) {
+    auto result = _reader.get(key, seq, &found_seq);
+    if (result && (*result == TOMB_STONE || found_seq < range_deleted)) {
             std::cout << "DEBUG: KVStore::get() - key has been deleted in SSTables" << std::endl;
             return std::nullopt;
     }
@@ -59,6 +205,74 @@ std::optional<std::string> KVStore::get(const std::string& key) {
     return result;
 }
 
+std::vector<std::optional<std::string>> KVStore::multiGet(const std::vector<std::string>& keys,
+                                                          const std::shared_ptr<const Snapshot>& snapshot) {
+    auto pin = readSnapshot(snapshot);
+    SequenceNumber seq = pin.sequence();
+    std::vector<std::optional<std::string>> results(keys.size());
+    auto range_tombstones = visibleRangeTombstones(seq);
+
+    // Step 1: probe the MemTable, keep the misses
+    std::vector<size_t> misses;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        // Range deleted keys need the seq of the version they find, take the single key path
+        if (range_tombstones && range_tombstones->coveringSeq(keys[i]) > 0) {
+            results[i] = resolve(keys[i], seq);
+            continue;
+        }
+        if (auto v = memtableGet(keys[i], seq)) {
+            if (*v != TOMB_STONE) results[i] = std::move(v);
+        } else {
+            misses.push_back(i);
+        }
+    }
+    std::cout << "DEBUG: KVStore::multiGet() - " << keys.size() - misses.size() << " of " << keys.size()
+              << " keys resolved in MemTable" << std::endl;
+
+    // Step 2: sorted, de-duplicated batch for the SSTables
+    if (!misses.empty()) {
+        std::vector<std::string> sorted_keys;
+        sorted_keys.reserve(misses.size());
+        for (size_t i : misses) sorted_keys.push_back(keys[i]);
+        std::sort(sorted_keys.begin(), sorted_keys.end());
+        sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end()), sorted_keys.end());
+
+        auto found = _reader.multiGet(sorted_keys, seq);
+        for (size_t i : misses) {
+            size_t pos = static_cast<size_t>(std::lower_bound(sorted_keys.begin(), sorted_keys.end(), keys[i]) - sorted_keys.begin());
+            if (found[pos] && *found[pos] != TOMB_STONE) {
+                results[i] = found[pos];
+            }
+        }
+    }
+
+    for (auto& result : results) {
+        result = liveValue(std::move(result));
+    }
+    return results;
+}
+
+// Merge the MemTables (newest) with every SSTable (newest -> oldest)
+// MemTable cursors copy their entries, the pin is only needed while they are taken
+std::unique_ptr<Iterator> KVStore::newIterator(const std::shared_ptr<const Snapshot>& snapshot) {
+    auto pin = readSnapshot(snapshot);
+    SequenceNumber seq = pin.sequence();
+    std::vector<std::unique_ptr<Cursor>> sources;
+    {
+        static const LockSite kSite("KVStore::newIterator");
+        auto memtable_lock = _lock_mgr->acquireMemTableLock(_memtable_mutex, kSite);
+        sources.push_back(newMemTableCursor(*_memtable, seq));
+    }
+    for (const auto& immutable : _flusher->immutableTables()) {
+        sources.push_back(newMemTableCursor(*immutable, seq));
+    }
+    for (auto& cursor : _reader.newCursors(seq)) {
+        sources.push_back(std::move(cursor));
+    }
+    std::cout << "DEBUG: KVStore::newIterator() - Merging " << sources.size() << " sources" << std::endl;
+    return std::make_unique<Iterator>(std::move(sources), visibleRangeTombstones(seq), _options.ttl);
+}
+
 // Replay WAL to restore in-memory state
 void KVStore::replayWAL() {
     std::cout << "DEBUG: Attempting to replay WAL from: " << _wal_path << std::endl;
@@ -72,23 +286,135 @@ void KVStore::replayWAL() {
         std::cout << "DEBUG: Read WAL line " << line_count << ": '" << line << "'" << std::endl;
         
         std::istringstream iss(line);
+        std::string first, second, third;
+        if (!(iss >> first >> second)) continue;
+
+        // "<seq> <key> <value>", or "<key> <value>" from logs written before sequence numbers
+        SequenceNumber seq;
         std::string key, value;
-        if (iss >> key >> value) {
-            std::cout << "DEBUG: Replaying - Key: '" << key << "', Value: '" << value << "'" << std::endl;
-            _memtable.put(key, value);
+        if (iss >> third) {
+            seq = std::stoull(first);
+            key = second;
+            value = third;
+        } else {
+            seq = _last_sequence.load() + 1;
+            key = first;
+            value = second;
+        }
+        // Already in an SSTable the flusher logged to the MANIFEST
+        if (seq <= _versions->lastSequence()) {
+            continue;
         }
+        std::cout << "DEBUG: Replaying - Seq: " << seq << ", Key: '" << key << "', Value: '" << value << "'" << std::endl;
+        if (value.compare(0, RANGE_TOMB_STONE.size(), RANGE_TOMB_STONE) == 0) {
+            _memtable->deleteRange(key, value.substr(RANGE_TOMB_STONE.size()), seq);
+        } else {
+            _memtable->put(key, value, seq);
+        }
+        _last_sequence.store(std::max(_last_sequence.load(), seq));
     }
-    std::cout << "DEBUG: WAL replay completed, processed " << line_count << " lines" << std::endl;
+    std::cout << "DEBUG: WAL replay completed, processed " << line_count << " lines, last sequence " << _last_sequence.load() << std::endl;
 }
 
 void KVStore::del(const std::string& key) {
-    std::string record = key + " " + TOMB_STONE + "\n";
-    _wal.appendRecord(record);   
-    _memtable.put(key, TOMB_STONE);
+    write(key, TOMB_STONE);
+}
+
+// WAL record format: "<seq> <begin> __RANGE_TOMBSTONE__<end>"
+void KVStore::deleteRange(const std::string& begin, const std::string& end) {
+    if (begin >= end) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_write_mutex);
+    SequenceNumber seq = _last_sequence.load() + 1;
+    std::string record = std::to_string(seq) + " " + begin + " " + RANGE_TOMB_STONE + end + "\n";
+    std::cout << "DEBUG: KVStore::deleteRange() - Writing to WAL: '" << record.substr(0, record.length()-1) << "'" << std::endl;
+
+    _wal.appendRecord(record);
+    bool full;
+    {
+        static const LockSite kSite("KVStore::deleteRange");
+        auto memtable_lock = _lock_mgr->acquireMemTableLock(_memtable_mutex, kSite);
+        _memtable->deleteRange(begin, end, seq);
+        full = _memtable->size() >= _options.memtable_flush_threshold;
+    }
+    if (full) {
+        _flusher->scheduleFlush();
+    }
+    if (_row_cache) {
+        _row_cache->eraseRange(begin, end, seq);
+    }
+    // Readers only see the deletion once it is fully applied
+    _last_sequence.store(seq);
+}
+
+std::shared_ptr<const Snapshot> KVStore::getSnapshot() {
+    // Under the write lock, so no put can prune a version this snapshot still needs
+    std::lock_guard<std::mutex> lock(_write_mutex);
+    return _snapshots.acquire(_last_sequence.load());
+}
+
+std::vector<SequenceNumber> KVStore::liveSnapshots() const {
+    return _snapshots.live();
+}
+
+SequenceNumber KVStore::lastSequence() const {
+    return _last_sequence.load();
+}
+
+void KVStore::invalidateCachedRows(const std::vector<std::string>& keys) {
+    if (_row_cache && !keys.empty()) {
+        _row_cache->invalidate(keys);
+    }
+}
+
+const RowCache* KVStore::rowCache() const {
+    return _row_cache.get();
+}
+
+std::shared_ptr<RateLimiter> KVStore::rateLimiter() const {
+    return _options.rate_limiter;
+}
+
+std::shared_ptr<CompactionFilter> KVStore::compactionFilter() const {
+    return _options.compaction_filter;
+}
+
+std::chrono::seconds KVStore::ttl() const {
+    return _options.ttl;
+}
+
+uint64_t KVStore::flushedBytes() const {
+    return _flusher->bytesFlushed();
+}
+
+void KVStore::setSSTableListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(_listener_mutex);
+    _sstable_listener = std::move(listener);
+}
+
+void KVStore::notifySSTableListener() {
+    std::lock_guard<std::mutex> lock(_listener_mutex);
+    if (_sstable_listener) {
+        _sstable_listener();
+    }
 }
 
 void KVStore::refreshSSTableMetadata() {
     std::cout << "DEBUG: KVStore::refreshSSTableMetadata() - Refreshing SSTable metadata" << std::endl;
     _reader.refreshMetadata();
+    // Imported tables can change what a key resolves to
+    if (_row_cache) {
+        _row_cache->clear();
+    }
+    notifySSTableListener();
+}
+
+std::shared_ptr<const Version> KVStore::currentSSTableVersion() const {
+    return _reader.currentVersion();
+}
+
+std::shared_ptr<VersionSet> KVStore::versionSet() const {
+    return _versions;
 }
 }
\ No newline at end of file
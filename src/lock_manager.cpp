@@ -0,0 +1,153 @@
+#include "kv/lock_manager.hpp"
+#include <algorithm>
+#include <map>
+
+namespace kv {
+
+const char* lockTypeName(LockType type) {
+    switch (type) {
+        case LockType::SSTableRead:  return "sstable_read";
+        case LockType::SSTableWrite: return "sstable_write";
+        case LockType::MemTable:     return "memtable";
+    }
+    return "unknown";
+}
+
+size_t LatencyHistogram::bucketFor(uint64_t nanos) {
+    size_t bucket = 0;
+    while (nanos > 1 && bucket + 1 < kBuckets) {
+        nanos >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void LatencyHistogram::add(uint64_t nanos) {
+    buckets[bucketFor(nanos)]++;
+    count++;
+    sum += nanos;
+    max = std::max(max, nanos);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kBuckets; ++i) buckets[i] += other.buckets[i];
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+}
+
+double LatencyHistogram::average() const {
+    return count == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(count);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (count == 0) return 0;
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * static_cast<double>(count) + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return std::min(max, (uint64_t{2} << i) - 1);
+    }
+    return max;
+}
+
+void LockSiteCounters::Histogram::add(Clock::duration duration) {
+    uint64_t nanos = static_cast<uint64_t>(std::max<int64_t>(0,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+    buckets[LatencyHistogram::bucketFor(nanos)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(nanos, std::memory_order_relaxed);
+    uint64_t seen = max.load(std::memory_order_relaxed);
+    while (nanos > seen && !max.compare_exchange_weak(seen, nanos, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram LockSiteCounters::Histogram::snapshot() const {
+    LatencyHistogram histogram;
+    for (size_t i = 0; i < LatencyHistogram::kBuckets; ++i) histogram.buckets[i] = buckets[i].load();
+    histogram.count = count.load();
+    histogram.sum = sum.load();
+    histogram.max = max.load();
+    return histogram;
+}
+
+void LockSiteCounters::Histogram::reset() {
+    for (auto& bucket : buckets) bucket.store(0);
+    count.store(0);
+    sum.store(0);
+    max.store(0);
+}
+
+void LockSiteCounters::recordAcquire(bool contended, Clock::duration wait) {
+    _acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (contended) _contended.fetch_add(1, std::memory_order_relaxed);
+    _wait.add(wait);
+}
+
+void LockSiteCounters::recordRelease(Clock::duration hold) {
+    _hold.add(hold);
+}
+
+LockSiteStats LockSiteCounters::snapshot() const {
+    LockSiteStats stats;
+    stats.type = _type;
+    stats.site = _site;
+    stats.acquisitions = _acquisitions.load();
+    stats.contended = _contended.load();
+    stats.wait = _wait.snapshot();
+    stats.hold = _hold.snapshot();
+    return stats;
+}
+
+void LockSiteCounters::reset() {
+    _acquisitions.store(0);
+    _contended.store(0);
+    _wait.reset();
+    _hold.reset();
+}
+
+LockSite::LockSite(const char* name) : _name(name) {
+    static std::atomic<size_t> next_index{0};
+    _index = next_index.fetch_add(1);
+}
+
+LockSiteCounters* LockManager::registerSite(LockType type, const LockSite& site) {
+    auto& sites = _sites[static_cast<size_t>(type)];
+    std::unique_lock<std::shared_mutex> lock(_sites_mutex);
+    auto& counters = sites[site.name()];
+    if (!counters) counters = std::make_unique<LockSiteCounters>(type, site.name());
+    if (site.index() < kMaxSites) {
+        _slots[static_cast<size_t>(type)][site.index()].store(counters.get(), std::memory_order_release);
+    }
+    return counters.get();
+}
+
+std::vector<LockSiteStats> LockManager::stats() const {
+    std::map<std::pair<LockType, std::string>, LockSiteStats> merged;
+    {
+        std::shared_lock<std::shared_mutex> lock(_sites_mutex);
+        for (const auto& sites : _sites) {
+            for (const auto& [name, counters] : sites) {
+                LockSiteStats site = counters->snapshot();
+                auto [it, inserted] = merged.try_emplace({site.type, site.site}, site);
+                if (inserted) continue;
+                it->second.acquisitions += site.acquisitions;
+                it->second.contended += site.contended;
+                it->second.wait.merge(site.wait);
+                it->second.hold.merge(site.hold);
+            }
+        }
+    }
+    std::vector<LockSiteStats> stats;
+    for (auto& [key, site] : merged) stats.push_back(std::move(site));
+    return stats;
+}
+
+void LockManager::resetStats() {
+    std::shared_lock<std::shared_mutex> lock(_sites_mutex);
+    for (const auto& sites : _sites) {
+        for (const auto& [name, counters] : sites) counters->reset();
+    }
+}
+
+} // namespace kv
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <filesystem>
 #include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
 #include "kv/log_writer.hpp"
 #include "kv/memtable.hpp"
 #include "kv/file_handle.hpp"
@@ -9,6 +12,17 @@
 #include "kv/flusher.hpp"
 #include "kv/lock_manager.hpp"
 #include "kv/compactor.hpp"
+#include "kv/key_index.hpp"
+#include "kv/io_backend.hpp"
+#include "kv/interval_index.hpp"
+#include "kv/compaction_filter.hpp"
+#include "kv/partitioned_store.hpp"
+#include <random>
+#include <set>
+#include <future>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Test directory management
 const std::string TEST_DIR = "test_temp_dir";
@@ -139,217 +153,2268 @@ void testFlusher() {
     std::string test_sstable_dir = TEST_DIR + "/test_sstable_flusher";
     kv::SSTableWriter writer(test_sstable_dir);
     auto lock_mgr = std::make_shared<kv::LockManager>();
-    kv::Flusher flusher(mem, active_mtx, immu_mtx, writer, 100, lock_mgr);
+    auto versions = std::make_shared<kv::VersionSet>(test_sstable_dir);
+    kv::Flusher flusher(mem, active_mtx, immu_mtx, writer, 100, lock_mgr, versions);
     flusher.start();
     
     // 3) Simulate writes
     for (int i = 0; i < 600; i++) {
+        bool full;
         {
             std::lock_guard lk(active_mtx);
             mem->put("key" + std::to_string(i), "value" + std::to_string(i));
+            full = mem->size() >= 100;
         }
+        if (full) {
+            flusher.scheduleFlush();
+        }
+    }
+    
+    // 4) Stop the flusher
+    flusher.stop();
+    std::cout << "Flusher test completed." << std::endl;
+    std::cout << "SSTable files written to: " << test_sstable_dir << std::endl;
+}
+
+void testSSTableReader() {
+    std::cout << "\n--- Testing SSTable Reader (Both Read Cases) ---" << std::endl;
+    
+    std::string test_db_path = TEST_DIR + "/test_sstable_reader";
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    
+    // Clean up any existing test data
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    
+    // Phase 1: Create some SSTable files with known data (on-disk data)
+    std::cout << "\n1. Creating SSTable files with sample data..." << std::endl;
+    std::filesystem::create_directories(test_db_path);
+    
+    kv::SSTableWriter writer(test_db_path);
+    
+    // Create first SSTable with some data
+    kv::MemTable temp_table1;
+    temp_table1.put("disk_key1", "disk_value1");
+    temp_table1.put("disk_key2", "disk_value2");
+    temp_table1.put("zebra", "last_alphabetical");
+    
+    // Convert MemTable to std::map for SSTableWriter
+    std::map<std::string, std::string> sorted_data1;
+    for (const auto& entry : temp_table1.entries()) {
+        sorted_data1[entry.key] = entry.value;
+    }
+    writer.writeSSTable(sorted_data1, 1);
+    
+    // Create second SSTable with different data
+    kv::MemTable temp_table2;
+    temp_table2.put("disk_key3", "disk_value3");
+    temp_table2.put("apple", "first_alphabetical");
+    temp_table2.put("disk_key1", "newer_disk_value1"); // This should override the first one
+    
+    // Convert MemTable to std::map for SSTableWriter
+    std::map<std::string, std::string> sorted_data2;
+    for (const auto& entry : temp_table2.entries()) {
+        sorted_data2[entry.key] = entry.value;
+    }
+    writer.writeSSTable(sorted_data2, 2);
+    
+    std::cout << "   Created 2 SSTable files with sample data" << std::endl;
+    
+    // Phase 2: Create KVStore and add some in-memory data
+    std::cout << "\n2. Creating KVStore and adding in-memory data..." << std::endl;
+    
+    kv::KVStore store(test_db_path, lock_mgr);
+    
+    // Add some data that will stay in memory
+    store.put("memory_key1", "memory_value1");
+    store.put("memory_key2", "memory_value2");
+    store.put("disk_key1", "latest_memory_value1"); // This should override disk version
+    
+    std::cout << "   Added 3 keys to in-memory hash table" << std::endl;
+    
+    // Phase 3: Test different read scenarios
+    std::cout << "\n3. Testing read scenarios:" << std::endl;
+    
+    // Test Case 1: Read from in-memory hash table (should hit memory first)
+    std::cout << "\n   Test Case 1 - Reading keys that exist in memory:" << std::endl;
+    auto result1 = store.get("memory_key1");
+    auto result2 = store.get("memory_key2");
+    auto result3 = store.get("disk_key1"); // This exists in both, should get memory version
+    
+    std::cout << "   memory_key1: " << (result1 ? *result1 : "<not found>") << std::endl;
+    std::cout << "   memory_key2: " << (result2 ? *result2 : "<not found>") << std::endl;
+    std::cout << "   disk_key1 (should be memory version): " << (result3 ? *result3 : "<not found>") << std::endl;
+    
+    // Test Case 2: Read from on-disk SSTables (should fall through to disk)
+    std::cout << "\n   Test Case 2 - Reading keys that exist only on disk:" << std::endl;
+    auto result4 = store.get("disk_key2");
+    auto result5 = store.get("disk_key3");
+    auto result6 = store.get("apple");
+    auto result7 = store.get("zebra");
+    
+    std::cout << "   disk_key2 (from disk): " << (result4 ? *result4 : "<not found>") << std::endl;
+    std::cout << "   disk_key3 (from disk): " << (result5 ? *result5 : "<not found>") << std::endl;
+    std::cout << "   apple (from disk): " << (result6 ? *result6 : "<not found>") << std::endl;
+    std::cout << "   zebra (from disk): " << (result7 ? *result7 : "<not found>") << std::endl;
+    
+    // Test Case 3: Read non-existent keys (should not be found anywhere)
+    std::cout << "\n   Test Case 3 - Reading keys that don't exist:" << std::endl;
+    auto result8 = store.get("nonexistent_key");
+    auto result9 = store.get("missing_key");
+    
+    std::cout << "   nonexistent_key: " << (result8 ? *result8 : "<not found>") << std::endl;
+    std::cout << "   missing_key: " << (result9 ? *result9 : "<not found>") << std::endl;
+    
+    // Phase 4: Verify expected results with assertions
+    std::cout << "\n4. Verifying test results with assertions:" << std::endl;
+    
+    // Assert memory reads
+    if (!result1 || *result1 != "memory_value1") {
+        throw std::runtime_error("ASSERT FAILED: memory_key1 should return 'memory_value1'");
+    }
+    
+    if (!result2 || *result2 != "memory_value2") {
+        throw std::runtime_error("ASSERT FAILED: memory_key2 should return 'memory_value2'");
+    }
+    
+    // Assert memory override of disk data
+    if (!result3 || *result3 != "latest_memory_value1") {
+        throw std::runtime_error("ASSERT FAILED: disk_key1 should return memory version 'latest_memory_value1'");
+    }
+    
+    // Assert disk reads
+    if (!result4 || *result4 != "disk_value2") {
+        throw std::runtime_error("ASSERT FAILED: disk_key2 should return 'disk_value2' from disk");
+    }
+    
+    if (!result5 || *result5 != "disk_value3") {
+        throw std::runtime_error("ASSERT FAILED: disk_key3 should return 'disk_value3' from disk");
+    }
+    
+    if (!result6 || *result6 != "first_alphabetical") {
+        throw std::runtime_error("ASSERT FAILED: apple should return 'first_alphabetical' from disk");
+    }
+    
+    if (!result7 || *result7 != "last_alphabetical") {
+        throw std::runtime_error("ASSERT FAILED: zebra should return 'last_alphabetical' from disk");
+    }
+    
+    // Assert non-existent keys
+    if (result8 || result9) {
+        throw std::runtime_error("ASSERT FAILED: Non-existent keys should return nullopt");
+    }
+    
+    // A key length that runs past the end of its block reads as not found
+    {
+        std::string corrupt_path = TEST_DIR + "/test_sstable_corrupt";
+        std::filesystem::remove_all(corrupt_path);
+        std::filesystem::create_directories(corrupt_path);
+        kv::SSTableWriter(corrupt_path).writeSSTable(std::map<std::string, std::string>{{"a", "1"}, {"b", "2"}}, 1);
+        kv::KVStore corrupt_store(corrupt_path, lock_mgr);
+        if (corrupt_store.get("b") != std::optional<std::string>("2")) {
+            throw std::runtime_error("ASSERT FAILED: b should be readable before the corruption");
+        }
+        {
+            // The block index is built; record "a" takes 4 + 1 + 8 + 4 + 1 bytes, "b" follows
+            std::fstream file(corrupt_path + "/" + kv::makeSSTableFileName(1),
+                              std::ios::binary | std::ios::in | std::ios::out);
+            uint32_t key_len = 200;
+            file.seekp(18);
+            file.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+        }
+        if (corrupt_store.get("a") != std::optional<std::string>("1") || corrupt_store.get("b")) {
+            throw std::runtime_error("ASSERT FAILED: a corrupt record should only hide itself");
+        }
+    }
+
+    std::cout << "\nSSTable Reader test completed successfully!" << std::endl;
+}
+
+void testDeleteTombstone() {
+    std::cout << "\n--- Testing Delete Tombstone Feature ---" << std::endl;
+    
+    std::string test_db_path = TEST_DIR + "/test_delete_db";
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    
+    // Setup: Create SSTable with initial data
+    std::filesystem::create_directories(test_db_path);
+    kv::SSTableWriter writer(test_db_path);
+    std::map<std::string, std::string> disk_data;
+    disk_data["disk_key"] = "disk_value";
+    writer.writeSSTable(disk_data, 1);
+    
+    // Test delete operations
+    kv::KVStore store(test_db_path, lock_mgr);
+    store.put("mem_key", "mem_value");
+    
+    // Assert initial state
+    auto mem_before = store.get("mem_key");
+    auto disk_before = store.get("disk_key");
+    if (!mem_before || *mem_before != "mem_value") {
+        throw std::runtime_error("ASSERT FAILED: mem_key should exist");
+    }
+    if (!disk_before || *disk_before != "disk_value") {
+        throw std::runtime_error("ASSERT FAILED: disk_key should exist");
+    }
+    
+    // Test deletions
+    store.del("mem_key");
+    store.del("disk_key");
+    store.del("nonexistent");  // Should not crash
+    
+    // Assert deletions worked
+    if (store.get("mem_key")) {
+        throw std::runtime_error("ASSERT FAILED: mem_key should be deleted");
+    }
+    if (store.get("disk_key")) {
+        throw std::runtime_error("ASSERT FAILED: disk_key should be deleted");
+    }
+    if (store.get("nonexistent")) {
+        throw std::runtime_error("ASSERT FAILED: nonexistent should remain not found");
+    }
+    
+    // Test delete then restore
+    store.put("restore_test", "original");
+    store.del("restore_test");
+    if (store.get("restore_test")) {
+        throw std::runtime_error("ASSERT FAILED: restore_test should be deleted");
+    }
+    
+    store.put("restore_test", "restored");
+    auto restored = store.get("restore_test");
+    if (!restored || *restored != "restored") {
+        throw std::runtime_error("ASSERT FAILED: restore_test should be restored");
+    }
+    
+    std::cout << "Delete tombstone test passed!" << std::endl;
+}
+
+void testRangeIterator() {
+    std::cout << "\n--- Testing Range Iterator ---" << std::endl;
+
+    std::string test_db_path = TEST_DIR + "/test_range_iterator";
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+
+    auto key_of = [](int i) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%03d", i);
+        return std::string(key);
+    };
+
+    // Older table holds every key, newer table overrides the even ones and deletes key050
+    kv::SSTableWriter writer(test_db_path);
+    std::map<std::string, std::string> older, newer;
+    for (int i = 0; i < 100; ++i) {
+        older[key_of(i)] = "v1_" + std::to_string(i);
+        if (i % 2 == 0) newer[key_of(i)] = "v2_" + std::to_string(i);
+    }
+    newer["key050"] = kv::TOMB_STONE;
+    writer.writeSSTable(older, 1);
+    writer.writeSSTable(newer, 2);
+
+    // MemTable shadows both tables
+    kv::KVStore store(test_db_path, lock_mgr);
+    store.put("key010", "mem");
+    store.del("key020");
+    store.put("key100", "mem_new");
+    store.put("apple", "mem_apple");
+
+    std::vector<std::pair<std::string, std::string>> expected = {{"apple", "mem_apple"}};
+    for (int i = 0; i < 100; ++i) {
+        if (i == 20 || i == 50) continue;
+        std::string value = i == 10 ? "mem" : (i % 2 == 0 ? "v2_" : "v1_") + std::to_string(i);
+        expected.emplace_back(key_of(i), value);
+    }
+    expected.emplace_back("key100", "mem_new");
+
+    // Full forward and backward scans
+    auto it = store.newIterator();
+    std::vector<std::pair<std::string, std::string>> forward;
+    for (it->seekToFirst(); it->valid(); it->next()) {
+        forward.emplace_back(it->key(), it->value());
+    }
+    if (forward != expected) {
+        throw std::runtime_error("ASSERT FAILED: forward scan should return newest live versions in order");
+    }
+    std::vector<std::pair<std::string, std::string>> backward;
+    for (it->seekToLast(); it->valid(); it->prev()) {
+        backward.emplace_back(it->key(), it->value());
+    }
+    std::reverse(backward.begin(), backward.end());
+    if (backward != expected) {
+        throw std::runtime_error("ASSERT FAILED: backward scan should mirror the forward scan");
+    }
+
+    // Positioning
+    it->seek("key05");
+    if (!it->valid() || it->key() != "key051") {
+        throw std::runtime_error("ASSERT FAILED: seek should skip the deleted key050");
+    }
+    it->upperBound("key010");
+    if (!it->valid() || it->key() != "key011") {
+        throw std::runtime_error("ASSERT FAILED: upperBound should return the first key greater than target");
+    }
+    it->seek("key030");
+    it->prev();
+    if (!it->valid() || it->key() != "key029") {
+        throw std::runtime_error("ASSERT FAILED: prev after seek should return the preceding key");
+    }
+    it->next();
+    it->next();
+    if (!it->valid() || it->key() != "key031") {
+        throw std::runtime_error("ASSERT FAILED: next after prev should resume forward");
+    }
+
+    // Prefix listing
+    size_t prefix_count = 0;
+    for (it->seek("key09"); it->valid() && it->key().rfind("key09", 0) == 0; it->next()) {
+        prefix_count++;
+    }
+    if (prefix_count != 10) {
+        throw std::runtime_error("ASSERT FAILED: prefix scan should list key090..key099");
+    }
+
+    std::cout << "Range iterator test completed successfully!" << std::endl;
+}
+
+void testMultiGet() {
+    std::cout << "\n--- Testing MultiGet ---" << std::endl;
+
+    std::string test_db_path = TEST_DIR + "/test_multiget";
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+
+    // Two overlapping tables, the newer one overrides and deletes some keys
+    kv::SSTableWriter writer(test_db_path);
+    std::map<std::string, std::string> older, newer;
+    for (int i = 0; i < 200; ++i) {
+        older["key" + std::to_string(i)] = "old" + std::to_string(i);
+    }
+    for (int i = 0; i < 200; i += 3) {
+        newer["key" + std::to_string(i)] = "new" + std::to_string(i);
+    }
+    newer["key7"] = kv::TOMB_STONE;
+    writer.writeSSTable(older, 1);
+    writer.writeSSTable(newer, 2);
+
+    kv::KVStore store(test_db_path, lock_mgr);
+    store.put("key1", "mem1");
+    store.del("key2");
+
+    // Unsorted keys with a duplicate and a miss; must agree with get()
+    std::vector<std::string> keys = {"key150", "key1", "key2", "key3", "missing", "key7", "key99", "key3", "key0"};
+    auto results = store.multiGet(keys);
+    if (results.size() != keys.size()) {
+        throw std::runtime_error("ASSERT FAILED: multiGet should return one result per key");
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (results[i] != store.get(keys[i])) {
+            throw std::runtime_error("ASSERT FAILED: multiGet disagrees with get for " + keys[i]);
+        }
+    }
+    if (!results[0] || *results[0] != "new150" || !results[1] || *results[1] != "mem1" ||
+        results[2] || results[4] || results[5] || !results[6] || *results[6] != "new99") {
+        throw std::runtime_error("ASSERT FAILED: multiGet returned unexpected values");
+    }
+
+    std::cout << "MultiGet test completed successfully!" << std::endl;
+}
+
+void testVersionPinning() {
+    std::cout << "\n--- Testing SSTable Version Pinning ---" << std::endl;
+
+    std::string test_db_path = TEST_DIR + "/test_version_pinning";
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+
+    kv::SSTableWriter writer(test_db_path);
+    writer.writeSSTable({{"a", "old_a"}, {"b", "old_b"}}, 1);
+    writer.writeSSTable({{"a", "merged_a"}, {"b", "old_b"}}, 2);
+
+    kv::KVStore store(test_db_path, lock_mgr);
+    auto pinned_version = store.currentSSTableVersion();
+    auto it = store.newIterator();
+
+    // Replace table 1 the way compaction does, while a version and an iterator still reference it
+    kv::VersionEdit edit;
+    edit.removeTable(1);
+    store.versionSet()->logAndApply(edit);
+    std::string old_file = test_db_path + "/00000001.sst";
+    if (!std::filesystem::exists(old_file)) {
+        throw std::runtime_error("ASSERT FAILED: obsolete SSTable must stay on disk while referenced");
+    }
+    if (store.currentSSTableVersion()->tables.size() != 1 || pinned_version->tables.size() != 2) {
+        throw std::runtime_error("ASSERT FAILED: new version should drop the table, the pinned one keep it");
+    }
+    auto a = store.get("a");
+    if (!a || *a != "merged_a") {
+        throw std::runtime_error("ASSERT FAILED: reads should see the new version");
+    }
+
+    // Old iterator keeps scanning its own version
+    it->seekToFirst();
+    if (!it->valid() || it->value() != "merged_a") {
+        throw std::runtime_error("ASSERT FAILED: pinned iterator should still read its tables");
+    }
+
+    it.reset();
+    pinned_version.reset();
+    if (std::filesystem::exists(old_file)) {
+        throw std::runtime_error("ASSERT FAILED: obsolete SSTable should be deleted after the last reference");
+    }
+
+    std::cout << "SSTable version pinning test completed successfully!" << std::endl;
+}
+
+void testManifestRecovery() {
+    std::cout << "\n--- Testing MANIFEST Recovery ---" << std::endl;
+
+    std::string test_db_path = TEST_DIR + "/test_manifest_recovery";
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+
+    kv::SSTableWriter writer(test_db_path);
+    writer.writeSSTable({{"a", "a1"}, {"b", "b1"}}, 1);
+    writer.writeSSTable({{"c", "c2"}}, 2);
+    {
+        // No MANIFEST yet: bootstrapped from the directory
+        kv::KVStore store(test_db_path, lock_mgr);
+        auto versions = store.versionSet();
+        if (versions->current()->tables.size() != 2) {
+            throw std::runtime_error("ASSERT FAILED: bootstrap should adopt both SSTables");
+        }
+
+        // Replace table 1 the way compaction does
+        uint64_t number = versions->newFileNumber();
+        if (number != 3) {
+            throw std::runtime_error("ASSERT FAILED: file numbers should continue after existing SSTables");
+        }
+        writer.writeSSTable({{"a", "a3"}, {"b", "b1"}}, number);
+        kv::VersionEdit edit;
+        edit.addTable(number, 0);
+        edit.removeTable(1);
+        versions->logAndApply(edit);
+    }
+
+    // Crash leftovers: a removed table still on disk and a torn MANIFEST record
+    writer.writeSSTable({{"a", "stale"}}, 1);
+    {
+        std::ofstream manifest(test_db_path + "/" + kv::VersionSet::kManifestName, std::ios::binary | std::ios::app);
+        manifest.write("\x40\x00\x00\x00garbage", 11);
+    }
+    // Not in the MANIFEST, so recovery must not pick it up
+    writer.writeSSTable({{"z", "untracked"}}, 9);
+
+    {
+        kv::KVStore store(test_db_path, lock_mgr);
+        auto version = store.currentSSTableVersion();
+        if (version->tables.size() != 2 ||
+            version->tables[0]->meta().file_number != 3 || version->tables[1]->meta().file_number != 2) {
+            throw std::runtime_error("ASSERT FAILED: MANIFEST replay should restore tables 3 and 2");
+        }
+        if (version->tables[0]->meta().min_key != "a" || version->tables[0]->meta().max_key != "b") {
+            throw std::runtime_error("ASSERT FAILED: key ranges should come back from the MANIFEST");
+        }
+        if (std::filesystem::exists(test_db_path + "/00000001.sst")) {
+            throw std::runtime_error("ASSERT FAILED: recovery should delete the leftover removed SSTable");
+        }
+        auto a = store.get("a");
+        auto z = store.get("z");
+        if (!a || *a != "a3" || z) {
+            throw std::runtime_error("ASSERT FAILED: reads after recovery returned unexpected values");
+        }
+
+        // Explicit import adopts the untracked file, numbering moves past it
+        store.refreshSSTableMetadata();
+        z = store.get("z");
+        if (!z || *z != "untracked" || store.versionSet()->newFileNumber() != 10) {
+            throw std::runtime_error("ASSERT FAILED: import should adopt table 9 and bump the file number");
+        }
+
+        // A reserved number is a table still being written, not an untracked one
+        uint64_t pending = store.versionSet()->newFileNumber();
+        writer.writeSSTable({{"y", "in flight"}}, pending);
+        store.refreshSSTableMetadata();
+        if (store.get("y") || store.currentSSTableVersion()->tables.size() != 3) {
+            throw std::runtime_error("ASSERT FAILED: import should leave reserved file numbers alone");
+        }
+    }
+
+    std::cout << "MANIFEST recovery test completed successfully!" << std::endl;
+}
+
+void testSnapshots() {
+    std::cout << "\n--- Testing Sequence Numbers and Snapshots ---" << std::endl;
+
+    std::string test_db_path = TEST_DIR + "/test_snapshots";
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+
+    // 1) MemTable versions, through the store
+    {
+        kv::KVStore store(test_db_path, lock_mgr);
+        store.put("a", "a1");
+        store.put("b", "b1");
+        auto snap = store.getSnapshot();
+        store.put("a", "a2");
+        store.del("b");
+        store.put("c", "c1");
+
+        auto a_now = store.get("a");
+        auto a_then = store.get("a", snap);
+        auto b_then = store.get("b", snap);
+        if (!a_now || *a_now != "a2" || !a_then || *a_then != "a1" || store.get("b") ||
+            !b_then || *b_then != "b1" || store.get("c", snap)) {
+            throw std::runtime_error("ASSERT FAILED: snapshot reads should ignore later writes");
+        }
+        auto batch = store.multiGet({"a", "b", "c"}, snap);
+        if (!batch[0] || *batch[0] != "a1" || !batch[1] || *batch[1] != "b1" || batch[2]) {
+            throw std::runtime_error("ASSERT FAILED: multiGet through a snapshot returned wrong values");
+        }
+
+        std::string scanned;
+        auto it = store.newIterator(snap);
+        for (it->seekToFirst(); it->valid(); it->next()) scanned += it->key() + "=" + it->value() + ";";
+        if (scanned != "a=a1;b=b1;") {
+            throw std::runtime_error("ASSERT FAILED: snapshot iterator saw '" + scanned + "'");
+        }
+        if (store.liveSnapshots().size() != 1) {
+            throw std::runtime_error("ASSERT FAILED: one live snapshot expected");
+        }
+        snap.reset();
+        if (!store.liveSnapshots().empty()) {
+            throw std::runtime_error("ASSERT FAILED: released snapshot should leave the list");
+        }
+    }
+
+    // 2) Several versions of a key inside and across SSTables
+    std::string sst_dir = test_db_path + "/sst";
+    kv::SSTableWriter writer(sst_dir);
+    std::vector<kv::Entry> older, newer;
+    for (int i = 0; i < 60; ++i) {
+        older.push_back(kv::Entry{"key" + std::to_string(100 + i), 1, "old"});
+    }
+    // Enough versions of one key to straddle an index interval
+    for (int seq = 30; seq >= 10; --seq) {
+        older.push_back(kv::Entry{"key150", static_cast<kv::SequenceNumber>(seq), "v" + std::to_string(seq)});
+    }
+    std::sort(older.begin(), older.end(), [](const kv::Entry& x, const kv::Entry& y) {
+        return x.key != y.key ? x.key < y.key : x.seq > y.seq;
+    });
+    writer.writeSSTable(older, 1);
+    newer.push_back(kv::Entry{"key105", 40, kv::TOMB_STONE});
+    newer.push_back(kv::Entry{"key150", 35, "v35"});
+    writer.writeSSTable(newer, 2);
+
+    auto versions = std::make_shared<kv::VersionSet>(sst_dir);
+    if (versions->lastSequence() != 40) {
+        throw std::runtime_error("ASSERT FAILED: last sequence should be recovered from the tables");
+    }
+    kv::SSTableReader reader(sst_dir, lock_mgr, versions);
+    auto at = [&](const std::string& key, kv::SequenceNumber seq) {
+        auto v = reader.get(key, seq);
+        return v ? *v : std::string("<none>");
+    };
+    if (at("key150", 100) != "v35" || at("key150", 20) != "v20" || at("key150", 5) != "old" ||
+        at("key105", 100) != kv::TOMB_STONE || at("key105", 39) != "old") {
+        throw std::runtime_error("ASSERT FAILED: SSTable reads should honor the snapshot sequence");
+    }
+
+    kv::Iterator it(reader.newCursors(25));
+    it.seek("key149");
+    if (!it.valid() || it.key() != "key149") throw std::runtime_error("ASSERT FAILED: seek to key149");
+    it.next();
+    if (!it.valid() || it.key() != "key150" || it.value() != "v25") {
+        throw std::runtime_error("ASSERT FAILED: iterator should see v25 of key150 at seq 25");
+    }
+    it.next();
+    if (!it.valid() || it.key() != "key151") throw std::runtime_error("ASSERT FAILED: versions should be skipped");
+    it.prev();
+    if (!it.valid() || it.key() != "key150" || it.value() != "v25") {
+        throw std::runtime_error("ASSERT FAILED: prev should land on the visible version of key150");
+    }
+    it.prev();
+    if (!it.valid() || it.key() != "key149") throw std::runtime_error("ASSERT FAILED: prev past key150");
+
+    // 3) Compaction keeps the newest version per snapshot stripe
+    std::vector<kv::Entry> history = {
+        {"k", 9, "v9"}, {"k", 7, "v7"}, {"k", 5, kv::TOMB_STONE}, {"k", 3, "v3"}, {"k", 1, "v1"}};
+    auto kept = kv::retainVisible(history, {4, 8}, true);
+    if (kept.size() != 3 || kept[0].seq != 9 || kept[1].seq != 7 || kept[2].seq != 3) {
+        throw std::runtime_error("ASSERT FAILED: retainVisible should keep v9, v7 and v3");
+    }
+    kept = kv::retainVisible(history, {6}, true);
+    if (kept.size() != 1 || kept[0].seq != 9) {
+        throw std::runtime_error("ASSERT FAILED: tombstone at the bottom should be dropped");
+    }
+
+    std::cout << "Snapshots test completed successfully!" << std::endl;
+}
+
+void testConcurrentOverwriteReads() {
+    std::cout << "\n--- Testing Reads Racing Overwrites ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_concurrent_overwrite";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+
+    // Read pins hold back oldest() but are not snapshots, even past the slot count
+    {
+        kv::SnapshotList list;
+        std::atomic<kv::SequenceNumber> last_sequence{5};
+        std::vector<kv::ReadPin> pins;
+        pins.push_back(list.pinLatest(last_sequence));
+        last_sequence.store(9);
+        for (size_t i = 0; i < kv::SnapshotList::kReadSlots; i++) pins.push_back(list.pinLatest(last_sequence));
+        if (pins.front().sequence() != 5 || pins.back().sequence() != 9 || list.oldest() != 5) {
+            throw std::runtime_error("ASSERT FAILED: read pins should hold back oldest()");
+        }
+        if (list.live().size() != 1) {
+            throw std::runtime_error("ASSERT FAILED: only the read pin past the slots should be registered");
+        }
+        pins.clear();
+        if (list.oldest() != kv::kMaxSequenceNumber || !list.live().empty()) {
+            throw std::runtime_error("ASSERT FAILED: dropped read pins should release their sequence");
+        }
+    }
+
+    // An SSTable holds a stale version: a read that misses the MemTable would return it
+    kv::SSTableWriter writer(test_db_path);
+    writer.writeSSTable(std::vector<kv::Entry>{{"hot", 0, "stale"}}, 1);
+
+    kv::KVStore store(test_db_path, lock_mgr);
+    store.put("hot", "0");
+    std::atomic<bool> done{false};
+    std::atomic<int> errors{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++) {
+        readers.emplace_back([&, t] {
+            int last = 0;
+            while (!done.load()) {
+                auto value = t == 0 ? store.multiGet({"hot"}).front() : store.get("hot");
+                if (!value || *value == "stale" || std::stoi(*value) < last) {
+                    errors.fetch_add(1);
+                    continue;
+                }
+                last = std::stoi(*value);
+            }
+        });
+    }
+    for (int i = 1; i <= 3000; i++) store.put("hot", std::to_string(i));
+    done.store(true);
+    for (auto& reader : readers) reader.join();
+    if (errors.load() != 0) {
+        throw std::runtime_error("ASSERT FAILED: " + std::to_string(errors.load()) + " reads lost the version they read at");
+    }
+    if (store.get("hot") != std::optional<std::string>("3000") || !store.liveSnapshots().empty()) {
+        throw std::runtime_error("ASSERT FAILED: read pins should be released after the reads");
+    }
+    std::cout << "Concurrent overwrite read test completed successfully!" << std::endl;
+}
+
+void testRowCache() {
+    std::cout << "\n--- Testing Row Cache ---" << std::endl;
+
+    std::string test_db_path = TEST_DIR + "/test_row_cache";
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+
+    kv::SSTableWriter writer(test_db_path);
+    writer.writeSSTable({{"disk", "d1"}}, 1);
+
+    kv::Options options;
+    options.row_cache_bytes = 1 << 20;
+    options.row_cache_shards = 4;
+    kv::KVStore store(test_db_path, lock_mgr, options);
+    const kv::RowCache* cache = store.rowCache();
+    if (!cache) {
+        throw std::runtime_error("ASSERT FAILED: row cache should be enabled");
+    }
+
+    // Values and misses are both cached
+    store.get("disk");
+    store.get("missing");
+    uint64_t hits_before = cache->hits();
+    auto disk = store.get("disk");
+    auto missing = store.get("missing");
+    if (!disk || *disk != "d1" || missing || cache->hits() != hits_before + 2) {
+        throw std::runtime_error("ASSERT FAILED: second reads should be row cache hits");
+    }
+
+    // put and del invalidate
+    store.put("disk", "d2");
+    disk = store.get("disk");
+    if (!disk || *disk != "d2") {
+        throw std::runtime_error("ASSERT FAILED: put should invalidate the cached row");
+    }
+    store.put("missing", "now_here");
+    missing = store.get("missing");
+    if (!missing || *missing != "now_here") {
+        throw std::runtime_error("ASSERT FAILED: put should replace a cached miss");
+    }
+    store.del("disk");
+    if (store.get("disk") || store.get("disk")) {
+        throw std::runtime_error("ASSERT FAILED: del should invalidate the cached row");
+    }
+
+    // A read that started before a write must not be cached after it
+    kv::RowCache small(4096, 1);
+    small.erase("k", 10);
+    small.insert("k", std::string("stale"), 9, small.generation("k"));
+    if (small.lookup("k")) {
+        throw std::runtime_error("ASSERT FAILED: stale row should be refused");
+    }
+    // Same for a read that started before a compaction changed the key
+    uint64_t generation = small.generation("k");
+    small.invalidate({"k"});
+    small.insert("k", std::string("unfiltered"), 20, generation);
+    if (small.lookup("k")) {
+        throw std::runtime_error("ASSERT FAILED: row read before an invalidation should be refused");
+    }
+    // And for one that started before tables were imported
+    generation = small.generation("k");
+    small.clear();
+    small.insert("k", std::string("before import"), 20, generation);
+    if (small.lookup("k")) {
+        throw std::runtime_error("ASSERT FAILED: row read before a clear should be refused");
+    }
+
+    // Byte budget is enforced by LRU eviction
+    for (int i = 0; i < 200; ++i) {
+        small.insert("key" + std::to_string(i), std::string(100, 'x'), 20, small.generation("key"));
+    }
+    if (small.usage() > 4096 || !small.lookup("key199") || small.lookup("key0")) {
+        throw std::runtime_error("ASSERT FAILED: row cache should evict least recently used rows");
+    }
+
+    std::cout << "Row cache test completed successfully!" << std::endl;
+}
+
+void testEventDrivenFlush() {
+    std::cout << "\n--- Testing Event-Driven Flush and Compaction ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_event_driven_flush";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+
+    // Poll for a condition instead of sleeping a fixed time
+    auto waitFor = [](const std::function<bool()>& done) {
+        for (int i = 0; i < 500 && !done(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return done();
+    };
+
+    {
+        kv::Options options;
+        options.memtable_flush_threshold = 50;
+        kv::KVStore store(test_db_path, lock_mgr, options);
+        kv::Compactor compactor(test_db_path, 3, 2, lock_mgr);
+        compactor.setKVStore(&store);
+        compactor.start();
+
+        // An idle store has nothing to flush
+        if (!store.currentSSTableVersion()->tables.empty()) {
+            throw std::runtime_error("ASSERT FAILED: fresh store should have no SSTables");
+        }
+
+        // Filling the memtable wakes the flusher without any polling on its side
+        for (int i = 0; i < 50; i++) {
+            store.put("key" + std::to_string(i), "v1_" + std::to_string(i));
+        }
+        if (!waitFor([&] { return !store.currentSSTableVersion()->tables.empty(); })) {
+            throw std::runtime_error("ASSERT FAILED: full memtable should be flushed to an SSTable");
+        }
+
+        // Three more flushes take the table count to the compaction trigger
+        for (int round = 2; round <= 4; round++) {
+            for (int i = 0; i < 50; i++) {
+                store.put("key" + std::to_string(i), "v" + std::to_string(round) + "_" + std::to_string(i));
+            }
+        }
+        store.put("pending", "in_memtable");
+
+        // Reads are correct while tables move from memtable to SSTables and get compacted
+        for (int i = 0; i < 50; i += 7) {
+            auto value = store.get("key" + std::to_string(i));
+            if (!value || *value != "v4_" + std::to_string(i)) {
+                throw std::runtime_error("ASSERT FAILED: key" + std::to_string(i) + " should be v4 during flushes");
+            }
+        }
+
+        // The flush listener woke the compactor, which merged tables down below the trigger
+        if (!waitFor([&] { return store.lastSequence() == 201 &&
+                                  store.currentSSTableVersion()->tables.size() < 3; })) {
+            throw std::runtime_error("ASSERT FAILED: flushes should trigger compaction below the threshold");
+        }
+        compactor.stop();
+
+        size_t count = 0;
+        auto it = store.newIterator();
+        for (it->seekToFirst(); it->valid(); it->next()) {
+            count++;
+        }
+        if (count != 51) {
+            throw std::runtime_error("ASSERT FAILED: iterator should see 51 keys, got " + std::to_string(count));
+        }
+    }
+
+    // Flushed writes are not replayed again from the WAL, unflushed ones are
+    {
+        kv::KVStore store(test_db_path, lock_mgr);
+        auto pending = store.get("pending");
+        if (!pending || *pending != "in_memtable") {
+            throw std::runtime_error("ASSERT FAILED: unflushed write should come back from the WAL");
+        }
+        auto value = store.get("key13");
+        if (!value || *value != "v4_13") {
+            throw std::runtime_error("ASSERT FAILED: key13 should be v4 after reopen");
+        }
+        if (store.lastSequence() != 201) {
+            throw std::runtime_error("ASSERT FAILED: last sequence should survive reopen");
+        }
+    }
+    std::cout << "Event-driven flush test completed successfully!" << std::endl;
+}
+
+void testParallelFlush() {
+    std::cout << "\n--- Testing Parallel Flush Workers ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_parallel_flush";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+
+    const int kWrites = 2000;
+    {
+        kv::Options options;
+        options.memtable_flush_threshold = 20;
+        options.flush_threads = 4;
+        kv::KVStore store(test_db_path, lock_mgr, options);
+
+        // Many small memtables are frozen and written by several workers at once
+        for (int i = 0; i < kWrites; i++) {
+            store.put("key" + std::to_string(i % 25), "v" + std::to_string(i));
+            if (i % 97 == 0) {
+                auto value = store.get("key" + std::to_string(i % 25));
+                if (!value || *value != "v" + std::to_string(i)) {
+                    throw std::runtime_error("ASSERT FAILED: read during parallel flush should see the latest write");
+                }
+            }
+        }
+
+        if (store.currentSSTableVersion()->tables.empty()) {
+            throw std::runtime_error("ASSERT FAILED: parallel flush should have written SSTables");
+        }
+    } // Stopping the workers flushes every frozen memtable
+
+    kv::KVStore store(test_db_path, lock_mgr);
+
+    // In-order installs: the MANIFEST never claims a sequence whose table is not live
+    kv::SequenceNumber max_seq = 0;
+    for (const auto& table : store.currentSSTableVersion()->tables) {
+        max_seq = std::max(max_seq, table->meta().max_seq);
+    }
+    if (store.versionSet()->lastSequence() != max_seq) {
+        throw std::runtime_error("ASSERT FAILED: last sequence should match the newest installed table");
+    }
+    for (int k = 0; k < 25; k++) {
+        int last = kWrites - 25 + k;
+        auto value = store.get("key" + std::to_string(last % 25));
+        if (!value || *value != "v" + std::to_string(last)) {
+            throw std::runtime_error("ASSERT FAILED: key" + std::to_string(k) + " should hold its last write after reopen");
+        }
+    }
+    if (store.lastSequence() != kWrites) {
+        throw std::runtime_error("ASSERT FAILED: reopened store should continue at sequence " + std::to_string(kWrites));
+    }
+    std::cout << "Parallel flush test completed successfully!" << std::endl;
+}
+
+void testFlushPipeline() {
+    std::cout << "\n--- Testing Parallel Sort-and-Encode Flush Pipeline ---" << std::endl;
+    std::string test_dir = TEST_DIR + "/test_flush_pipeline";
+    if (std::filesystem::exists(test_dir)) {
+        std::filesystem::remove_all(test_dir);
+    }
+
+    // Large enough for several sort chunks and encode blocks, with multi-version keys
+    kv::MemTable table;
+    std::mt19937 rng(42);
+    kv::SequenceNumber seq = 0;
+    for (int i = 0; i < 30000; i++) {
+        std::string key = "key" + std::to_string(rng() % 20000);
+        table.put(key, "value" + std::to_string(i), ++seq, 10000); // Snapshot at 10000 keeps old versions
+    }
+
+    std::vector<kv::Entry> expected = table.entries();
+    std::vector<kv::EntryRef> refs = table.sortedRefs(4);
+    if (refs.size() != expected.size()) {
+        throw std::runtime_error("ASSERT FAILED: sortedRefs should return every version");
+    }
+    for (size_t i = 0; i < refs.size(); i++) {
+        if (*refs[i].key != expected[i].key || refs[i].seq != expected[i].seq || *refs[i].value != expected[i].value) {
+            throw std::runtime_error("ASSERT FAILED: sortedRefs order differs from entries() at " + std::to_string(i));
+        }
+    }
+
+    // Pipelined encoding writes exactly the bytes of the plain writer
+    kv::SSTableWriter writer(test_dir);
+    if (!writer.writeSSTable(expected, 1) || !writer.writeSSTable(refs, 2, 4) || !writer.writeSSTable(refs, 3, 1)) {
+        throw std::runtime_error("ASSERT FAILED: SSTable writes should succeed");
+    }
+    auto readAll = [&](uint64_t number) {
+        std::ifstream in(test_dir + "/" + kv::makeSSTableFileName(number), std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    std::string plain = readAll(1);
+    if (plain.empty() || readAll(2) != plain || readAll(3) != plain) {
+        throw std::runtime_error("ASSERT FAILED: pipelined SSTable should match the plain one byte for byte");
+    }
+
+    // An empty table still produces a (empty) file
+    kv::MemTable empty;
+    if (!empty.sortedRefs(4).empty() || !writer.writeSSTable(empty.sortedRefs(4), 4, 4) || !readAll(4).empty()) {
+        throw std::runtime_error("ASSERT FAILED: empty table should flush to an empty file");
+    }
+    std::cout << "Flush pipeline test completed successfully!" << std::endl;
+}
+
+void testFlushRetry() {
+    std::cout << "\n--- Testing Failed Flush Retry ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_flush_retry";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    kv::Options options;
+    options.memtable_flush_threshold = 50;
+    options.flush_threads = 1;
+    std::vector<std::string> blocked;
+    {
+        kv::KVStore store(test_db_path, lock_mgr, options);
+        // Directories in place of the next two tables make their writes fail
+        uint64_t number = store.versionSet()->newFileNumber();
+        for (uint64_t n = number + 1; n <= number + 2; n++) {
+            blocked.push_back(test_db_path + "/" + kv::makeSSTableFileName(n));
+            std::filesystem::create_directories(blocked.back());
+        }
+        for (int i = 0; i < 50; i++) store.put("key" + std::to_string(i), "value" + std::to_string(i));
+
+        // The frozen memtable stays readable while its flush is retried
+        for (int i = 0; i < 50; i++) {
+            if (store.get("key" + std::to_string(i)) != std::optional<std::string>("value" + std::to_string(i))) {
+                throw std::runtime_error("ASSERT FAILED: writes of a failing flush should stay readable");
+            }
+        }
+        for (int i = 0; i < 500 && store.currentSSTableVersion()->tables.empty(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        auto version = store.currentSSTableVersion();
+        if (version->tables.size() != 1 || version->tables.front()->meta().file_number != number + 3) {
+            throw std::runtime_error("ASSERT FAILED: the flush should succeed on its third attempt");
+        }
+        if (store.flushedBytes() != version->tables.front()->meta().file_size) {
+            throw std::runtime_error("ASSERT FAILED: a retried flush should be counted once, counted " +
+                                     std::to_string(store.flushedBytes()) + " bytes");
+        }
+        for (int i = 50; i < 60; i++) store.put("key" + std::to_string(i), "value" + std::to_string(i));
+    }
+    for (const auto& dir : blocked) std::filesystem::remove(dir);
+
+    // Flushed and WAL-only writes both come back
+    kv::KVStore store(test_db_path, lock_mgr, options);
+    for (int i = 0; i < 60; i++) {
+        if (store.get("key" + std::to_string(i)) != std::optional<std::string>("value" + std::to_string(i))) {
+            throw std::runtime_error("ASSERT FAILED: key" + std::to_string(i) + " lost after a retried flush");
+        }
+    }
+    std::cout << "Failed flush retry test completed successfully!" << std::endl;
+}
+
+void testStreamingCompaction() {
+    std::cout << "\n--- Testing Streaming Compaction with Output Rolling ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_streaming_compaction";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+
+    // Three overlapping tables, newer files overwrite every other key
+    kv::SSTableWriter writer(test_db_path);
+    for (uint64_t file = 1; file <= 3; file++) {
+        std::vector<kv::Entry> entries;
+        for (int i = 0; i < 3000; i += static_cast<int>(file)) {
+            char key[16];
+            std::snprintf(key, sizeof(key), "key%05d", i);
+            entries.push_back(kv::Entry{key, file, "value" + std::to_string(file) + "_" + std::to_string(i)});
+        }
+        writer.writeSSTable(entries, file);
+    }
+
+    kv::KVStore store(test_db_path, lock_mgr);
+    const uint64_t kTarget = 16 * 1024;
+    kv::CompactionOptions compaction_options;
+    compaction_options.target_file_size = kTarget;
+    kv::Compactor compactor(test_db_path, 3, 3, lock_mgr, compaction_options);
+    compactor.setKVStore(&store);
+    compactor.start();
+    for (int i = 0; i < 500 && store.currentSSTableVersion()->tables.size() == 3; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    compactor.stop();
+
+    // The output rolled over into several tables with disjoint key ranges
+    auto version = store.currentSSTableVersion();
+    if (version->tables.size() < 4) {
+        throw std::runtime_error("ASSERT FAILED: compaction output should roll into several tables, got " +
+                                 std::to_string(version->tables.size()));
+    }
+    std::vector<std::pair<std::string, std::string>> ranges;
+    for (const auto& table : version->tables) {
+        ranges.emplace_back(table->meta().min_key, table->meta().max_key);
+        if (std::filesystem::file_size(table->path()) > kTarget + 64) {
+            throw std::runtime_error("ASSERT FAILED: output table exceeds the target size by more than one record");
+        }
+    }
+    std::sort(ranges.begin(), ranges.end());
+    for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].first <= ranges[i - 1].second) {
+            throw std::runtime_error("ASSERT FAILED: rolled outputs should not overlap");
+        }
+    }
+
+    // Every key resolves to its newest version
+    for (int i = 0; i < 3000; i += 7) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%05d", i);
+        int file = i % 3 == 0 ? 3 : (i % 2 == 0 ? 2 : 1);
+        auto value = store.get(key);
+        if (!value || *value != "value" + std::to_string(file) + "_" + std::to_string(i)) {
+            throw std::runtime_error(std::string("ASSERT FAILED: wrong value after streaming compaction for ") + key);
+        }
+    }
+    std::cout << "Streaming compaction test completed successfully!" << std::endl;
+}
+
+void testLoserTreeMerge() {
+    std::cout << "\n--- Testing Loser Tree Merge ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_loser_tree_merge";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+
+    // Seven overlapping inputs (not a power of two) that run dry at different keys;
+    // table f holds every f-th key below 2000 - 100 * f
+    const int kTables = 7;
+    kv::SSTableWriter writer(test_db_path);
+    for (uint64_t file = 1; file <= kTables; file++) {
+        std::vector<kv::Entry> entries;
+        for (int i = 0; i < 2000 - 100 * static_cast<int>(file); i += static_cast<int>(file)) {
+            char key[16];
+            std::snprintf(key, sizeof(key), "key%05d", i);
+            entries.push_back(kv::Entry{key, file, "value" + std::to_string(file) + "_" + std::to_string(i)});
+        }
+        writer.writeSSTable(entries, file);
+    }
+
+    kv::KVStore store(test_db_path, lock_mgr);
+    kv::CompactionOptions compaction_options;
+    compaction_options.max_subcompactions = 1;
+    kv::Compactor compactor(test_db_path, kTables, kTables, lock_mgr, compaction_options);
+    compactor.setKVStore(&store);
+    compactor.start();
+    for (int i = 0; i < 500 && compactor.stats().compactions == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    compactor.stop();
+    if (compactor.stats().compactions != 1 || compactor.stats().trivial_moves != 0) {
+        throw std::runtime_error("ASSERT FAILED: loser tree test expects one merge");
+    }
+
+    // Every key comes out once, in order, with the version of the newest table holding it
+    size_t count = 0;
+    std::string last;
+    auto it = store.newIterator();
+    for (it->seekToFirst(); it->valid(); it->next()) {
+        int i = std::stoi(it->key().substr(3));
+        int newest = 0;
+        for (int file = kTables; file >= 1 && !newest; file--) {
+            if (i % file == 0 && i < 2000 - 100 * file) newest = file;
+        }
+        if (it->key() <= last || it->value() != "value" + std::to_string(newest) + "_" + std::to_string(i)) {
+            throw std::runtime_error("ASSERT FAILED: loser tree merged " + it->key() + " wrongly: " + it->value());
+        }
+        last = it->key();
+        count++;
+    }
+    if (count != 1900) {
+        throw std::runtime_error("ASSERT FAILED: expected 1900 merged keys, got " + std::to_string(count));
+    }
+    std::cout << "Loser tree merge test completed successfully!" << std::endl;
+}
+
+void testLeveledCompaction() {
+    std::cout << "\n--- Testing Leveled Compaction ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_leveled_compaction";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+
+    kv::CompactionOptions compaction_options;
+    compaction_options.target_file_size = 4 * 1024;
+    compaction_options.max_bytes_for_level_base = 16 * 1024;
+    compaction_options.level_size_multiplier = 4;
+    compaction_options.num_levels = 4;
+
+    // Every level fits its budget once the compactor is done
+    auto settled = [&](const kv::Version& version) {
+        if (version.levelTables(0).size() >= 2) return false;
+        uint64_t budget = compaction_options.max_bytes_for_level_base;
+        for (int level = 1; level < compaction_options.num_levels - 1; ++level, budget *= 4) {
+            if (version.levelBytes(level) > budget) return false;
+        }
+        return true;
+    };
+
+    // Level 1 and deeper: disjoint key ranges, a lookup touches at most one table per level
+    auto checkLevels = [](const kv::Version& version) {
+        for (int level = 1; level <= version.maxLevel(); ++level) {
+            auto tables = version.levelTables(level);
+            std::sort(tables.begin(), tables.end(), [](const auto& a, const auto& b) {
+                return a->meta().min_key < b->meta().min_key;
+            });
+            for (size_t i = 1; i < tables.size(); ++i) {
+                if (tables[i]->meta().min_key <= tables[i - 1]->meta().max_key) {
+                    throw std::runtime_error("ASSERT FAILED: tables of level " + std::to_string(level) + " overlap");
+                }
+            }
+        }
+    };
+
+    std::map<std::string, std::optional<std::string>> model;
+    {
+        kv::Options options;
+        options.memtable_flush_threshold = 100;
+        kv::KVStore store(test_db_path, lock_mgr, options);
+        kv::Compactor compactor(test_db_path, 2, 2, lock_mgr, compaction_options);
+        compactor.setKVStore(&store);
+        compactor.start();
+
+        std::mt19937 rng(7);
+        for (int i = 0; i < 6000; i++) {
+            char key[16];
+            std::snprintf(key, sizeof(key), "key%04u", static_cast<unsigned>(rng() % 1500));
+            if (rng() % 10 == 0) {
+                store.del(key);
+                model[key] = std::nullopt;
+            } else {
+                std::string value = "v" + std::to_string(i);
+                store.put(key, value);
+                model[key] = value;
+            }
+        }
+
+        for (int i = 0; i < 1000 && !settled(*store.currentSSTableVersion()); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        compactor.stop();
+
+        auto version = store.currentSSTableVersion();
+        if (!settled(*version)) {
+            throw std::runtime_error("ASSERT FAILED: compactor should bring every level within budget");
+        }
+        if (version->maxLevel() < 2) {
+            throw std::runtime_error("ASSERT FAILED: data should have been pushed down to level 2, deepest is " +
+                                     std::to_string(version->maxLevel()));
+        }
+        checkLevels(*version);
+
+        for (const auto& [key, expected] : model) {
+            size_t deeper_candidates = 0;
+            for (size_t id : version->range_index.find(key)) {
+                if (version->tables[id]->meta().level > 0) deeper_candidates++;
+            }
+            if (deeper_candidates > static_cast<size_t>(version->maxLevel())) {
+                throw std::runtime_error("ASSERT FAILED: lookup of " + key + " touches more than one table per level");
+            }
+            if (store.get(key) != expected) {
+                throw std::runtime_error("ASSERT FAILED: wrong value for " + key + " after leveled compaction");
+            }
+        }
+    }
+
+    // Levels come back from the MANIFEST
+    kv::KVStore store(test_db_path, lock_mgr);
+    auto version = store.currentSSTableVersion();
+    if (version->maxLevel() < 2) {
+        throw std::runtime_error("ASSERT FAILED: table levels should survive reopen");
+    }
+    checkLevels(*version);
+    for (const auto& [key, expected] : model) {
+        if (store.get(key) != expected) {
+            throw std::runtime_error("ASSERT FAILED: wrong value for " + key + " after reopen");
+        }
+    }
+    std::cout << "Leveled compaction test completed successfully!" << std::endl;
+}
+
+void testCompactionPickers() {
+    std::cout << "\n--- Testing Leveled vs Universal Compaction Pickers ---" << std::endl;
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+
+    // Same workload under both strategies
+    auto runWorkload = [&](kv::CompactionStyle style, const std::string& name) {
+        std::string test_db_path = TEST_DIR + "/test_compaction_picker_" + name;
+        if (std::filesystem::exists(test_db_path)) {
+            std::filesystem::remove_all(test_db_path);
+        }
+        kv::CompactionOptions compaction_options;
+        compaction_options.style = style;
+        compaction_options.target_file_size = 4 * 1024;
+        compaction_options.max_bytes_for_level_base = 16 * 1024;
+        compaction_options.level_size_multiplier = 4;
+        compaction_options.num_levels = 4;
+
+        kv::Options options;
+        options.memtable_flush_threshold = 100;
+        options.flush_threads = 1;
+        kv::KVStore store(test_db_path, lock_mgr, options);
+        kv::Compactor compactor(test_db_path, 4, 2, lock_mgr, compaction_options);
+        compactor.setKVStore(&store);
+        compactor.start();
+
+        std::mt19937 rng(11);
+        std::map<std::string, std::string> model;
+        for (int i = 0; i < 8000; i++) {
+            char key[16];
+            std::snprintf(key, sizeof(key), "key%04u", static_cast<unsigned>(rng() % 2000));
+            store.put(key, "v" + std::to_string(i));
+            model[key] = "v" + std::to_string(i);
+        }
+        // Let the compactor drain until the tree has the strategy's shape
+        auto settled = [&](const kv::Version& version) {
+            if (version.levelTables(0).size() >= 4) return false;
+            return style == kv::CompactionStyle::Universal ||
+                   (version.levelBytes(1) <= 16 * 1024 && version.levelBytes(2) <= 64 * 1024);
+        };
+        for (int i = 0; i < 1000 && !settled(*store.currentSSTableVersion()); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        compactor.stop();
+        if (!settled(*store.currentSSTableVersion())) {
+            throw std::runtime_error("ASSERT FAILED: " + name + " compaction should settle");
+        }
+
+        for (const auto& [key, expected] : model) {
+            auto value = store.get(key);
+            if (!value || *value != expected) {
+                throw std::runtime_error("ASSERT FAILED: " + name + " compaction lost " + key);
+            }
+        }
+        kv::CompactionStats stats = compactor.stats();
+        std::cout << "   " << stats.strategy << ": " << stats.compactions << " compactions, flushed "
+                  << stats.bytes_flushed << " bytes, compaction wrote " << stats.bytes_written
+                  << ", write amp " << stats.write_amplification << ", space amp " << stats.space_amplification
+                  << ", " << store.currentSSTableVersion()->tables.size() << " tables" << std::endl;
+        if (stats.strategy != name || stats.compactions == 0 || stats.bytes_flushed == 0) {
+            throw std::runtime_error("ASSERT FAILED: " + name + " stats should report its compactions");
+        }
+        double expected_write_amp = static_cast<double>(stats.bytes_flushed + stats.bytes_written) / stats.bytes_flushed;
+        if (std::abs(stats.write_amplification - expected_write_amp) > 1e-9 || stats.space_amplification < 1.0) {
+            throw std::runtime_error("ASSERT FAILED: " + name + " amplification estimates are inconsistent");
+        }
+        if (style == kv::CompactionStyle::Universal && store.currentSSTableVersion()->maxLevel() != 0) {
+            throw std::runtime_error("ASSERT FAILED: universal compaction keeps every run in level 0");
+        }
+    };
+
+    // Which one amplifies less depends on the workload, that is what the stats are for
+    runWorkload(kv::CompactionStyle::Leveled, "leveled");
+    runWorkload(kv::CompactionStyle::Universal, "universal");
+    std::cout << "Compaction picker test completed successfully!" << std::endl;
+}
+
+void testSubcompactions() {
+    std::cout << "\n--- Testing Parallel Subcompactions ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_subcompactions";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+
+    // Four overlapping tables; the newest one deletes every fifth key
+    kv::SSTableWriter writer(test_db_path);
+    for (uint64_t file = 1; file <= 4; file++) {
+        std::vector<kv::Entry> entries;
+        for (int i = 0; i < 4000; i++) {
+            char key[16];
+            std::snprintf(key, sizeof(key), "key%05d", i);
+            if (file == 4 && i % 5 != 0) continue;
+            std::string value = file == 4 ? kv::TOMB_STONE : "value" + std::to_string(file) + "_" + std::to_string(i);
+            entries.push_back(kv::Entry{key, file, value});
+        }
+        writer.writeSSTable(entries, file);
+    }
+
+    kv::KVStore store(test_db_path, lock_mgr);
+    kv::CompactionOptions compaction_options;
+    compaction_options.target_file_size = 16 * 1024;
+    compaction_options.max_subcompactions = 4;
+    kv::Compactor compactor(test_db_path, 4, 4, lock_mgr, compaction_options);
+    compactor.setKVStore(&store);
+    compactor.start();
+    for (int i = 0; i < 500 && compactor.stats().compactions == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    compactor.stop();
+
+    // One compaction, merged as four key ranges
+    kv::CompactionStats stats = compactor.stats();
+    if (stats.compactions != 1 || stats.subcompactions != 4) {
+        throw std::runtime_error("ASSERT FAILED: expected 1 compaction split in 4, got " +
+                                 std::to_string(stats.compactions) + "/" + std::to_string(stats.subcompactions));
+    }
+
+    // Outputs of all ranges were installed together and do not overlap
+    auto version = store.currentSSTableVersion();
+    std::vector<std::pair<std::string, std::string>> ranges;
+    for (const auto& table : version->tables) {
+        if (table->meta().level == 0) {
+            throw std::runtime_error("ASSERT FAILED: all inputs should be replaced by the subcompaction outputs");
+        }
+        ranges.emplace_back(table->meta().min_key, table->meta().max_key);
+    }
+    std::sort(ranges.begin(), ranges.end());
+    for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].first <= ranges[i - 1].second) {
+            throw std::runtime_error("ASSERT FAILED: subcompaction outputs should not overlap");
+        }
+    }
+
+    // Every key survived exactly once with its newest version, deleted keys are gone
+    size_t live = 0;
+    auto it = store.newIterator();
+    for (it->seekToFirst(); it->valid(); it->next()) {
+        live++;
+    }
+    if (live != 3200) {
+        throw std::runtime_error("ASSERT FAILED: expected 3200 live keys after subcompactions, got " + std::to_string(live));
+    }
+    for (int i = 0; i < 4000; i += 3) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%05d", i);
+        auto value = store.get(key);
+        bool deleted = i % 5 == 0;
+        if (deleted ? value.has_value() : (!value || *value != "value3_" + std::to_string(i))) {
+            throw std::runtime_error(std::string("ASSERT FAILED: wrong value after subcompactions for ") + key);
+        }
+    }
+    std::cout << "Subcompaction test completed successfully!" << std::endl;
+}
+
+void testRateLimiter() {
+    std::cout << "\n--- Testing I/O Rate Limiter ---" << std::endl;
+    using Clock = std::chrono::steady_clock;
+
+    // 1 MiB/s: past the initial burst of one refill period, 300 KiB take about 0.2s
+    {
+        kv::RateLimiter limiter(1 << 20);
+        auto start = Clock::now();
+        for (int i = 0; i < 10; i++) {
+            limiter.request(30 * 1024, kv::IoPriority::Low);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+        if (elapsed < 150) {
+            throw std::runtime_error("ASSERT FAILED: rate limiter let 300 KiB through in " + std::to_string(elapsed) + "ms");
+        }
+        if (limiter.totalBytesThrough(kv::IoPriority::Low) != 300 * 1024 ||
+            limiter.totalBytesThrough(kv::IoPriority::High) != 0) {
+            throw std::runtime_error("ASSERT FAILED: rate limiter byte counters are wrong");
+        }
+    }
+
+    // A flush arriving after a compaction is served first
+    {
+        kv::RateLimiter limiter(200 * 1024);
+        limiter.request(20 * 1024, kv::IoPriority::Low); // Empty the bucket
+        std::atomic<int> order{0};
+        int low_done = 0, high_done = 0;
+        std::thread low([&] {
+            limiter.request(100 * 1024, kv::IoPriority::Low);
+            low_done = ++order;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::thread high([&] {
+            limiter.request(100 * 1024, kv::IoPriority::High);
+            high_done = ++order;
+        });
+        low.join();
+        high.join();
+        if (high_done != 1 || low_done != 2) {
+            throw std::runtime_error("ASSERT FAILED: high priority requests should overtake low priority ones");
+        }
+    }
+
+    // Auto-tuning halves the rate while reads are slow and recovers once they are fast again
+    {
+        kv::RateLimiter limiter(8 << 20);
+        limiter.enableAutoTune(std::chrono::microseconds(100), 1 << 20);
+        auto slowUntil = Clock::now() + std::chrono::milliseconds(350);
+        while (Clock::now() < slowUntil) {
+            limiter.recordForegroundLatency(std::chrono::microseconds(1000));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        uint64_t backed_off = limiter.bytesPerSecond();
+        if (backed_off > (2 << 20) || backed_off < (1 << 20)) {
+            throw std::runtime_error("ASSERT FAILED: auto-tuning should back off, rate is " + std::to_string(backed_off));
+        }
+        auto fastUntil = Clock::now() + std::chrono::milliseconds(350);
+        while (Clock::now() < fastUntil) {
+            limiter.recordForegroundLatency(std::chrono::microseconds(10));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        if (limiter.bytesPerSecond() <= backed_off || limiter.bytesPerSecond() > (8 << 20)) {
+            throw std::runtime_error("ASSERT FAILED: auto-tuning should speed up again");
+        }
+    }
+
+    // Flushes and compactions of a store both go through its limiter
+    {
+        std::string test_db_path = TEST_DIR + "/test_rate_limiter";
+        if (std::filesystem::exists(test_db_path)) {
+            std::filesystem::remove_all(test_db_path);
+        }
+        auto lock_mgr = std::make_shared<kv::LockManager>();
+        auto limiter = std::make_shared<kv::RateLimiter>(64 << 20, true);
+        kv::Options options;
+        options.memtable_flush_threshold = 100;
+        options.rate_limiter = limiter;
+        kv::KVStore store(test_db_path, lock_mgr, options);
+        kv::Compactor compactor(test_db_path, 2, 2, lock_mgr);
+        compactor.setKVStore(&store);
+        compactor.start();
+        for (int i = 0; i < 1000; i++) {
+            store.put("key" + std::to_string(i % 300), "value" + std::to_string(i));
+        }
+        for (int i = 0; i < 500 && compactor.stats().compactions == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        compactor.stop();
+        kv::CompactionStats stats = compactor.stats();
+        if (store.flushedBytes() == 0 || limiter->totalBytesThrough(kv::IoPriority::High) < store.flushedBytes() ||
+            limiter->totalBytesThrough(kv::IoPriority::Low) < stats.bytes_read + stats.bytes_written) {
+            throw std::runtime_error("ASSERT FAILED: flush and compaction I/O should be charged to the limiter");
+        }
+        for (int i = 700; i < 1000; i++) {
+            auto value = store.get("key" + std::to_string(i % 300));
+            if (!value || *value != "value" + std::to_string(i)) {
+                throw std::runtime_error("ASSERT FAILED: wrong value with a rate limiter");
+            }
+        }
+    }
+    std::cout << "Rate limiter test completed successfully!" << std::endl;
+}
+
+void testCompactionInstallLock() {
+    std::cout << "\n--- Testing Flushes During a Running Compaction ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_compaction_install_lock";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+
+    // Three overlapping tables of ~200 KiB each
+    kv::SSTableWriter writer(test_db_path);
+    std::set<std::string> inputs;
+    for (uint64_t file = 1; file <= 3; file++) {
+        std::vector<kv::Entry> entries;
+        for (int i = 0; i < 6000; i++) {
+            char key[16];
+            std::snprintf(key, sizeof(key), "key%05d", i);
+            entries.push_back(kv::Entry{key, file, "value" + std::to_string(file) + "_" + std::to_string(i)});
+        }
+        writer.writeSSTable(entries, file);
+        inputs.insert(kv::makeSSTableFileName(file));
+    }
+
+    // Compaction I/O is throttled to take about a second, flushes overtake it
+    auto limiter = std::make_shared<kv::RateLimiter>(1 << 20, true);
+    kv::Options options;
+    options.memtable_flush_threshold = 50;
+    options.rate_limiter = limiter;
+    kv::KVStore store(test_db_path, lock_mgr, options);
+    kv::Compactor compactor(test_db_path, 3, 3, lock_mgr);
+    compactor.setKVStore(&store);
+    compactor.start();
+    for (int i = 0; i < 500 && limiter->totalBytesThrough(kv::IoPriority::Low) == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // A flush is installed, and reads are served, while the merge is still running
+    for (int i = 0; i < 60; i++) {
+        store.put("new" + std::to_string(i), "fresh" + std::to_string(i));
+    }
+    auto flushed = [&] {
+        for (const auto& table : store.currentSSTableVersion()->tables) {
+            if (table->meta().level == 0 && !inputs.count(table->meta().filename)) return true;
+        }
+        return false;
+    };
+    for (int i = 0; i < 500 && !flushed(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto value = store.get("key00042");
+    if (!flushed() || compactor.stats().compactions != 0) {
+        throw std::runtime_error("ASSERT FAILED: a flush should be installed before the running compaction finishes");
+    }
+    if (!value || *value != "value3_42") {
+        throw std::runtime_error("ASSERT FAILED: reads during a compaction should see the inputs");
+    }
+
+    for (int i = 0; i < 1000 && compactor.stats().compactions == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    compactor.stop();
+    if (compactor.stats().compactions == 0) {
+        throw std::runtime_error("ASSERT FAILED: the throttled compaction should finish");
+    }
+
+    // Both the compaction result and the flush concurrent with it are live
+    for (int i = 0; i < 6000; i += 11) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%05d", i);
+        auto v = store.get(key);
+        if (!v || *v != "value3_" + std::to_string(i)) {
+            throw std::runtime_error(std::string("ASSERT FAILED: wrong value after compaction for ") + key);
+        }
+    }
+    for (int i = 0; i < 60; i++) {
+        auto v = store.get("new" + std::to_string(i));
+        if (!v || *v != "fresh" + std::to_string(i)) {
+            throw std::runtime_error("ASSERT FAILED: write during compaction was lost");
+        }
+    }
+
+    // A large output that still has to be scanned does not hold up a flush install.
+    // Its file is a FIFO, so the scan blocks until the test feeds it the table
+    std::string held_path = test_db_path + "/held";
+    std::filesystem::create_directories(held_path);
+    kv::VersionSet versions(held_path);
+    uint64_t large = versions.newFileNumber();
+    std::string large_file = held_path + "/" + kv::makeSSTableFileName(large);
+    if (::mkfifo(large_file.c_str(), 0644) != 0) {
+        throw std::runtime_error("ASSERT FAILED: cannot create FIFO " + large_file);
+    }
+    auto large_install = std::async(std::launch::async, [&] {
+        kv::VersionEdit edit;
+        edit.addTable(large, 1);
+        versions.logAndApply(edit);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Flushes hand over the table they indexed while writing
+    kv::SSTableWriter held_writer(held_path);
+    std::vector<std::string> keys{"flush_a", "flush_b", "flush_c"};
+    std::string tombstone = kv::TOMB_STONE;
+    std::vector<kv::EntryRef> refs{{&keys[0], 9, &keys[0]}, {&keys[1], 8, &tombstone}, {&keys[2], 7, &keys[2]}};
+    uint64_t small = versions.newFileNumber();
+    held_writer.writeSSTable(refs, small);
+    auto flush_install = std::async(std::launch::async, [&] {
+        kv::VersionEdit edit;
+        edit.addTable(held_writer.makeTable(refs, small, 0));
+        versions.logAndApply(edit);
+    });
+    bool overtook = flush_install.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+
+    // Release the scan either way, so a failure does not hang the test
+    {
+        std::string source_path = test_db_path + "_source";
+        std::filesystem::create_directories(source_path);
+        kv::SSTableWriter source(source_path);
+        source.writeSSTable(std::vector<kv::Entry>{{"large", 1, "x"}}, 1);
+        std::ifstream in(source_path + "/" + kv::makeSSTableFileName(1), std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        int fd = ::open(large_file.c_str(), O_WRONLY);
+        if (fd < 0 || ::write(fd, bytes.data(), bytes.size()) != static_cast<ssize_t>(bytes.size())) {
+            throw std::runtime_error("ASSERT FAILED: cannot feed the held table");
+        }
+        ::close(fd);
+    }
+    large_install.get();
+    flush_install.get();
+    if (!overtook) {
+        throw std::runtime_error("ASSERT FAILED: a flush install should not wait for another install's scan");
+    }
+
+    // The prebuilt metadata matches what a scan of the flushed file finds
+    auto held_version = versions.current();
+    if (held_version->tables.size() != 2) {
+        throw std::runtime_error("ASSERT FAILED: both the held and the flushed table should be live");
+    }
+    kv::SSTableMeta scanned;
+    auto scanned_index = kv::scanSSTable(held_path + "/" + kv::makeSSTableFileName(small), scanned);
+    for (const auto& table : held_version->tables) {
+        const kv::SSTableMeta& meta = table->meta();
+        if (meta.file_number == large && (meta.level != 1 || meta.min_key != "large" || meta.max_key != "large")) {
+            throw std::runtime_error("ASSERT FAILED: the held table should be scanned once it is readable");
+        }
+        if (meta.file_number == small &&
+            (!scanned_index || meta.level != 0 || meta.min_key != scanned.min_key || meta.max_key != scanned.max_key ||
+             meta.min_seq != scanned.min_seq || meta.max_seq != scanned.max_seq || meta.file_size != scanned.file_size ||
+             meta.num_entries != scanned.num_entries || meta.num_deletions != 1 || scanned.num_deletions != 1)) {
+            throw std::runtime_error("ASSERT FAILED: metadata built while writing should match a scan");
+        }
+    }
+    std::cout << "Compaction install lock test completed successfully!" << std::endl;
+}
+
+void testLockStats() {
+    std::cout << "\n--- Testing Lock Instrumentation ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_lock_stats";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+
+    kv::LatencyHistogram histogram;
+    for (uint64_t nanos : {0, 1, 2, 3, 1000, 1023, 1024}) histogram.add(nanos);
+    if (kv::LatencyHistogram::bucketFor(1023) != 9 || kv::LatencyHistogram::bucketFor(1024) != 10 ||
+        histogram.percentile(0.5) != 3 || histogram.percentile(1.0) != 1024 || histogram.max != 1024) {
+        throw std::runtime_error("ASSERT FAILED: histogram buckets are powers of two");
+    }
+
+    // Four writers through the MemTable lock
+    {
+        kv::Options options;
+        options.memtable_flush_threshold = 1000;
+        kv::KVStore store(test_db_path, lock_mgr, options);
+        std::vector<std::thread> writers;
+        for (int t = 0; t < 4; t++) {
+            writers.emplace_back([&store, t] {
+                for (int i = 0; i < 200; i++) store.put("key" + std::to_string(t) + "_" + std::to_string(i), "value");
+            });
+        }
+        for (auto& writer : writers) writer.join();
+    }
+
+    // A write lock held for 20ms: the reader waits at least that long
+    lock_mgr->resetStats();
+    {
+        static const kv::LockSite kWriterSite("testLockStats/writer");
+        static const kv::LockSite kReaderSite("testLockStats/reader");
+        auto write_lock = lock_mgr->acquireSSTableWriteLock(kWriterSite);
+        std::thread reader([&] {
+            auto read_lock = lock_mgr->acquireSSTableReadLock(kReaderSite);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        write_lock.unlock();
+        reader.join();
+    }
+    auto find = [&](kv::LockType type, const std::string& site) {
+        for (const auto& stats : lock_mgr->stats()) {
+            if (stats.type == type && stats.site == site) return stats;
+        }
+        throw std::runtime_error("ASSERT FAILED: no lock stats for " + site);
+    };
+    auto writer = find(kv::LockType::SSTableWrite, "testLockStats/writer");
+    auto reader = find(kv::LockType::SSTableRead, "testLockStats/reader");
+    if (writer.acquisitions != 1 || writer.contended != 0 || writer.hold.count != 1 || writer.hold.max < 20000000) {
+        throw std::runtime_error("ASSERT FAILED: uncontended write lock should be held for 20ms");
+    }
+    if (reader.acquisitions != 1 || reader.contended != 1 || reader.wait.max < 10000000) {
+        throw std::runtime_error("ASSERT FAILED: read lock should wait for the writer");
+    }
+
+    // The writes before the reset are gone; new ones are counted per site
+    if (find(kv::LockType::MemTable, "KVStore::write").acquisitions != 0) {
+        throw std::runtime_error("ASSERT FAILED: resetStats() should clear every site");
+    }
+    {
+        kv::KVStore store(test_db_path, lock_mgr);
+        for (int i = 0; i < 50; i++) store.put("again" + std::to_string(i), "value");
+    }
+    auto writes = find(kv::LockType::MemTable, "KVStore::write");
+    if (writes.acquisitions < 50 || writes.hold.count != writes.acquisitions || writes.wait.count != writes.acquisitions) {
+        throw std::runtime_error("ASSERT FAILED: every put should be counted under KVStore::write");
+    }
+    for (const auto& stats : lock_mgr->stats()) {
+        std::cout << "   " << kv::lockTypeName(stats.type) << " " << stats.site << ": " << stats.acquisitions
+                  << " acquired, " << stats.contended << " contended, p99 wait " << stats.wait.percentile(0.99)
+                  << "ns, p99 hold " << stats.hold.percentile(0.99) << "ns" << std::endl;
+    }
+    std::cout << "Lock instrumentation test completed successfully!" << std::endl;
+}
+
+void testRangeDeletion() {
+    std::cout << "\n--- Testing Range Deletion ---" << std::endl;
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    auto tenantKey = [](int tenant, int i) {
+        char key[24];
+        std::snprintf(key, sizeof(key), "tenant%d:%05d", tenant, i);
+        return std::string(key);
+    };
+
+    // Survives a restart, from the WAL before a flush and from the MANIFEST after one
+    {
+        std::string test_db_path = TEST_DIR + "/test_range_deletion_recovery";
+        if (std::filesystem::exists(test_db_path)) {
+            std::filesystem::remove_all(test_db_path);
+        }
+        kv::Options options;
+        options.memtable_flush_threshold = 100;
+        {
+            kv::KVStore store(test_db_path, lock_mgr, options);
+            for (int i = 0; i < 50; i++) store.put(tenantKey(1, i), "v");
+            store.deleteRange(tenantKey(1, 10), tenantKey(1, 20));
+        }
+        {
+            kv::KVStore store(test_db_path, lock_mgr, options);
+            if (store.get(tenantKey(1, 15)) || !store.get(tenantKey(1, 20))) {
+                throw std::runtime_error("ASSERT FAILED: range deletion should be replayed from the WAL");
+            }
+            for (int i = 0; i < 200; i++) store.put(tenantKey(2, i), "v");
+            for (int i = 0; i < 500 && store.currentSSTableVersion()->range_tombstones.empty(); i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+        kv::KVStore store(test_db_path, lock_mgr, options);
+        if (store.currentSSTableVersion()->range_tombstones.size() != 1 ||
+            store.get(tenantKey(1, 10)) || !store.get(tenantKey(1, 9))) {
+            throw std::runtime_error("ASSERT FAILED: flushed range deletion should be recovered from the MANIFEST");
+        }
+    }
+
+    std::string test_db_path = TEST_DIR + "/test_range_deletion";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    kv::Options options;
+    options.memtable_flush_threshold = 200;
+    kv::CompactionOptions compaction_options;
+    compaction_options.target_file_size = 4 * 1024;
+    kv::KVStore store(test_db_path, lock_mgr, options);
+    kv::Compactor compactor(test_db_path, 4, 4, lock_mgr, compaction_options);
+    compactor.setKVStore(&store);
+    compactor.start();
+
+    // Interleaved, so every flush overlaps the others and compaction merges instead of moving tables
+    for (int i = 0; i < 2000; i++) {
+        for (int tenant = 0; tenant < 3; tenant++) {
+            if (tenant != 1 && i >= 1000) continue;
+            store.put(tenantKey(tenant, i), "value" + std::to_string(i));
+        }
+    }
+    auto snapshot = store.getSnapshot();
+
+    // Dropping tenant1 is a single write; a later put into the range is not affected
+    kv::SequenceNumber before = store.lastSequence();
+    store.deleteRange("tenant1:", "tenant1;");
+    if (store.lastSequence() != before + 1) {
+        throw std::runtime_error("ASSERT FAILED: deleteRange should be a single write");
+    }
+    store.put(tenantKey(1, 5), "reborn");
+
+    auto checkDeleted = [&](const std::string& when) {
+        if (store.get(tenantKey(1, 10)) || store.get(tenantKey(1, 1999)) || !store.get(tenantKey(0, 999)) ||
+            !store.get(tenantKey(2, 0)) || store.get(tenantKey(1, 5)) != std::optional<std::string>("reborn")) {
+            throw std::runtime_error("ASSERT FAILED: get() should respect the range tombstone " + when);
+        }
+        auto results = store.multiGet({tenantKey(1, 7), tenantKey(1, 5), tenantKey(2, 7)});
+        if (results[0] || results[1] != std::optional<std::string>("reborn") || !results[2]) {
+            throw std::runtime_error("ASSERT FAILED: multiGet() should respect the range tombstone " + when);
+        }
+        size_t live = 0;
+        auto it = store.newIterator();
+        for (it->seekToFirst(); it->valid(); it->next()) {
+            if (it->key().rfind("tenant1:", 0) == 0 && it->key() != tenantKey(1, 5)) {
+                throw std::runtime_error("ASSERT FAILED: iterator returned range deleted key " + it->key());
+            }
+            live++;
+        }
+        size_t reverse = 0;
+        for (it->seekToLast(); it->valid(); it->prev()) reverse++;
+        if (live != 2001 || reverse != live) {
+            throw std::runtime_error("ASSERT FAILED: iterator should see 2001 live keys " + when + ", got " +
+                                     std::to_string(live) + "/" + std::to_string(reverse));
+        }
+    };
+    checkDeleted("in the MemTable");
+
+    // The snapshot predates the deletion
+    if (store.get(tenantKey(1, 10), snapshot) != std::optional<std::string>("value10")) {
+        throw std::runtime_error("ASSERT FAILED: snapshot should still see range deleted keys");
+    }
+
+    // Push everything through flushes and compactions; once the snapshot is gone
+    // compaction drops the covered keys and then the tombstone itself. The rewrites
+    // of the neighbouring tenants span tenant1, so they are merged with its tables
+    snapshot.reset();
+    for (int i = 0; i < 600; i++) {
+        store.put(tenantKey(0, i), "value" + std::to_string(i));
+        store.put(tenantKey(2, i), "value" + std::to_string(i));
+    }
+    auto settled = [&] {
+        auto version = store.currentSSTableVersion();
+        return version->range_tombstones.empty() && version->levelTables(0).size() < 4 && store.flushedBytes() > 0;
+    };
+    for (int i = 0; i < 1000 && !settled(); i++) {
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
-    
-    // 4) Stop the flusher
-    flusher.stop();
-    std::cout << "Flusher test completed." << std::endl;
-    std::cout << "SSTable files written to: " << test_sstable_dir << std::endl;
+    compactor.stop();
+    if (!settled()) {
+        throw std::runtime_error("ASSERT FAILED: compaction should drop the range tombstone once it hides nothing");
+    }
+    checkDeleted("after compaction");
+    std::cout << "Range deletion test completed successfully!" << std::endl;
+}
+
+void testCompactionFilter() {
+    std::cout << "\n--- Testing Compaction Filter and TTL ---" << std::endl;
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    auto freshDir = [](const std::string& name) {
+        std::string path = TEST_DIR + "/" + name;
+        if (std::filesystem::exists(path)) {
+            std::filesystem::remove_all(path);
+        }
+        std::filesystem::create_directories(path);
+        return path;
+    };
+    auto keyOf = [](const char* prefix, int i) {
+        char key[24];
+        std::snprintf(key, sizeof(key), "%s%05d", prefix, i);
+        return std::string(key);
+    };
+    // Four tables with every fourth of the 300 keys each, compacted together into level 1
+    auto compactAll = [&](const std::string& path, kv::KVStore& store) {
+        kv::Compactor compactor(path, 4, 4, lock_mgr);
+        compactor.setKVStore(&store);
+        compactor.start();
+        for (int i = 0; i < 500 && compactor.stats().compactions == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        compactor.stop();
+        if (compactor.stats().compactions != 1) {
+            throw std::runtime_error("ASSERT FAILED: compaction filter test expects one compaction");
+        }
+        return compactor.stats();
+    };
+
+    // Filter: drop tmp keys, rewrite cfg values, keep the rest
+    {
+        class TestFilter : public kv::CompactionFilter {
+        public:
+            mutable std::atomic<int> max_level{-1};
+            const char* name() const override { return "TestFilter"; }
+            Decision filter(int level, const std::string& key, const std::string& value,
+                            std::string* new_value) const override {
+                max_level = std::max(max_level.load(), level);
+                if (key.rfind("tmp:", 0) == 0) return Decision::Remove;
+                if (key.rfind("cfg:", 0) == 0) {
+                    *new_value = value + "!";
+                    return Decision::ChangeValue;
+                }
+                return Decision::Keep;
+            }
+        };
+        const char* prefixes[] = {"tmp:", "cfg:", "keep:"};
+        std::string path = freshDir("test_compaction_filter");
+        kv::SSTableWriter writer(path);
+        for (uint64_t file = 1; file <= 4; file++) {
+            std::vector<kv::Entry> entries;
+            for (int i = static_cast<int>(file) - 1; i < 300; i += 4) {
+                entries.push_back(kv::Entry{keyOf(prefixes[i % 3], i), file, "value" + std::to_string(i)});
+            }
+            std::sort(entries.begin(), entries.end(), [](const kv::Entry& a, const kv::Entry& b) { return a.key < b.key; });
+            writer.writeSSTable(entries, file);
+        }
+        auto filter = std::make_shared<TestFilter>();
+        kv::Options options;
+        options.compaction_filter = filter;
+        options.row_cache_bytes = 1 << 20;
+        kv::KVStore store(path, lock_mgr, options);
+        // Cached before the compaction, the rows must not outlive the filter's decisions
+        if (store.get(keyOf("tmp:", 3)) != std::optional<std::string>("value3") ||
+            store.get(keyOf("cfg:", 4)) != std::optional<std::string>("value4")) {
+            throw std::runtime_error("ASSERT FAILED: unfiltered values expected before the compaction");
+        }
+        kv::CompactionStats stats = compactAll(path, store);
+
+        if (stats.entries_filtered != 100 || stats.entries_expired != 0 || filter->max_level != 1) {
+            throw std::runtime_error("ASSERT FAILED: filter should remove 100 tmp keys at level 1, removed " +
+                                     std::to_string(stats.entries_filtered));
+        }
+        if (store.get(keyOf("tmp:", 3)) || store.get(keyOf("cfg:", 4)) != std::optional<std::string>("value4!") ||
+            store.get(keyOf("keep:", 5)) != std::optional<std::string>("value5")) {
+            throw std::runtime_error("ASSERT FAILED: compaction filter decisions not applied");
+        }
+        if (store.get(keyOf("tmp:", 3)) || store.rowCache()->hits() == 0) {
+            throw std::runtime_error("ASSERT FAILED: filtered reads should go through the row cache");
+        }
+        size_t live = 0;
+        auto it = store.newIterator();
+        for (it->seekToFirst(); it->valid(); it->next()) live++;
+        if (live != 200) {
+            throw std::runtime_error("ASSERT FAILED: expected 200 keys after filtering, got " + std::to_string(live));
+        }
+    }
+
+    // TTL: even keys were written an hour ago, odd ones just now
+    {
+        std::string path = freshDir("test_compaction_ttl");
+        uint64_t now = kv::unixSeconds();
+        kv::SSTableWriter writer(path);
+        for (uint64_t file = 1; file <= 4; file++) {
+            std::vector<kv::Entry> entries;
+            for (int i = static_cast<int>(file) - 1; i < 300; i += 4) {
+                uint64_t written = i % 2 == 0 ? now - 3600 : now;
+                entries.push_back(kv::Entry{keyOf("session:", i), file, kv::appendWriteTime("v" + std::to_string(i), written)});
+            }
+            writer.writeSSTable(entries, file);
+        }
+        kv::Options options;
+        options.ttl = std::chrono::seconds(60);
+        kv::KVStore store(path, lock_mgr, options);
+        store.put("session:fresh", "new");
+
+        auto checkExpiry = [&](const std::string& when) {
+            if (store.get(keyOf("session:", 10)) || store.get(keyOf("session:", 11)) != std::optional<std::string>("v11") ||
+                store.get("session:fresh") != std::optional<std::string>("new")) {
+                throw std::runtime_error("ASSERT FAILED: get() should hide expired keys " + when);
+            }
+            auto results = store.multiGet({keyOf("session:", 20), keyOf("session:", 21), "session:fresh"});
+            if (results[0] || results[1] != std::optional<std::string>("v21") || results[2] != std::optional<std::string>("new")) {
+                throw std::runtime_error("ASSERT FAILED: multiGet() should hide expired keys " + when);
+            }
+            size_t live = 0;
+            auto it = store.newIterator();
+            for (it->seekToFirst(); it->valid(); it->next()) {
+                if (it->value().size() > 4) {
+                    throw std::runtime_error("ASSERT FAILED: iterator should strip the write time from " + it->key());
+                }
+                live++;
+            }
+            if (live != 151) {
+                throw std::runtime_error("ASSERT FAILED: iterator should see 151 unexpired keys " + when + ", got " +
+                                         std::to_string(live));
+            }
+        };
+        checkExpiry("before compaction");
+        kv::CompactionStats stats = compactAll(path, store);
+        if (stats.entries_expired != 150) {
+            throw std::runtime_error("ASSERT FAILED: compaction should drop 150 expired keys, dropped " +
+                                     std::to_string(stats.entries_expired));
+        }
+        checkExpiry("after compaction");
+
+        // A value of its own ending in ten digits is not a stamp
+        if (kv::writeTime("order0000012345") ||
+            kv::unwrapTtl("order0000012345", options.ttl, now) != std::optional<std::string>("order0000012345")) {
+            throw std::runtime_error("ASSERT FAILED: unstamped values ending in digits should never expire");
+        }
+        if (kv::writeTime(kv::appendWriteTime("order0000012345", 42)) != std::optional<uint64_t>(42)) {
+            throw std::runtime_error("ASSERT FAILED: a stamped value should report its write time");
+        }
+    }
+    std::cout << "Compaction filter test completed successfully!" << std::endl;
+}
+
+void testTrivialMove() {
+    std::cout << "\n--- Testing Trivial Move Compaction ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_trivial_move";
+    if (std::filesystem::exists(test_db_path)) {
+        std::filesystem::remove_all(test_db_path);
+    }
+    std::filesystem::create_directories(test_db_path);
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    auto keyOf = [](int i) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%05d", i);
+        return std::string(key);
+    };
+
+    // Sequential ingest: four level 0 tables with disjoint key ranges
+    kv::SSTableWriter writer(test_db_path);
+    for (uint64_t file = 1; file <= 4; file++) {
+        std::vector<kv::Entry> entries;
+        for (int i = static_cast<int>(file - 1) * 100; i < static_cast<int>(file) * 100; i++) {
+            entries.push_back(kv::Entry{keyOf(i), file, "old" + std::to_string(i)});
+        }
+        writer.writeSSTable(entries, file);
+    }
+
+    kv::Options options;
+    options.memtable_flush_threshold = 100;
+    {
+        kv::KVStore store(test_db_path, lock_mgr, options);
+        kv::Compactor compactor(test_db_path, 4, 4, lock_mgr);
+        compactor.setKVStore(&store);
+        compactor.start();
+        for (int i = 0; i < 500 && compactor.stats().compactions == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        compactor.stop();
+
+        // The same files, relisted at level 1 without writing a byte
+        kv::CompactionStats stats = compactor.stats();
+        if (stats.compactions != 1 || stats.trivial_moves != 1 || stats.bytes_written != 0 || stats.bytes_read != 0) {
+            throw std::runtime_error("ASSERT FAILED: disjoint inputs should be moved, not merged");
+        }
+        auto version = store.currentSSTableVersion();
+        if (version->levelTables(1).size() != 4 || !version->levelTables(0).empty()) {
+            throw std::runtime_error("ASSERT FAILED: moved tables should all be in level 1");
+        }
+        for (const auto& table : version->tables) {
+            if (table->meta().file_number > 4 || table->meta().min_key.empty()) {
+                throw std::runtime_error("ASSERT FAILED: moved tables should keep their file and key range");
+            }
+        }
+    }
+
+    // The move is in the MANIFEST; later overlapping writes are merged with the moved tables
+    {
+        kv::KVStore store(test_db_path, lock_mgr, options);
+        if (store.currentSSTableVersion()->levelTables(1).size() != 4 || store.get(keyOf(150)) != std::optional<std::string>("old150")) {
+            throw std::runtime_error("ASSERT FAILED: trivial move should survive a restart");
+        }
+        auto snapshot = store.getSnapshot();
+        auto it = store.newIterator(snapshot);
+        it->seekToFirst();
+
+        // Any level 0 table triggers, each one spans all moved tables
+        kv::Compactor compactor(test_db_path, 1, 4, lock_mgr);
+        compactor.setKVStore(&store);
+        compactor.start();
+        for (int i = 0; i < 400; i += 4) {
+            for (int j = 0; j < 4; j++) store.put(keyOf(j * 100 + i / 4), "new");
+        }
+        for (int i = 0; i < 500 && compactor.stats().compactions == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        compactor.stop();
+        kv::CompactionStats stats = compactor.stats();
+        if (stats.compactions == 0 || stats.trivial_moves != 0 || stats.bytes_written == 0) {
+            throw std::runtime_error("ASSERT FAILED: overlapping inputs should be merged");
+        }
+
+        // The iterator still reads the moved files through its pinned version
+        size_t seen = 0;
+        for (; it->valid(); it->next()) {
+            if (it->value().rfind("old", 0) != 0) {
+                throw std::runtime_error("ASSERT FAILED: pinned iterator should see the old values");
+            }
+            seen++;
+        }
+        if (seen != 400) {
+            throw std::runtime_error("ASSERT FAILED: pinned iterator should see 400 keys, got " + std::to_string(seen));
+        }
+        it.reset();
+        snapshot.reset();
+        if (store.get(keyOf(399)) != std::optional<std::string>("new")) {
+            throw std::runtime_error("ASSERT FAILED: merged value should be the new one");
+        }
+    }
+    // Replaced moved files were unlinked once nothing listed them
+    for (int file = 1; file <= 4; file++) {
+        if (std::filesystem::exists(test_db_path + "/" + kv::makeSSTableFileName(file))) {
+            throw std::runtime_error("ASSERT FAILED: merged away moved table " + std::to_string(file) + " should be deleted");
+        }
+    }
+    std::cout << "Trivial move test completed successfully!" << std::endl;
 }
 
-void testSSTableReader() {
-    std::cout << "\n--- Testing SSTable Reader (Both Read Cases) ---" << std::endl;
-    
-    std::string test_db_path = TEST_DIR + "/test_sstable_reader";
-    auto lock_mgr = std::make_shared<kv::LockManager>();
-    
-    // Clean up any existing test data
+void testReadSampling() {
+    std::cout << "\n--- Testing Read-Triggered Compaction ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_read_sampling";
     if (std::filesystem::exists(test_db_path)) {
         std::filesystem::remove_all(test_db_path);
     }
-    
-    // Phase 1: Create some SSTable files with known data (on-disk data)
-    std::cout << "\n1. Creating SSTable files with sample data..." << std::endl;
     std::filesystem::create_directories(test_db_path);
-    
+    auto lock_mgr = std::make_shared<kv::LockManager>();
+    auto keyOf = [](int i) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%05d", i);
+        return std::string(key);
+    };
+
+    // Two level 0 tables over the same range: the newer one holds the even
+    // keys, so every lookup of an odd key probes it in vain first
     kv::SSTableWriter writer(test_db_path);
-    
-    // Create first SSTable with some data
-    kv::MemTable temp_table1;
-    temp_table1.put("disk_key1", "disk_value1");
-    temp_table1.put("disk_key2", "disk_value2");
-    temp_table1.put("zebra", "last_alphabetical");
-    
-    // Convert MemTable to std::map for SSTableWriter
-    std::map<std::string, std::string> sorted_data1;
-    for (const auto& [key, value] : temp_table1.data()) {
-        sorted_data1[key] = value;
-    }
-    writer.writeSSTable(sorted_data1, 1);
-    
-    // Create second SSTable with different data
-    kv::MemTable temp_table2;
-    temp_table2.put("disk_key3", "disk_value3");
-    temp_table2.put("apple", "first_alphabetical");
-    temp_table2.put("disk_key1", "newer_disk_value1"); // This should override the first one
-    
-    // Convert MemTable to std::map for SSTableWriter
-    std::map<std::string, std::string> sorted_data2;
-    for (const auto& [key, value] : temp_table2.data()) {
-        sorted_data2[key] = value;
+    for (uint64_t file = 1; file <= 2; file++) {
+        std::vector<kv::Entry> entries;
+        for (int i = file == 1 ? 1 : 0; i < 400; i += 2) {
+            entries.push_back(kv::Entry{keyOf(i), file, "value" + std::to_string(i)});
+        }
+        writer.writeSSTable(entries, file);
     }
-    writer.writeSSTable(sorted_data2, 2);
-    
-    std::cout << "   Created 2 SSTable files with sample data" << std::endl;
-    
-    // Phase 2: Create KVStore and add some in-memory data
-    std::cout << "\n2. Creating KVStore and adding in-memory data..." << std::endl;
-    
+
     kv::KVStore store(test_db_path, lock_mgr);
-    
-    // Add some data that will stay in memory
-    store.put("memory_key1", "memory_value1");
-    store.put("memory_key2", "memory_value2");
-    store.put("disk_key1", "latest_memory_value1"); // This should override disk version
-    
-    std::cout << "   Added 3 keys to in-memory hash table" << std::endl;
-    
-    // Phase 3: Test different read scenarios
-    std::cout << "\n3. Testing read scenarios:" << std::endl;
-    
-    // Test Case 1: Read from in-memory hash table (should hit memory first)
-    std::cout << "\n   Test Case 1 - Reading keys that exist in memory:" << std::endl;
-    auto result1 = store.get("memory_key1");
-    auto result2 = store.get("memory_key2");
-    auto result3 = store.get("disk_key1"); // This exists in both, should get memory version
-    
-    std::cout << "   memory_key1: " << (result1 ? *result1 : "<not found>") << std::endl;
-    std::cout << "   memory_key2: " << (result2 ? *result2 : "<not found>") << std::endl;
-    std::cout << "   disk_key1 (should be memory version): " << (result3 ? *result3 : "<not found>") << std::endl;
-    
-    // Test Case 2: Read from on-disk SSTables (should fall through to disk)
-    std::cout << "\n   Test Case 2 - Reading keys that exist only on disk:" << std::endl;
-    auto result4 = store.get("disk_key2");
-    auto result5 = store.get("disk_key3");
-    auto result6 = store.get("apple");
-    auto result7 = store.get("zebra");
-    
-    std::cout << "   disk_key2 (from disk): " << (result4 ? *result4 : "<not found>") << std::endl;
-    std::cout << "   disk_key3 (from disk): " << (result5 ? *result5 : "<not found>") << std::endl;
-    std::cout << "   apple (from disk): " << (result6 ? *result6 : "<not found>") << std::endl;
-    std::cout << "   zebra (from disk): " << (result7 ? *result7 : "<not found>") << std::endl;
-    
-    // Test Case 3: Read non-existent keys (should not be found anywhere)
-    std::cout << "\n   Test Case 3 - Reading keys that don't exist:" << std::endl;
-    auto result8 = store.get("nonexistent_key");
-    auto result9 = store.get("missing_key");
-    
-    std::cout << "   nonexistent_key: " << (result8 ? *result8 : "<not found>") << std::endl;
-    std::cout << "   missing_key: " << (result9 ? *result9 : "<not found>") << std::endl;
-    
-    // Phase 4: Verify expected results with assertions
-    std::cout << "\n4. Verifying test results with assertions:" << std::endl;
-    
-    // Assert memory reads
-    if (!result1 || *result1 != "memory_value1") {
-        throw std::runtime_error("ASSERT FAILED: memory_key1 should return 'memory_value1'");
+    auto version = store.currentSSTableVersion();
+    auto newer = version->levelTables(0).front();
+    if (newer->meta().file_number != 2 || newer->meta().num_entries != 200 || newer->meta().num_deletions != 0) {
+        throw std::runtime_error("ASSERT FAILED: newest level 0 table should be file 2 with 200 live entries");
     }
-    
-    if (!result2 || *result2 != "memory_value2") {
-        throw std::runtime_error("ASSERT FAILED: memory_key2 should return 'memory_value2'");
-    }
-    
-    // Assert memory override of disk data
-    if (!result3 || *result3 != "latest_memory_value1") {
-        throw std::runtime_error("ASSERT FAILED: disk_key1 should return memory version 'latest_memory_value1'");
+    version.reset();
+
+    // Two tables stay below the level 0 trigger: only reads can start a compaction
+    kv::Compactor compactor(test_db_path, 4, 4, lock_mgr);
+    compactor.setKVStore(&store);
+    compactor.start();
+    for (int i = 1; i < 400 && !newer->seekBudgetExhausted(); i += 2) {
+        if (store.get(keyOf(i)) != std::optional<std::string>("value" + std::to_string(i))) {
+            throw std::runtime_error("ASSERT FAILED: odd key should be read from the older table");
+        }
     }
-    
-    // Assert disk reads
-    if (!result4 || *result4 != "disk_value2") {
-        throw std::runtime_error("ASSERT FAILED: disk_key2 should return 'disk_value2' from disk");
+    if (!newer->seekBudgetExhausted() || newer->seeksCharged() != newer->seekBudget()) {
+        throw std::runtime_error("ASSERT FAILED: missed lookups should use up the seek budget");
     }
-    
-    if (!result5 || *result5 != "disk_value3") {
-        throw std::runtime_error("ASSERT FAILED: disk_key3 should return 'disk_value3' from disk");
+    for (int i = 0; i < 500 && compactor.stats().compactions == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
-    
-    if (!result6 || *result6 != "first_alphabetical") {
-        throw std::runtime_error("ASSERT FAILED: apple should return 'first_alphabetical' from disk");
+    compactor.stop();
+
+    kv::CompactionStats stats = compactor.stats();
+    if (stats.compactions != 1 || stats.read_compactions != 1) {
+        throw std::runtime_error("ASSERT FAILED: exhausted seek budget should trigger one compaction");
     }
-    
-    if (!result7 || *result7 != "last_alphabetical") {
-        throw std::runtime_error("ASSERT FAILED: zebra should return 'last_alphabetical' from disk");
+    version = store.currentSSTableVersion();
+    if (!version->levelTables(0).empty() || version->levelTables(1).empty()) {
+        throw std::runtime_error("ASSERT FAILED: read-triggered compaction should empty level 0");
     }
-    
-    // Assert non-existent keys
-    if (result8 || result9) {
-        throw std::runtime_error("ASSERT FAILED: Non-existent keys should return nullopt");
+    for (int i = 0; i < 400; i += 57) {
+        if (store.get(keyOf(i)) != std::optional<std::string>("value" + std::to_string(i))) {
+            throw std::runtime_error("ASSERT FAILED: key " + keyOf(i) + " lost by read-triggered compaction");
+        }
     }
-    
-    std::cout << "\nSSTable Reader test completed successfully!" << std::endl;
+    std::cout << "Read-triggered compaction test completed successfully!" << std::endl;
 }
 
-void testDeleteTombstone() {
-    std::cout << "\n--- Testing Delete Tombstone Feature ---" << std::endl;
-    
-    std::string test_db_path = TEST_DIR + "/test_delete_db";
-    auto lock_mgr = std::make_shared<kv::LockManager>();
-    
+void testPartitionedStore() {
+    std::cout << "\n--- Testing Partitioned Store ---" << std::endl;
+    std::string test_db_path = TEST_DIR + "/test_partitioned_store";
     if (std::filesystem::exists(test_db_path)) {
         std::filesystem::remove_all(test_db_path);
     }
-    
-    // Setup: Create SSTable with initial data
-    std::filesystem::create_directories(test_db_path);
-    kv::SSTableWriter writer(test_db_path);
-    std::map<std::string, std::string> disk_data;
-    disk_data["disk_key"] = "disk_value";
-    writer.writeSSTable(disk_data, 1);
-    
-    // Test delete operations
-    kv::KVStore store(test_db_path, lock_mgr);
-    store.put("mem_key", "mem_value");
-    
-    // Assert initial state
-    auto mem_before = store.get("mem_key");
-    auto disk_before = store.get("disk_key");
-    if (!mem_before || *mem_before != "mem_value") {
-        throw std::runtime_error("ASSERT FAILED: mem_key should exist");
-    }
-    if (!disk_before || *disk_before != "disk_value") {
-        throw std::runtime_error("ASSERT FAILED: disk_key should exist");
-    }
-    
-    // Test deletions
-    store.del("mem_key");
-    store.del("disk_key");
-    store.del("nonexistent");  // Should not crash
-    
-    // Assert deletions worked
-    if (store.get("mem_key")) {
-        throw std::runtime_error("ASSERT FAILED: mem_key should be deleted");
+    auto keyOf = [](int i) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%05d", i);
+        return std::string(key);
+    };
+
+    // Hash partitions: four writer threads, every partition gets a share
+    kv::PartitionOptions options;
+    options.num_partitions = 4;
+    options.queue_capacity = 16;
+    options.store_options.memtable_flush_threshold = 200;
+    {
+        kv::PartitionedStore store(test_db_path, options);
+        std::vector<std::thread> writers;
+        for (int t = 0; t < 4; t++) {
+            writers.emplace_back([&store, &keyOf, t] {
+                for (int i = t; i < 2000; i += 4) store.put(keyOf(i), "value" + std::to_string(i));
+            });
+        }
+        for (auto& writer : writers) writer.join();
+        for (size_t p = 0; p < store.numPartitions(); p++) {
+            if (store.operationsExecuted(p) < 300) {
+                throw std::runtime_error("ASSERT FAILED: hash partitioning should spread the keys");
+            }
+        }
+        for (int i = 0; i < 2000; i += 7) {
+            if (store.get(keyOf(i)) != std::optional<std::string>("value" + std::to_string(i))) {
+                throw std::runtime_error("ASSERT FAILED: partitioned get of " + keyOf(i));
+            }
+            if (store.partition(store.partitionOf(keyOf(i))).get(keyOf(i)) != store.get(keyOf(i))) {
+                throw std::runtime_error("ASSERT FAILED: key should live in the partition it routes to");
+            }
+        }
+        store.del(keyOf(10));
+        store.deleteRange(keyOf(100), keyOf(200));
+        auto values = store.multiGet({keyOf(5), keyOf(10), keyOf(150), "missing", keyOf(1999)});
+        if (values[0] != std::optional<std::string>("value5") || values[1] || values[2] || values[3] ||
+            values[4] != std::optional<std::string>("value1999")) {
+            throw std::runtime_error("ASSERT FAILED: partitioned multiGet after deletes");
+        }
     }
-    if (store.get("disk_key")) {
-        throw std::runtime_error("ASSERT FAILED: disk_key should be deleted");
+
+    // Each partition recovers from its own directory
+    {
+        kv::PartitionedStore store(test_db_path, options);
+        if (store.get(keyOf(1234)) != std::optional<std::string>("value1234") || store.get(keyOf(150)) || store.get(keyOf(10))) {
+            throw std::runtime_error("ASSERT FAILED: partitioned store should survive a reopen");
+        }
     }
-    if (store.get("nonexistent")) {
-        throw std::runtime_error("ASSERT FAILED: nonexistent should remain not found");
+    std::filesystem::remove_all(test_db_path);
+
+    // Range partitions: a range deletion only visits the partitions it spans
+    kv::PartitionOptions range_options;
+    range_options.num_partitions = 3;
+    range_options.partitioning = kv::Partitioning::Range;
+    range_options.split_keys = {"g", "n"};
+    {
+        kv::PartitionedStore store(test_db_path, range_options);
+        if (store.partitionOf("apple") != 0 || store.partitionOf("g") != 1 || store.partitionOf("zebra") != 2) {
+            throw std::runtime_error("ASSERT FAILED: range partition routing");
+        }
+        for (const char* key : {"apple", "fig", "grape", "kiwi", "nut", "pear"}) store.put(key, key);
+        uint64_t last_before = store.operationsExecuted(2);
+        store.deleteRange("b", "h");
+        if (store.operationsExecuted(2) != last_before || store.operationsExecuted(0) != 3 ||
+            store.operationsExecuted(1) != 3) {
+            throw std::runtime_error("ASSERT FAILED: range deletion should reach partitions 0 and 1 only");
+        }
+        auto values = store.multiGet({"apple", "fig", "grape", "kiwi", "nut"});
+        if (values[0] != std::optional<std::string>("apple") || values[1] || values[2] ||
+            values[3] != std::optional<std::string>("kiwi") || values[4] != std::optional<std::string>("nut")) {
+            throw std::runtime_error("ASSERT FAILED: range deletion across partitions");
+        }
     }
-    
-    // Test delete then restore
-    store.put("restore_test", "original");
-    store.del("restore_test");
-    if (store.get("restore_test")) {
-        throw std::runtime_error("ASSERT FAILED: restore_test should be deleted");
+
+    bool rejected = false;
+    try {
+        range_options.split_keys = {"n", "g"};
+        kv::PartitionedStore store(test_db_path, range_options);
+    } catch (const std::invalid_argument&) {
+        rejected = true;
     }
-    
-    store.put("restore_test", "restored");
-    auto restored = store.get("restore_test");
-    if (!restored || *restored != "restored") {
-        throw std::runtime_error("ASSERT FAILED: restore_test should be restored");
+    if (!rejected) {
+        throw std::runtime_error("ASSERT FAILED: unordered split keys should be rejected");
     }
-    
-    std::cout << "Delete tombstone test passed!" << std::endl;
+    std::cout << "Partitioned store test completed successfully!" << std::endl;
 }
 
 void testCompactorFileDiscovery() {
@@ -658,6 +2723,151 @@ void testCompactorWorkflowAndInteractions() {
     std::cout << "✅ Data integrity preserved" << std::endl;
 }
 
+void testKeyIndex() {
+    std::cout << "\n--- Testing KeyIndex ---" << std::endl;
+    std::cout << "   Search kernel: " << kv::searchKernelName(kv::detectSearchKernel()) << std::endl;
+
+    // Index keys that share a long prefix so fingerprints start after it
+    kv::KeyIndex index;
+    for (int i = 0; i < 100; ++i) {
+        char key[32];
+        std::snprintf(key, sizeof(key), "user:%08d", i * 10);
+        index.add(key, static_cast<uint64_t>(i) * 100);
+    }
+    index.finish(10000);
+
+    // Every kernel must agree with the scalar count
+    std::vector<uint64_t> fps = {1, 3, 3, 5, 7, 9, 11, 13, 15, UINT64_MAX};
+    for (uint64_t target : {0ULL, 3ULL, 4ULL, 15ULL, 16ULL}) {
+        size_t expected = kv::countLessThan(fps.data(), fps.size(), target, kv::SearchKernel::Scalar);
+        if (kv::countLessThan(fps.data(), fps.size(), target, kv::detectSearchKernel()) != expected) {
+            throw std::runtime_error("ASSERT FAILED: SIMD kernel disagrees with scalar count");
+        }
+    }
+
+    auto exact = index.findBlock("user:00000500");
+    auto inside = index.findBlock("user:00000505");
+    auto last = index.findBlock("user:99999999");
+    auto before = index.findBlock("user:");
+    auto other_prefix = index.findBlock("apple");
+
+    if (!exact || exact->first != 5000 || exact->second != 5100) {
+        throw std::runtime_error("ASSERT FAILED: indexed key should map to its own block");
+    }
+    if (!inside || inside->first != 5000) {
+        throw std::runtime_error("ASSERT FAILED: key between indexed keys should map to the preceding block");
+    }
+    if (!last || last->first != 9900 || last->second != 10000) {
+        throw std::runtime_error("ASSERT FAILED: key past the last indexed key should map to the last block");
+    }
+    if (before || other_prefix) {
+        throw std::runtime_error("ASSERT FAILED: keys before the first key should have no block");
+    }
+
+    std::cout << "KeyIndex test completed successfully." << std::endl;
+}
+
+void testIoBackend() {
+    std::cout << "\n--- Testing IoBackend ---" << std::endl;
+
+    // 64 KiB file where byte i is (i % 251)
+    std::string path = TEST_DIR + "/test_io_backend.bin";
+    std::string content(64 * 1024, '\0');
+    for (size_t i = 0; i < content.size(); ++i) content[i] = static_cast<char>(i % 251);
+    {
+        std::ofstream out(path, std::ios::trunc | std::ios::binary);
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("ASSERT FAILED: cannot open io backend test file");
+    }
+
+    for (auto io : {kv::IoBackend::create(), kv::IoBackend::createPread()}) {
+        std::cout << "   Backend: " << io->name() << std::endl;
+        // More reads than the default queue depth, plus one past EOF
+        std::vector<kv::ReadRequest> batch;
+        for (uint64_t off = 0; off + 512 <= content.size(); off += 500) {
+            batch.push_back(kv::ReadRequest{fd, off, 512, {}, false});
+        }
+        batch.push_back(kv::ReadRequest{fd, content.size() - 10, 100, {}, false});
+        io->readBatch(batch);
+
+        for (size_t i = 0; i + 1 < batch.size(); ++i) {
+            if (!batch[i].ok || batch[i].data != content.substr(batch[i].offset, 512)) {
+                throw std::runtime_error(std::string("ASSERT FAILED: ") + io->name() + " returned wrong block data");
+            }
+        }
+        if (batch.back().ok) {
+            throw std::runtime_error(std::string("ASSERT FAILED: ") + io->name() + " should fail reads past EOF");
+        }
+
+        // Batches from several threads at once, each sees its own data
+        std::atomic<int> wrong{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&, t] {
+                for (int round = 0; round < 50; round++) {
+                    std::vector<kv::ReadRequest> own;
+                    for (uint64_t off = static_cast<uint64_t>(t) * 1000; off + 256 <= content.size(); off += 4096) {
+                        own.push_back(kv::ReadRequest{fd, off, 256, {}, false});
+                    }
+                    io->readBatch(own);
+                    for (const auto& request : own) {
+                        if (!request.ok || request.data != content.substr(request.offset, 256)) wrong.fetch_add(1);
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        if (wrong.load() != 0) {
+            throw std::runtime_error(std::string("ASSERT FAILED: ") + io->name() + " mixed up concurrent batches");
+        }
+    }
+    ::close(fd);
+
+    std::cout << "IoBackend test completed successfully." << std::endl;
+}
+
+void testIntervalIndex() {
+    std::cout << "\n--- Testing IntervalIndex ---" << std::endl;
+
+    // Random overlapping ranges over "k00".."k99", checked against a linear scan
+    std::mt19937 rng(7);
+    auto key_of = [](int i) {
+        char key[8];
+        std::snprintf(key, sizeof(key), "k%02d", i);
+        return std::string(key);
+    };
+    std::vector<kv::IntervalIndex::Interval> ranges;
+    for (size_t id = 0; id < 300; ++id) {
+        int low = static_cast<int>(rng() % 100);
+        int high = std::min(99, low + static_cast<int>(rng() % 20));
+        ranges.push_back(kv::IntervalIndex::Interval{key_of(low), key_of(high), id});
+    }
+    kv::IntervalIndex index;
+    index.build(ranges);
+
+    for (int i = 0; i < 100; ++i) {
+        std::string key = key_of(i);
+        for (const std::string& probe : {key, key + "5"}) {
+            std::vector<size_t> expected;
+            for (const auto& range : ranges) {
+                if (probe >= range.low && probe <= range.high) expected.push_back(range.id);
+            }
+            if (index.find(probe) != expected) {
+                throw std::runtime_error("ASSERT FAILED: IntervalIndex disagrees with linear scan for " + probe);
+            }
+        }
+    }
+    if (!index.find("a").empty() || !index.find("z").empty()) {
+        throw std::runtime_error("ASSERT FAILED: keys outside every range should have no candidates");
+    }
+
+    std::cout << "IntervalIndex test completed successfully." << std::endl;
+}
+
 int main() {
     setupTestDir();
     
@@ -665,10 +2875,37 @@ int main() {
         testFileHandle();
         testLogWriter();
         testMemTable();
+        testKeyIndex();
+        testIoBackend();
+        testIntervalIndex();
         testWALReplay();
         testFlusher();
         testSSTableReader();
         testDeleteTombstone();
+        testRangeIterator();
+        testMultiGet();
+        testVersionPinning();
+        testManifestRecovery();
+        testSnapshots();
+        testConcurrentOverwriteReads();
+        testRowCache();
+        testEventDrivenFlush();
+        testParallelFlush();
+        testFlushPipeline();
+        testFlushRetry();
+        testStreamingCompaction();
+        testLoserTreeMerge();
+        testLeveledCompaction();
+        testCompactionPickers();
+        testSubcompactions();
+        testRateLimiter();
+        testCompactionInstallLock();
+        testLockStats();
+        testRangeDeletion();
+        testCompactionFilter();
+        testTrivialMove();
+        testReadSampling();
+        testPartitionedStore();
         testCompactorFileDiscovery();
         testCompactorThreadLifecycle();
         testCompactorWorkflowAndInteractions();
@@ -2,14 +2,34 @@
 #include <iostream>
 #include <unordered_map>
 #include <optional>
+#include <algorithm>
+#include <thread>
 
 namespace kv {
 
 MemTable::MemTable() = default;
 
 void
-MemTable::put(const std::string& key, const std::string& value) {
-    _map[key] = value;
+MemTable::put(const std::string& key, const std::string& value, SequenceNumber seq, SequenceNumber oldest_snapshot) {
+    auto& versions = _map[key];
+    // Same sequence (e.g. unversioned puts) simply overwrites
+    if (!versions.empty() && versions.back().seq == seq) {
+        versions.back().value = value;
+        return;
+    }
+    versions.push_back(VersionedValue{seq, value});
+
+    // Every snapshot sees the newest version at or below it; older ones are dead
+    size_t keep_from = 0;
+    for (size_t i = versions.size() - 1; i > 0; --i) {
+        if (versions[i].seq <= oldest_snapshot) {
+            keep_from = i;
+            break;
+        }
+    }
+    if (keep_from > 0) {
+        versions.erase(versions.begin(), versions.begin() + static_cast<std::ptrdiff_t>(keep_from));
+    }
 }
 
 // An optional means "there may or may not be a value" without resorting to 
@@ -20,16 +40,130 @@ MemTable::get(const std::string& key) const {
     if (pair == _map.end()) {
         return std::nullopt;
     }
-    return pair->second;
+    return pair->second.back().value;
+}
+
+std::optional<std::string>
+MemTable::get(const std::string& key, SequenceNumber snapshot, SequenceNumber* found_seq) const {
+    auto pair = _map.find(key);
+    if (pair == _map.end()) {
+        return std::nullopt;
+    }
+    const auto& versions = pair->second;
+    for (auto it = versions.rbegin(); it != versions.rend(); ++it) {
+        if (it->seq <= snapshot) {
+            if (found_seq) *found_seq = it->seq;
+            return it->value;
+        }
+    }
+    return std::nullopt;
+}
+
+void MemTable::deleteRange(const std::string& begin, const std::string& end, SequenceNumber seq) {
+    _range_tombstones.push_back(RangeTombstone{begin, end, seq});
+}
+
+SequenceNumber MemTable::rangeTombstoneSeq(const std::string& key, SequenceNumber snapshot) const {
+    SequenceNumber newest = 0;
+    for (const auto& tombstone : _range_tombstones) {
+        if (tombstone.seq <= snapshot && tombstone.covers(key)) newest = std::max(newest, tombstone.seq);
+    }
+    return newest;
+}
+
+const std::vector<RangeTombstone>& MemTable::rangeTombstones() const {
+    return _range_tombstones;
 }
 
 size_t MemTable::size() const {
-    return _map.size();
+    return _map.size() + _range_tombstones.size();
 }
 
-const std::unordered_map<std::string, std::string>&
-MemTable::data() const {
-    return _map;
+std::vector<Entry>
+MemTable::entries() const {
+    std::vector<Entry> out;
+    out.reserve(_map.size());
+    for (const auto& [key, versions] : _map) {
+        for (auto it = versions.rbegin(); it != versions.rend(); ++it) {
+            out.push_back(Entry{key, it->seq, it->value});
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const Entry& a, const Entry& b) {
+        return a.key != b.key ? a.key < b.key : a.seq > b.seq;
+    });
+    return out;
+}
+
+std::vector<Entry>
+MemTable::visibleEntries(SequenceNumber snapshot) const {
+    std::vector<Entry> out;
+    out.reserve(_map.size());
+    for (const auto& [key, versions] : _map) {
+        for (auto it = versions.rbegin(); it != versions.rend(); ++it) {
+            if (it->seq <= snapshot) {
+                out.push_back(Entry{key, it->seq, it->value});
+                break;
+            }
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+    return out;
 }
 
-}
\ No newline at end of file
+// Below this many keys per thread, starting threads costs more than it saves
+static constexpr size_t kMinKeysPerSortThread = 4096;
+
+std::vector<EntryRef>
+MemTable::sortedRefs(size_t threads) const {
+    using Slot = const std::pair<const std::string, std::vector<VersionedValue>>*;
+    std::vector<Slot> slots;
+    slots.reserve(_map.size());
+    for (const auto& slot : _map) {
+        slots.push_back(&slot);
+    }
+    auto by_key = [](Slot a, Slot b) { return a->first < b->first; };
+
+    // Sort equal chunks in parallel, then merge neighbouring runs pairwise
+    size_t chunks = std::max<size_t>(1, std::min(threads, slots.size() / kMinKeysPerSortThread));
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= chunks; i++) {
+        bounds.push_back(slots.size() * i / chunks);
+    }
+    auto sortRange = [&](size_t lo, size_t hi) {
+        std::sort(slots.begin() + static_cast<std::ptrdiff_t>(lo), slots.begin() + static_cast<std::ptrdiff_t>(hi), by_key);
+    };
+    std::vector<std::thread> sorters;
+    for (size_t i = 1; i < chunks; i++) {
+        sorters.emplace_back(sortRange, bounds[i], bounds[i + 1]);
+    }
+    sortRange(bounds[0], bounds[1]);
+    for (auto& sorter : sorters) sorter.join();
+
+    while (bounds.size() > 2) {
+        std::vector<size_t> merged {0};
+        std::vector<std::thread> mergers;
+        for (size_t i = 0; i + 2 < bounds.size(); i += 2) {
+            auto first = slots.begin() + static_cast<std::ptrdiff_t>(bounds[i]);
+            auto middle = slots.begin() + static_cast<std::ptrdiff_t>(bounds[i + 1]);
+            auto last = slots.begin() + static_cast<std::ptrdiff_t>(bounds[i + 2]);
+            mergers.emplace_back([=] { std::inplace_merge(first, middle, last, by_key); });
+            merged.push_back(bounds[i + 2]);
+        }
+        if (bounds.size() % 2 == 0) {
+            merged.push_back(bounds.back()); // Odd run out, merged next round
+        }
+        for (auto& merger : mergers) merger.join();
+        bounds = std::move(merged);
+    }
+
+    std::vector<EntryRef> out;
+    out.reserve(slots.size());
+    for (Slot slot : slots) {
+        for (auto it = slot->second.rbegin(); it != slot->second.rend(); ++it) {
+            out.push_back(EntryRef{&slot->first, it->seq, &it->value});
+        }
+    }
+    return out;
+}
+
+}
@@ -0,0 +1,352 @@
+#include "kv/partitioned_store.hpp"
+#include "kv/kv_store.hpp"
+#include "kv/compactor.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace kv {
+
+struct PartitionedStore::Request {
+    enum class Kind { Put, Del, Get, MultiGet, DeleteRange, Stop };
+
+    Kind kind;
+    std::string key;                      // Begin of a DeleteRange
+    std::string value;                    // End of a DeleteRange
+    std::vector<std::string> keys;        // MultiGet
+    std::promise<std::vector<std::optional<std::string>>> done; // One result for Get, one per key for MultiGet
+};
+
+// Bounded multi-producer queue after Dmitry Vyukov: every slot carries a
+// sequence number telling producers and the consumer whose turn it is, so a
+// push or pop is one compare-and-swap on the position plus a release store
+class PartitionedStore::RequestQueue {
+public:
+    explicit RequestQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        _slots = std::vector<Slot>(size);
+        _mask = size - 1;
+        for (size_t i = 0; i < size; ++i) _slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    // False if the queue is full
+    bool tryPush(Request* request) {
+        size_t pos = _tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = _slots[pos & _mask];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.request = request;
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // nullptr if the queue is empty; single consumer
+    Request* tryPop() {
+        size_t pos = _head.load(std::memory_order_relaxed);
+        Slot& slot = _slots[pos & _mask];
+        size_t seq = slot.seq.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) return nullptr;
+        _head.store(pos + 1, std::memory_order_relaxed);
+        Request* request = slot.request;
+        slot.seq.store(pos + _mask + 1, std::memory_order_release);
+        return request;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> seq{0};
+        Request* request = nullptr;
+    };
+
+    std::vector<Slot> _slots;
+    size_t _mask = 0;
+    alignas(64) std::atomic<size_t> _tail{0};
+    alignas(64) std::atomic<size_t> _head{0};
+};
+
+struct PartitionedStore::Partition {
+    std::shared_ptr<LockManager> lock_mgr;
+    std::unique_ptr<KVStore> store;
+    std::unique_ptr<Compactor> compactor;
+    std::unique_ptr<RequestQueue> queue;
+    std::thread worker;
+    std::atomic<uint64_t> executed{0};
+
+    // An idle worker sleeps here; producers only take the mutex when it does
+    std::atomic<bool> sleeping{false};
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+};
+
+namespace {
+
+// FNV-1a: the routing must not change between runs or builds
+uint64_t partitionHash(const std::string& key) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string partitionDir(const std::string& db_path, size_t partition) {
+    char name[16];
+    std::snprintf(name, sizeof(name), "part-%03zu", partition);
+    return db_path + "/" + name;
+}
+
+void pinToCore(std::thread& thread, size_t partition) {
+#ifdef __linux__
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(partition % cores, &set);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) != 0) {
+        std::cerr << "ERROR: Cannot pin partition " << partition << " to core " << partition % cores << std::endl;
+    }
+#else
+    (void)thread;
+    (void)partition;
+#endif
+}
+
+} // namespace
+
+PartitionedStore::PartitionedStore(const std::string& db_path, const PartitionOptions& options)
+    : _options(options)
+{
+    if (_options.num_partitions == 0) {
+        throw std::invalid_argument("PartitionedStore needs at least one partition");
+    }
+    if (_options.partitioning == Partitioning::Range &&
+        (_options.split_keys.size() + 1 != _options.num_partitions ||
+         std::adjacent_find(_options.split_keys.begin(), _options.split_keys.end(),
+                            std::greater_equal<std::string>()) != _options.split_keys.end())) {
+        throw std::invalid_argument("Range partitioning needs num_partitions - 1 ascending split keys");
+    }
+
+    for (size_t i = 0; i < _options.num_partitions; ++i) {
+        auto partition = std::make_unique<Partition>();
+        std::string dir = partitionDir(db_path, i);
+        partition->lock_mgr = std::make_shared<LockManager>();
+        partition->store = std::make_unique<KVStore>(dir, partition->lock_mgr, _options.store_options);
+        partition->compactor = std::make_unique<Compactor>(dir, _options.compaction_trigger, _options.compaction_trigger,
+                                                           partition->lock_mgr, _options.compaction_options);
+        partition->compactor->setKVStore(partition->store.get());
+        partition->compactor->start();
+        partition->queue = std::make_unique<RequestQueue>(_options.queue_capacity);
+        _partitions.push_back(std::move(partition));
+    }
+    for (size_t i = 0; i < _partitions.size(); ++i) {
+        Partition& partition = *_partitions[i];
+        partition.worker = std::thread([this, &partition, i] { runWorker(partition, i); });
+        if (_options.pin_threads) pinToCore(partition.worker, i);
+    }
+    std::cout << "DEBUG: PartitionedStore opened " << _partitions.size() << " "
+              << (_options.partitioning == Partitioning::Hash ? "hash" : "range")
+              << " partitions in " << db_path << std::endl;
+}
+
+// Stop requests queue behind everything submitted before, so nothing is dropped
+PartitionedStore::~PartitionedStore() {
+    for (size_t i = 0; i < _partitions.size(); ++i) {
+        auto request = std::make_unique<Request>();
+        request->kind = Request::Kind::Stop;
+        submit(i, std::move(request));
+    }
+    for (auto& partition : _partitions) {
+        partition->worker.join();
+        partition->compactor->stop();
+    }
+    std::cout << "DEBUG: PartitionedStore closed" << std::endl;
+}
+
+void PartitionedStore::submit(size_t partition, std::unique_ptr<Request> request) {
+    Partition& target = *_partitions[partition];
+    Request* raw = request.release();
+    while (!target.queue->tryPush(raw)) {
+        std::this_thread::yield();
+    }
+    // Pairs with the fence between the worker's store of sleeping and its last look at the queue
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (target.sleeping.load()) {
+        std::lock_guard<std::mutex> lock(target.wake_mutex);
+        target.wake_cv.notify_one();
+    }
+}
+
+void PartitionedStore::runWorker(Partition& partition, size_t index) {
+    constexpr int kSpins = 1000;
+    int idle = 0;
+    while (true) {
+        std::unique_ptr<Request> request(partition.queue->tryPop());
+        if (!request) {
+            if (++idle < kSpins) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(partition.wake_mutex);
+            partition.sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            request.reset(partition.queue->tryPop());
+            if (!request) {
+                // A producer that pushed after the look above sees sleeping and
+                // notifies under wake_mutex, which is held until wait() releases it
+                partition.wake_cv.wait(lock);
+                partition.sleeping.store(false);
+                continue;
+            }
+            partition.sleeping.store(false);
+        }
+        idle = 0;
+
+        KVStore& store = *partition.store;
+        std::vector<std::optional<std::string>> results;
+        try {
+            switch (request->kind) {
+                case Request::Kind::Put:
+                    store.put(request->key, request->value);
+                    break;
+                case Request::Kind::Del:
+                    store.del(request->key);
+                    break;
+                case Request::Kind::Get:
+                    results.push_back(store.get(request->key));
+                    break;
+                case Request::Kind::MultiGet:
+                    results = store.multiGet(request->keys);
+                    break;
+                case Request::Kind::DeleteRange:
+                    store.deleteRange(request->key, request->value);
+                    break;
+                case Request::Kind::Stop:
+                    request->done.set_value({});
+                    std::cout << "DEBUG: Partition " << index << " worker exiting after "
+                              << partition.executed.load() << " operations" << std::endl;
+                    return;
+            }
+            partition.executed.fetch_add(1);
+            request->done.set_value(std::move(results));
+        } catch (...) {
+            request->done.set_exception(std::current_exception());
+        }
+    }
+}
+
+void PartitionedStore::put(const std::string& key, const std::string& value) {
+    auto request = std::make_unique<Request>();
+    request->kind = Request::Kind::Put;
+    request->key = key;
+    request->value = value;
+    auto done = request->done.get_future();
+    submit(partitionOf(key), std::move(request));
+    done.get();
+}
+
+void PartitionedStore::del(const std::string& key) {
+    auto request = std::make_unique<Request>();
+    request->kind = Request::Kind::Del;
+    request->key = key;
+    auto done = request->done.get_future();
+    submit(partitionOf(key), std::move(request));
+    done.get();
+}
+
+std::optional<std::string> PartitionedStore::get(const std::string& key) {
+    auto request = std::make_unique<Request>();
+    request->kind = Request::Kind::Get;
+    request->key = key;
+    auto done = request->done.get_future();
+    submit(partitionOf(key), std::move(request));
+    return done.get().front();
+}
+
+std::vector<std::optional<std::string>> PartitionedStore::multiGet(const std::vector<std::string>& keys) {
+    // Positions of each partition's keys in the result
+    std::vector<std::vector<size_t>> positions(_partitions.size());
+    for (size_t i = 0; i < keys.size(); ++i) positions[partitionOf(keys[i])].push_back(i);
+
+    std::vector<std::pair<size_t, std::future<std::vector<std::optional<std::string>>>>> pending;
+    for (size_t p = 0; p < _partitions.size(); ++p) {
+        if (positions[p].empty()) continue;
+        auto request = std::make_unique<Request>();
+        request->kind = Request::Kind::MultiGet;
+        for (size_t i : positions[p]) request->keys.push_back(keys[i]);
+        pending.emplace_back(p, request->done.get_future());
+        submit(p, std::move(request));
+    }
+
+    std::vector<std::optional<std::string>> results(keys.size());
+    for (auto& [p, done] : pending) {
+        auto values = done.get();
+        for (size_t i = 0; i < values.size(); ++i) results[positions[p][i]] = std::move(values[i]);
+    }
+    return results;
+}
+
+void PartitionedStore::deleteRange(const std::string& begin, const std::string& end) {
+    if (begin >= end) {
+        return;
+    }
+    // Hash partitions may hold any key of the range; range partitions only those they overlap
+    size_t first = 0, last = _partitions.size() - 1;
+    if (_options.partitioning == Partitioning::Range) {
+        first = partitionOf(begin);
+        last = static_cast<size_t>(std::lower_bound(_options.split_keys.begin(), _options.split_keys.end(), end) -
+                                   _options.split_keys.begin());
+    }
+    std::vector<std::future<std::vector<std::optional<std::string>>>> pending;
+    for (size_t p = first; p <= last; ++p) {
+        auto request = std::make_unique<Request>();
+        request->kind = Request::Kind::DeleteRange;
+        request->key = begin;
+        request->value = end;
+        pending.push_back(request->done.get_future());
+        submit(p, std::move(request));
+    }
+    for (auto& done : pending) done.get();
+}
+
+size_t PartitionedStore::numPartitions() const {
+    return _partitions.size();
+}
+
+size_t PartitionedStore::partitionOf(const std::string& key) const {
+    if (_options.partitioning == Partitioning::Hash) {
+        return static_cast<size_t>(partitionHash(key) % _partitions.size());
+    }
+    return static_cast<size_t>(std::upper_bound(_options.split_keys.begin(), _options.split_keys.end(), key) -
+                               _options.split_keys.begin());
+}
+
+uint64_t PartitionedStore::operationsExecuted(size_t partition) const {
+    return _partitions.at(partition)->executed.load();
+}
+
+KVStore& PartitionedStore::partition(size_t partition) {
+    return *_partitions.at(partition)->store;
+}
+
+} // namespace kv
@@ -0,0 +1,78 @@
+#include "kv/range_tombstone.hpp"
+#include <algorithm>
+#include <functional>
+#include <set>
+
+namespace kv {
+
+// Sweep the sorted begin/end points; between two neighbouring points the set of
+// covering tombstones does not change, so each stretch becomes one fragment
+FragmentedRangeTombstones::FragmentedRangeTombstones(const std::vector<RangeTombstone>& tombstones) {
+    std::vector<std::string> points;
+    for (const auto& tombstone : tombstones) {
+        if (tombstone.begin >= tombstone.end) continue;
+        points.push_back(tombstone.begin);
+        points.push_back(tombstone.end);
+    }
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+
+    std::vector<const RangeTombstone*> by_begin, by_end;
+    for (const auto& tombstone : tombstones) {
+        if (tombstone.begin >= tombstone.end) continue;
+        by_begin.push_back(&tombstone);
+        by_end.push_back(&tombstone);
+    }
+    std::sort(by_begin.begin(), by_begin.end(), [](auto a, auto b) { return a->begin < b->begin; });
+    std::sort(by_end.begin(), by_end.end(), [](auto a, auto b) { return a->end < b->end; });
+
+    std::multiset<SequenceNumber, std::greater<SequenceNumber>> active;
+    size_t next_begin = 0, next_end = 0;
+    for (size_t i = 0; i + 1 < points.size(); ++i) {
+        while (next_end < by_end.size() && by_end[next_end]->end == points[i]) {
+            active.erase(active.find(by_end[next_end++]->seq));
+        }
+        while (next_begin < by_begin.size() && by_begin[next_begin]->begin == points[i]) {
+            active.insert(by_begin[next_begin++]->seq);
+        }
+        if (!active.empty()) {
+            _fragments.push_back(Fragment{points[i], points[i + 1], {active.begin(), active.end()}});
+        }
+    }
+}
+
+bool FragmentedRangeTombstones::empty() const {
+    return _fragments.empty();
+}
+
+const FragmentedRangeTombstones::Fragment* FragmentedRangeTombstones::find(const std::string& key) const {
+    auto it = std::upper_bound(_fragments.begin(), _fragments.end(), key,
+                               [](const std::string& k, const Fragment& fragment) { return k < fragment.begin; });
+    if (it == _fragments.begin()) return nullptr;
+    --it;
+    return key < it->end ? &*it : nullptr;
+}
+
+SequenceNumber FragmentedRangeTombstones::coveringSeq(const std::string& key, SequenceNumber snapshot) const {
+    const Fragment* fragment = find(key);
+    if (!fragment) return 0;
+    for (SequenceNumber seq : fragment->seqs) {
+        if (seq <= snapshot) return seq;
+    }
+    return 0;
+}
+
+bool FragmentedRangeTombstones::deletes(const std::string& key, SequenceNumber seq,
+                                        const std::vector<SequenceNumber>& snapshots) const {
+    const Fragment* fragment = find(key);
+    if (!fragment) return false;
+    // The oldest tombstone newer than the version is the first any reader could see
+    auto newer = std::find_if(fragment->seqs.rbegin(), fragment->seqs.rend(),
+                              [seq](SequenceNumber tombstone) { return tombstone > seq; });
+    if (newer == fragment->seqs.rend()) return false;
+    // Same snapshot stripe as in retainVisible(): whoever sees the version sees the tombstone too
+    auto stripe = [&](SequenceNumber s) { return std::lower_bound(snapshots.begin(), snapshots.end(), s); };
+    return stripe(seq) == stripe(*newer);
+}
+
+} // namespace kv
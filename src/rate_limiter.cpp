@@ -0,0 +1,144 @@
+#include "kv/rate_limiter.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace kv {
+
+RateLimiter::RateLimiter(uint64_t bytes_per_sec, bool throttle_reads)
+    : _max_bytes_per_sec(std::max<uint64_t>(bytes_per_sec, 1)),
+      _bytes_per_sec(_max_bytes_per_sec),
+      _throttle_reads(throttle_reads),
+      _available(0),
+      _last_refill(Clock::now()),
+      _high_waiting(0),
+      _total_bytes{{0}, {0}},
+      _auto_tune(false),
+      _target_latency(0),
+      _min_bytes_per_sec(0),
+      _last_tune(Clock::now()),
+      _latency_sum_us(0),
+      _latency_count(0)
+{
+    _available = static_cast<double>(burstBytes());
+}
+
+uint64_t RateLimiter::burstBytes() const {
+    return std::max<uint64_t>(1, _bytes_per_sec.load() * kRefillPeriod.count() / 1000000);
+}
+
+void RateLimiter::refill(Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - _last_refill).count();
+    _last_refill = now;
+    _available = std::min(_available + elapsed * static_cast<double>(_bytes_per_sec.load()),
+                          static_cast<double>(burstBytes()));
+}
+
+void RateLimiter::request(uint64_t bytes, IoPriority priority) {
+    _total_bytes[static_cast<int>(priority)].fetch_add(bytes);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    bool high = priority == IoPriority::High;
+    while (bytes > 0) {
+        // Bigger than the bucket can ever hold: take it piece by piece
+        uint64_t piece = std::min(bytes, burstBytes());
+        if (high) _high_waiting++;
+        while (true) {
+            auto now = Clock::now();
+            refill(now);
+            tune(now);
+            bool turn = high || _high_waiting == 0;
+            if (turn && _available >= static_cast<double>(piece)) {
+                _available -= static_cast<double>(piece);
+                break;
+            }
+            // Sleep about until the bucket has enough, a flush arriving wakes low priority sleepers anyway
+            double deficit = std::max(0.0, static_cast<double>(piece) - _available);
+            auto wait = std::chrono::microseconds(static_cast<int64_t>(deficit * 1e6 / static_cast<double>(_bytes_per_sec.load())));
+            _cv.wait_for(lock, std::clamp(wait, std::chrono::microseconds(1000), kRefillPeriod));
+        }
+        if (high) {
+            _high_waiting--;
+            if (_high_waiting == 0) _cv.notify_all();
+        }
+        bytes -= piece;
+    }
+}
+
+void RateLimiter::setBytesPerSecond(uint64_t bytes_per_sec) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    refill(Clock::now());
+    _max_bytes_per_sec = std::max<uint64_t>(bytes_per_sec, 1);
+    if (_auto_tune.load()) {
+        // Keep the tuned rate, inside the new bounds
+        _min_bytes_per_sec = std::min(_min_bytes_per_sec, _max_bytes_per_sec);
+        _bytes_per_sec.store(std::clamp(_bytes_per_sec.load(), _min_bytes_per_sec, _max_bytes_per_sec));
+    } else {
+        _bytes_per_sec.store(_max_bytes_per_sec);
+    }
+    _cv.notify_all();
+}
+
+uint64_t RateLimiter::bytesPerSecond() const {
+    return _bytes_per_sec.load();
+}
+
+bool RateLimiter::throttlesReads() const {
+    return _throttle_reads;
+}
+
+void RateLimiter::enableAutoTune(std::chrono::microseconds target, uint64_t min_bytes_per_sec) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _target_latency = target;
+    _min_bytes_per_sec = std::clamp<uint64_t>(min_bytes_per_sec, 1, _max_bytes_per_sec);
+    _last_tune.store(Clock::now());
+    _latency_sum_us.store(0);
+    _latency_count.store(0);
+    _auto_tune.store(true);
+}
+
+bool RateLimiter::autoTuning() const {
+    return _auto_tune.load();
+}
+
+void RateLimiter::recordForegroundLatency(std::chrono::microseconds latency) {
+    if (!_auto_tune.load()) return;
+    uint64_t latency_us = static_cast<uint64_t>(std::max<int64_t>(0, latency.count()));
+    _latency_sum_us.fetch_add(latency_us, std::memory_order_relaxed);
+    _latency_count.fetch_add(1, std::memory_order_relaxed);
+
+    auto now = Clock::now();
+    if (now - _last_tune.load(std::memory_order_relaxed) < kTuneInterval) return;
+    // A holder of the mutex is a background request, it tunes on its own
+    std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+    if (lock.owns_lock()) tune(now);
+}
+
+void RateLimiter::tune(Clock::time_point now) {
+    if (!_auto_tune.load() || now - _last_tune.load() < kTuneInterval) return;
+    _last_tune.store(now);
+
+    // Samples recorded between the two exchanges land in the next interval's
+    // sum or count only, close enough for an average
+    uint64_t latency_count = _latency_count.exchange(0);
+    uint64_t latency_sum_us = _latency_sum_us.exchange(0);
+    uint64_t rate = _bytes_per_sec.load();
+    uint64_t tuned;
+    if (latency_count > 0 && latency_sum_us / latency_count > static_cast<uint64_t>(_target_latency.count())) {
+        tuned = std::max(_min_bytes_per_sec, rate / 2);
+    } else {
+        // Reads within target, or no reads to protect: speed up
+        tuned = std::min(_max_bytes_per_sec, rate + std::max<uint64_t>(1, rate / 4));
+    }
+    if (tuned != rate) {
+        std::cout << "DEBUG: RateLimiter tuned from " << rate << " to " << tuned << " bytes/sec" << std::endl;
+        _bytes_per_sec.store(tuned);
+        _available = std::min(_available, static_cast<double>(burstBytes()));
+        _cv.notify_all();
+    }
+}
+
+uint64_t RateLimiter::totalBytesThrough(IoPriority priority) const {
+    return _total_bytes[static_cast<int>(priority)].load();
+}
+
+} // namespace kv
@@ -0,0 +1,136 @@
+#include "kv/row_cache.hpp"
+#include <algorithm>
+#include <functional>
+
+namespace kv {
+
+namespace {
+// Rough per-row bookkeeping cost: list node, hash node, strings' headers
+constexpr size_t kRowOverhead = 96;
+}
+
+RowCache::RowCache(size_t capacity_bytes, size_t shard_count)
+    : _shards(std::max<size_t>(shard_count, 1)),
+      _hits(0),
+      _misses(0)
+{
+    for (auto& shard : _shards) {
+        shard.capacity = capacity_bytes / _shards.size();
+    }
+}
+
+RowCache::Shard& RowCache::shardFor(const std::string& key) {
+    return _shards[std::hash<std::string>{}(key) % _shards.size()];
+}
+
+void RowCache::evict(Shard& shard, std::list<Row>::iterator it) {
+    shard.usage -= it->charge;
+    shard.rows.erase(it->key);
+    shard.lru.erase(it);
+}
+
+std::optional<std::optional<std::string>> RowCache::lookup(const std::string& key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.rows.find(key);
+    if (found == shard.rows.end()) {
+        _misses.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    // Move to the front of the LRU list
+    shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+    _hits.fetch_add(1, std::memory_order_relaxed);
+    return found->second->value;
+}
+
+uint64_t RowCache::generation(const std::string& key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.generation;
+}
+
+void RowCache::insert(const std::string& key, const std::optional<std::string>& value, SequenceNumber read_seq,
+                      uint64_t generation) {
+    size_t charge = key.size() + (value ? value->size() : 0) + kRowOverhead;
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // A write or a compaction changed this shard after the read began, the result may be stale
+    if (read_seq < shard.last_invalidation || generation != shard.generation || charge > shard.capacity) {
+        return;
+    }
+    auto found = shard.rows.find(key);
+    if (found != shard.rows.end()) {
+        evict(shard, found->second);
+    }
+    shard.lru.push_front(Row{key, value, charge});
+    shard.rows[key] = shard.lru.begin();
+    shard.usage += charge;
+
+    while (shard.usage > shard.capacity) {
+        evict(shard, std::prev(shard.lru.end()));
+    }
+}
+
+void RowCache::erase(const std::string& key, SequenceNumber write_seq) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.last_invalidation = std::max(shard.last_invalidation, write_seq);
+    auto found = shard.rows.find(key);
+    if (found != shard.rows.end()) {
+        evict(shard, found->second);
+    }
+}
+
+void RowCache::eraseRange(const std::string& begin, const std::string& end, SequenceNumber write_seq) {
+    // Keys are spread by hash, every shard may hold some of the range
+    for (auto& shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.last_invalidation = std::max(shard.last_invalidation, write_seq);
+        for (auto it = shard.lru.begin(); it != shard.lru.end();) {
+            auto current = it++;
+            if (begin <= current->key && current->key < end) evict(shard, current);
+        }
+    }
+}
+
+void RowCache::invalidate(const std::vector<std::string>& keys) {
+    for (const auto& key : keys) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.generation++;
+        auto found = shard.rows.find(key);
+        if (found != shard.rows.end()) {
+            evict(shard, found->second);
+        }
+    }
+}
+
+void RowCache::clear() {
+    for (auto& shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.generation++;
+        shard.lru.clear();
+        shard.rows.clear();
+        shard.usage = 0;
+    }
+}
+
+size_t RowCache::usage() const {
+    size_t total = 0;
+    for (const auto& shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.usage;
+    }
+    return total;
+}
+
+uint64_t RowCache::hits() const {
+    return _hits.load();
+}
+
+uint64_t RowCache::misses() const {
+    return _misses.load();
+}
+
+} // namespace kv
@@ -0,0 +1,108 @@
+#include "kv/snapshot.hpp"
+#include "kv/kv_store.hpp"
+#include <algorithm>
+
+namespace kv {
+
+SnapshotList::SnapshotList()
+    : _state(std::make_shared<State>())
+{}
+
+std::shared_ptr<const Snapshot> SnapshotList::acquire(SequenceNumber seq) {
+    {
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        _state->seqs.insert(seq);
+    }
+    return handOut(seq);
+}
+
+ReadPin::ReadPin(std::shared_ptr<const Snapshot> snapshot)
+    : _seq(snapshot->sequence()), _snapshot(std::move(snapshot))
+{}
+
+ReadPin::ReadPin(ReadPin&& other) noexcept
+    : _seq(other._seq), _slot(other._slot), _snapshot(std::move(other._snapshot))
+{
+    other._slot = nullptr;
+}
+
+ReadPin::~ReadPin() {
+    if (_slot) _slot->store(SnapshotList::kFreeSlot, std::memory_order_release);
+}
+
+ReadPin SnapshotList::pinLatest(const std::atomic<SequenceNumber>& last_sequence) {
+    // Threads start probing at different slots, so readers rarely share a cache line
+    static std::atomic<size_t> next_home{0};
+    thread_local size_t home = next_home.fetch_add(1);
+
+    SequenceNumber seq = last_sequence.load();
+    for (size_t i = 0; i < kReadSlots; ++i) {
+        std::atomic<SequenceNumber>& slot = _read_slots[(home + i) % kReadSlots].seq;
+        SequenceNumber free = kFreeSlot;
+        if (slot.load(std::memory_order_relaxed) != kFreeSlot || !slot.compare_exchange_strong(free, seq)) {
+            continue;
+        }
+        // Published before the check: a writer asking oldest() from now on sees seq.
+        // A writer that asked before published its sequence after it, so a newer
+        // sequence here means the pin may have come too late; pin that one instead.
+        for (SequenceNumber latest = last_sequence.load(); latest != seq; latest = last_sequence.load()) {
+            seq = latest;
+            slot.store(seq);
+        }
+        return ReadPin(&slot, seq);
+    }
+    // Every slot is busy, register like a snapshot; the list's lock orders it with oldest()
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    seq = last_sequence.load();
+    _state->seqs.insert(seq);
+    return ReadPin(handOut(seq));
+}
+
+std::shared_ptr<const Snapshot> SnapshotList::handOut(SequenceNumber seq) {
+    std::shared_ptr<State> state = _state;
+    return std::shared_ptr<const Snapshot>(new Snapshot(seq), [state](const Snapshot* snapshot) {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->seqs.erase(state->seqs.find(snapshot->sequence()));
+        }
+        delete snapshot;
+    });
+}
+
+std::vector<SequenceNumber> SnapshotList::live() const {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    return std::vector<SequenceNumber>(_state->seqs.begin(), _state->seqs.end());
+}
+
+SequenceNumber SnapshotList::oldest() const {
+    SequenceNumber oldest = kMaxSequenceNumber;
+    for (const auto& slot : _read_slots) {
+        oldest = std::min(oldest, slot.seq.load());
+    }
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    return _state->seqs.empty() ? oldest : std::min(oldest, *_state->seqs.begin());
+}
+
+// A version is visible to the smallest snapshot >= its seq (or to "now" if none is);
+// that reader sees the newest version in its stripe, everything older in the stripe is dead
+std::vector<Entry> retainVisible(std::vector<Entry> versions,
+                                 const std::vector<SequenceNumber>& snapshots,
+                                 bool bottommost)
+{
+    std::vector<Entry> kept;
+    size_t last_stripe = SIZE_MAX;
+    for (auto& entry : versions) {
+        size_t stripe = static_cast<size_t>(std::lower_bound(snapshots.begin(), snapshots.end(), entry.seq) - snapshots.begin());
+        if (stripe == last_stripe) continue;
+        last_stripe = stripe;
+        kept.push_back(std::move(entry));
+    }
+
+    // A tombstone with nothing older under it hides nothing
+    while (bottommost && !kept.empty() && kept.back().value == TOMB_STONE) {
+        kept.pop_back();
+    }
+    return kept;
+}
+
+} // namespace kv
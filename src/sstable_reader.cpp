@@ -1,150 +1,250 @@
 #include "kv/sstable_reader.hpp"
 #include <fstream>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <map>
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
 #include <iostream> // Added for logging
 
 namespace kv {
 
-// Constructor: scan all SSTables and build SSTableMeta vector
-SSTableReader::SSTableReader(const std::string& data_dir, std::shared_ptr<LockManager> lock_mgr) 
-    : _data_dir(data_dir), _lock_mgr(lock_mgr)
+// Constructor: the live table set was already recovered by the VersionSet
+SSTableReader::SSTableReader(const std::string& data_dir,
+                             std::shared_ptr<LockManager> lock_mgr,
+                             std::shared_ptr<VersionSet> versions)
+    : _data_dir(data_dir), _versions(std::move(versions)), _lock_mgr(lock_mgr), _io(IoBackend::create())
+{}
+
+std::shared_ptr<const Version>
+SSTableReader::currentVersion() const
 {
-    loadAllTables();
+    return _versions->current();
 }
 
-// Scan data_dir for *.sst files and record min/max key
-// Sort newest->oldest and cache in _tables
-void
-SSTableReader::loadAllTables()
+std::optional<std::string>
+SSTableReader::get(const std::string& key, SequenceNumber snapshot, SequenceNumber* found_seq) const
 {
-    namespace fs = std::filesystem;
-    _tables.clear();
-
-    // Iterate all sstables, build SSTableMeta for each and push to _tables
-    for (auto& entry : fs::directory_iterator(_data_dir)) {
-        if (entry.path().extension() != ".sst")  continue;
-
-        SSTableMeta meta;
-        meta.filename = entry.path().filename().string();
-
-        // Read one sst file, find min/max key
-        std::ifstream in(entry.path(), std::ios::binary);
-        if (!in.is_open()) continue;
-
-        // Parse key value pairs
-        bool first_key_not_locate = true;
-        while (true) {
-            uint32_t key_len;
-            if (!in.read(reinterpret_cast<char *>(&key_len), sizeof(key_len)))
-                break;
-            
-            // Get the key value
-            std::string key(key_len, '\0');
-            in.read(key.data(), key_len); // fills the string with key data
-
-            // Skip the value bytes
-            uint32_t value_len;
-            in.read(reinterpret_cast<char *>(&value_len), sizeof(value_len));
-            in.seekg(value_len, std::ios::cur);
-
-            if (first_key_not_locate) {
-                meta.max_key = meta.min_key = key;
-                first_key_not_locate = false;
-            } else {
-                if (key > meta.max_key) meta.max_key = key;
-                if (key < meta.min_key) meta.min_key = key;
-            }
+    // No lock: the version stays valid (and its files on disk) while we hold it
+    auto version = currentVersion();
+
+    std::cout << "DEBUG: SSTableReader::get() - Searching for key '" << key << "' across " << version->tables.size() << " SSTables" << std::endl;
+    
+    // SSTables whose min/max key range covers key, newest to oldest
+    std::vector<const TableFile*> candidates;
+    for (size_t id : version->range_index.find(key)) {
+        const TableFile* table_file = version->tables[id].get();
+        const SSTableMeta& table = table_file->meta();
+        std::cout << "DEBUG: SSTableReader::get() - Key might be in SSTable: " << table.filename 
+                  << " (range: " << table.min_key << " - " << table.max_key << ")" << std::endl;
+        candidates.push_back(table_file);
+    }
 
+    // Probe kLookupBatch candidates per round: their blocks are read as one batch,
+    // then checked newest first. Tables are ordered by level, then max_seq, and a
+    // deeper level never holds a newer version of a key, so once a version is
+    // found only tables that hold newer entries still need a look.
+    std::optional<Found> best;
+    const TableFile* best_table = nullptr;
+    const TableFile* first_probed = nullptr;
+    size_t probed = 0;
+    for (size_t begin = 0; begin < candidates.size(); begin += kLookupBatch) {
+        if (best && candidates[begin]->meta().max_seq <= best->seq) break;
+
+        size_t end = std::min(candidates.size(), begin + kLookupBatch);
+        std::vector<BlockRead> blocks;
+        for (size_t i = begin; i < end; ++i) {
+            if (best && candidates[i]->meta().max_seq <= best->seq) break;
+            if (auto block = candidates[i]->index()->findBlock(key)) {
+                blocks.push_back(BlockRead{candidates[i], block->first, block->second});
+            }
         }
 
-        // This sstable has at least one key value pair
-        if (!first_key_not_locate) {
-            _tables.push_back(std::move(meta));
+        auto data = readBlocks(blocks);
+        if (!first_probed && !blocks.empty()) first_probed = blocks.front().table;
+        probed += blocks.size();
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            if (!data[i]) continue;
+            auto found = searchBlock(*data[i], key, snapshot);
+            if (found && (!best || found->seq > best->seq)) {
+                best = std::move(found);
+                best_table = blocks[i].table;
+            }
         }
     }
 
-    // Sort the _tables in order of newest->oldest based on filename
-    std::sort(_tables.begin(),
-              _tables.end(),
-              [](auto &a, auto &b){
-                return a.filename > b.filename;
-              });
-}
-
-std::optional<std::string>
-SSTableReader::get(const std::string& key) const
-{
-    auto lock = _lock_mgr->acquireSSTableReadLock();
+    // The newest table probed had nothing for us, yet the lookup paid for it
+    if (probed > 1 && first_probed != best_table && first_probed->chargeSeek()) {
+        std::cout << "DEBUG: SSTableReader::get() - " << first_probed->meta().filename
+                  << " ran out of seek budget" << std::endl;
+        if (_seek_listener) _seek_listener();
+    }
 
-    std::cout << "DEBUG: SSTableReader::get() - Searching for key '" << key << "' across " << _tables.size() << " SSTables" << std::endl;
-    
-    // Search through all SSTables metas from newest to oldest
-    for (const auto& table : _tables) {
-        // Check if the key could be in this SSTable based on min/max key range
-        if (key >= table.min_key && key <= table.max_key) {
-            std::cout << "DEBUG: SSTableReader::get() - Key might be in SSTable: " << table.filename 
-                      << " (range: " << table.min_key << " - " << table.max_key << ")" << std::endl;
-            
-            if (auto result = readOneSSTable(table, key)) {
-                std::cout << "DEBUG: SSTableReader::get() - Found key '" << key << "' in SSTable: " << table.filename << std::endl;
-                return result;
-            }
-        }
+    if (best) {
+        std::cout << "DEBUG: SSTableReader::get() - Found key '" << key << "' in SSTable: " << best_table->meta().filename << std::endl;
+        if (found_seq) *found_seq = best->seq;
+        return std::move(best->value);
     }
-    
     std::cout << "DEBUG: SSTableReader::get() - Key '" << key << "' not found in any SSTable" << std::endl;
     return std::nullopt;
 }
 
-// Public method to refresh metadata (called after compaction/flush)
+std::vector<std::unique_ptr<Cursor>>
+SSTableReader::newCursors(SequenceNumber snapshot) const
+{
+    // Each cursor pins its TableFile, so compaction cannot unlink it mid-scan
+    auto version = currentVersion(); // Must outlive the loop, a temporary would not
+    std::vector<std::unique_ptr<Cursor>> cursors;
+    for (const auto& table : version->tables) {
+        cursors.push_back(newSSTableCursor(table, snapshot));
+    }
+    return cursors;
+}
+
+void SSTableReader::setSeekListener(std::function<void()> listener) {
+    _seek_listener = std::move(listener);
+}
+
+// Public method to pick up SSTables that were written outside flush/compaction
 void SSTableReader::refreshMetadata() {
-    std::cout << "DEBUG: SSTableReader::refreshMetadata() - Reloading SSTable metadata" << std::endl;
-    loadAllTables();
-    std::cout << "DEBUG: SSTableReader::refreshMetadata() - Loaded " << _tables.size() << " SSTable files" << std::endl;
+    std::cout << "DEBUG: SSTableReader::refreshMetadata() - Importing untracked SSTables" << std::endl;
+    size_t imported = _versions->importUntrackedTables();
+    std::cout << "DEBUG: SSTableReader::refreshMetadata() - Imported " << imported << ", now " << currentVersion()->tables.size() << " SSTable files" << std::endl;
 }
 
-std::optional<std::string>
-SSTableReader::readOneSSTable(const SSTableMeta& sstable_meta,
-                              const std::string& key) const
+std::vector<std::optional<std::string>>
+SSTableReader::readBlocks(const std::vector<BlockRead>& blocks) const
 {
-    std::string sstable_filepath = _data_dir + "/" + sstable_meta.filename;
-    std::ifstream in(sstable_filepath, std::ios::binary);
-    
-    if (!in.is_open()) {
-        std::cout << "DEBUG: SSTableReader::readOneSSTable() - Failed to open SSTable: " << sstable_filepath << std::endl;
-        return std::nullopt;
+    // Open every distinct SSTable once
+    std::map<const TableFile*, int> fds;
+    for (const auto& block : blocks) {
+        if (fds.count(block.table)) continue;
+        const std::string& path = block.table->path();
+        fds[block.table] = ::open(path.c_str(), O_RDONLY);
+        if (fds[block.table] < 0) {
+            std::cout << "DEBUG: SSTableReader::readBlocks() - Failed to open SSTable: " << path << std::endl;
+        }
     }
-    
-    std::cout << "DEBUG: SSTableReader::readOneSSTable() - Scanning SSTable: " << sstable_meta.filename << " for key: " << key << std::endl;
-    
-    // Read through all key-value pairs in the SSTable
-    while (true) {
-        uint32_t key_len;
-        if (!in.read(reinterpret_cast<char*>(&key_len), sizeof(key_len))) {
-            break; // End of file
+
+    std::vector<ReadRequest> requests;
+    std::vector<size_t> request_of(blocks.size(), SIZE_MAX);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        int fd = fds[blocks[i].table];
+        if (fd < 0) continue;
+        request_of[i] = requests.size();
+        requests.push_back(ReadRequest{fd, blocks[i].begin, static_cast<size_t>(blocks[i].end - blocks[i].begin), {}, false});
+    }
+
+    // All blocks are in flight together
+    _io->readBatch(requests);
+
+    for (auto& [table, fd] : fds) {
+        if (fd >= 0) ::close(fd);
+    }
+
+    std::vector<std::optional<std::string>> data(blocks.size());
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        if (request_of[i] != SIZE_MAX && requests[request_of[i]].ok) {
+            data[i] = std::move(requests[request_of[i]].data);
         }
-        
-        // Read the key
-        std::string current_key(key_len, '\0');
-        in.read(current_key.data(), key_len);
-        
-        // Read value length
+    }
+    return data;
+}
+
+// Walk the records of one block looking for key; versions of a key are newest first.
+// Lengths are checked against the bytes left, a corrupt record ends the search.
+std::optional<SSTableReader::Found>
+SSTableReader::searchBlock(const std::string& block, const std::string& key, SequenceNumber snapshot)
+{
+    auto corrupt = [&](size_t pos) {
+        std::cerr << "ERROR: SSTableReader::searchBlock() - Corrupt record at block offset " << pos
+                  << " while looking for key '" << key << "'" << std::endl;
+        return std::nullopt;
+    };
+
+    size_t pos = 0;
+    while (pos + sizeof(uint32_t) <= block.size()) {
+        size_t record = pos;
+        uint32_t key_len;
+        std::memcpy(&key_len, block.data() + pos, sizeof(key_len));
+        pos += sizeof(key_len);
+        if (block.size() - pos < size_t{key_len} + sizeof(SequenceNumber) + sizeof(uint32_t)) return corrupt(record);
+
+        std::string_view current_key(block.data() + pos, key_len);
+        pos += key_len;
+
+        SequenceNumber seq;
+        std::memcpy(&seq, block.data() + pos, sizeof(seq));
+        pos += sizeof(seq);
+
         uint32_t value_len;
-        in.read(reinterpret_cast<char*>(&value_len), sizeof(value_len));
-        
-        if (current_key == key) {
-            // Found the key, read and return the value
-            std::string value(value_len, '\0');
-            in.read(value.data(), value_len);
-            std::cout << "DEBUG: SSTableReader::readOneSSTable() - Found matching key in SSTable" << std::endl;
-            return value;
-        } else {
-            // Skip the value bytes
-            in.seekg(value_len, std::ios::cur);
+        std::memcpy(&value_len, block.data() + pos, sizeof(value_len));
+        pos += sizeof(value_len);
+        if (block.size() - pos < value_len) return corrupt(record);
+
+        if (current_key == key && seq <= snapshot) {
+            return Found{block.substr(pos, value_len), seq};
         }
+        if (current_key > key) {
+            break; // Keys are sorted, it is not in this block
+        }
+        pos += value_len;
     }
-    
-    std::cout << "DEBUG: SSTableReader::readOneSSTable() - Key not found in SSTable: " << sstable_meta.filename << std::endl;
     return std::nullopt;
 }
 
+std::vector<std::optional<std::string>>
+SSTableReader::multiGet(const std::vector<std::string>& sorted_keys, SequenceNumber snapshot) const
+{
+    auto version = currentVersion();
+
+    std::vector<std::optional<std::string>> results(sorted_keys.size());
+
+    // Step 1: plan - for every table, the blocks its in-range keys fall into
+    std::vector<BlockRead> blocks;
+    std::map<std::pair<const TableFile*, uint64_t>, size_t> block_slot; // (table, block begin) -> blocks[]
+    std::vector<std::vector<size_t>> candidates(sorted_keys.size());       // key -> blocks[], newest table first
+
+    for (const auto& table_file : version->tables) {
+        const SSTableMeta& table = table_file->meta();
+        // Keys are sorted, so the in-range keys are one contiguous run
+        auto first = std::lower_bound(sorted_keys.begin(), sorted_keys.end(), table.min_key);
+        auto last = std::upper_bound(first, sorted_keys.end(), table.max_key);
+        for (auto it = first; it != last; ++it) {
+            auto block = table_file->index()->findBlock(*it);
+            if (!block) continue;
+            auto [slot, inserted] = block_slot.emplace(std::make_pair(table_file.get(), block->first), blocks.size());
+            if (inserted) {
+                blocks.push_back(BlockRead{table_file.get(), block->first, block->second});
+            }
+            candidates[static_cast<size_t>(it - sorted_keys.begin())].push_back(slot->second);
+        }
+    }
+
+    std::cout << "DEBUG: SSTableReader::multiGet() - " << sorted_keys.size() << " keys need "
+              << blocks.size() << " block reads" << std::endl;
+
+    // Step 2: every candidate table is opened once and all blocks are read as one batch
+    auto data = readBlocks(blocks);
+
+    // Step 3: resolve every key against its candidate blocks, highest seq wins,
+    // ties go to the newer table
+    for (size_t k = 0; k < sorted_keys.size(); ++k) {
+        std::optional<Found> best;
+        for (size_t slot : candidates[k]) {
+            if (!data[slot]) continue;
+            if (best && blocks[slot].table->meta().max_seq <= best->seq) break;
+            auto found = searchBlock(*data[slot], sorted_keys[k], snapshot);
+            if (found && (!best || found->seq > best->seq)) {
+                best = std::move(found);
+            }
+        }
+        if (best) results[k] = std::move(best->value);
+    }
+    return results;
+}
+
 }
\ No newline at end of file
@@ -1,31 +1,160 @@
 #include "kv/sstable_writer.hpp"
+#include "kv/kv_store.hpp"
+#include <algorithm>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace kv {
 
-SSTableWriter::SSTableWriter(const std::string& data_dir)
-    : _data_dir(data_dir) 
+SSTableWriter::SSTableWriter(const std::string& data_dir, std::shared_ptr<RateLimiter> rate_limiter)
+    : _data_dir(data_dir),
+      _rate_limiter(std::move(rate_limiter))
 {
     std::filesystem::create_directories(data_dir);
 }
 
+void
+SSTableWriter::throttle(size_t bytes) const
+{
+    if (_rate_limiter && bytes > 0) _rate_limiter->request(bytes, IoPriority::High);
+}
+
 // turn file_number to 8 digits file name
 std::string
-SSTableWriter::makeFileName(uint64_t file_number) const 
+makeSSTableFileName(uint64_t file_number)
 {
     std::ostringstream oss; // use oss to build string
     oss << std::setw(8) << std::setfill('0') << file_number << ".sst";
     return oss.str();
 }
 
+std::optional<uint64_t>
+parseSSTableFileName(const std::string& filename)
+{
+    const std::string suffix = ".sst";
+    if (filename.size() <= suffix.size() ||
+        filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return std::nullopt;
+    }
+    std::string stem = filename.substr(0, filename.size() - suffix.size());
+    if (stem.find_first_not_of("0123456789") != std::string::npos) {
+        return std::nullopt;
+    }
+    return std::stoull(stem);
+}
+
 bool
 SSTableWriter::writeSSTable(const std::map<std::string, std::string>& sorted_data, uint64_t file_number)
 {
-    std::string file_name = _data_dir + "/" + makeFileName(file_number);
+    std::vector<Entry> entries;
+    entries.reserve(sorted_data.size());
+    for (const auto& [key, value] : sorted_data) {
+        entries.push_back(Entry{key, 0, value});
+    }
+    return writeSSTable(entries, file_number);
+}
+
+// Records per pipelined block, small enough that several blocks are in flight
+static constexpr size_t kEntriesPerBlock = 4096;
+
+// [key_len][key_data][seq][value_len][value_data]
+static void
+encodeRecord(std::string& out, const std::string& key, SequenceNumber seq, const std::string& value)
+{
+    uint32_t key_len = static_cast<uint32_t>(key.size());
+    uint32_t value_len = static_cast<uint32_t>(value.size());
+
+    out.append(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+    out.append(key);
+    out.append(reinterpret_cast<const char*>(&seq), sizeof(seq));
+    out.append(reinterpret_cast<const char*>(&value_len), sizeof(value_len));
+    out.append(value);
+}
+
+bool
+SSTableWriter::writeSSTable(const std::vector<Entry>& sorted_entries, uint64_t file_number)
+{
+    return writeFile(file_number, [&](std::ofstream& out) {
+        // write format: [key_len][key_data][seq][value_len][value_data]
+        std::string record;
+        size_t unthrottled = 0; // Written bytes not charged to the rate limiter yet
+        for (const auto& [key, seq, value] : sorted_entries) {
+            record.clear();
+            encodeRecord(record, key, seq, value);
+            out.write(record.data(), static_cast<std::streamsize>(record.size()));
+            unthrottled += record.size();
+            if (unthrottled >= SSTableBuilder::kBlockBytes) {
+                throttle(unthrottled);
+                unthrottled = 0;
+            }
+        }
+        throttle(unthrottled);
+        return true;
+    });
+}
+
+bool
+SSTableWriter::writeSSTable(const std::vector<EntryRef>& sorted_entries, uint64_t file_number, size_t threads)
+{
+    auto encodeBlock = [&sorted_entries](size_t begin) {
+        size_t end = std::min(sorted_entries.size(), begin + kEntriesPerBlock);
+        std::string block;
+        for (size_t i = begin; i < end; i++) {
+            encodeRecord(block, *sorted_entries[i].key, sorted_entries[i].seq, *sorted_entries[i].value);
+        }
+        return block;
+    };
+
+    return writeFile(file_number, [&](std::ofstream& out) {
+        // Keep up to `threads` blocks encoding ahead of the one being written
+        std::deque<std::future<std::string>> in_flight;
+        size_t next_block = 0;
+        while (next_block < sorted_entries.size() || !in_flight.empty()) {
+            while (next_block < sorted_entries.size() && in_flight.size() < std::max<size_t>(1, threads)) {
+                auto policy = threads > 1 ? std::launch::async : std::launch::deferred;
+                in_flight.push_back(std::async(policy, encodeBlock, next_block));
+                next_block += kEntriesPerBlock;
+            }
+            std::string block = in_flight.front().get();
+            in_flight.pop_front();
+            throttle(block.size());
+            out.write(block.data(), static_cast<std::streamsize>(block.size()));
+            if (!out) return false;
+        }
+        return true;
+    });
+}
+
+std::shared_ptr<TableFile>
+SSTableWriter::makeTable(const std::vector<EntryRef>& sorted_entries, uint64_t file_number, int level) const
+{
+    TableIndexBuilder builder;
+    for (const auto& entry : sorted_entries) {
+        auto value_len = static_cast<uint32_t>(entry.value->size());
+        builder.add(*entry.key, entry.seq, value_len, *entry.value == TOMB_STONE);
+    }
+
+    SSTableMeta meta;
+    meta.filename = makeSSTableFileName(file_number);
+    meta.file_number = file_number;
+    meta.level = level;
+    auto index = builder.finish(meta);
+    if (!index) return nullptr;
+    return std::make_shared<TableFile>(_data_dir + "/" + meta.filename, std::move(meta), std::move(index));
+}
+
+bool
+SSTableWriter::writeFile(uint64_t file_number, const std::function<bool(std::ofstream&)>& write_blocks)
+{
+    std::string file_name = _data_dir + "/" + makeSSTableFileName(file_number);
 
     // std::ios::binary: Opens the file for binary (raw byte) input/output, preventing character translations.
     // std::ios::trunc: If the file exists, its contents are deleted (truncated) before writing. If it doesn't exist, create a new empty file.
@@ -36,21 +165,119 @@ SSTableWriter::writeSSTable(const std::map<std::string, std::string>& sorted_dat
         return false;
     }
 
-    // write format: [key_len][key_data][value_len][value_data]
-    for (const auto& [key, value] : sorted_data) {
-        uint32_t key_len = static_cast<uint32_t>(key.size());
-        uint32_t value_len = static_cast<uint32_t>(value.size());
+    bool written = write_blocks(out);
+    out.flush();
+    out.close();
+    if (!written || !out) {
+        std::cerr << "[SSTableWriter] Failed writing file: " << file_name << "\n";
+        return false;
+    }
 
-        out.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
-        out.write(key.data(), key_len);
+    // ofstream cannot fsync, do it through a plain descriptor
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0 || ::fsync(fd) != 0) {
+        std::cerr << "[SSTableWriter] Cannot fsync file: " << file_name << "\n";
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    ::close(fd);
+    return true;
+}
 
-        out.write(reinterpret_cast<const char*>(&value_len), sizeof(value_len));
-        out.write(value.data(), value_len);
+SSTableBuilder::SSTableBuilder(const std::string& data_dir, uint64_t file_number,
+                               std::shared_ptr<RateLimiter> rate_limiter)
+    : _path(data_dir + "/" + makeSSTableFileName(file_number)),
+      _file_number(file_number),
+      _fd(-1),
+      _file_size(0),
+      _num_entries(0),
+      _finished(false),
+      _rate_limiter(std::move(rate_limiter))
+{
+    std::filesystem::create_directories(data_dir);
+    _fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) {
+        std::cerr << "[SSTableBuilder] Cannot open file: " << _path << "\n";
     }
+    _block.reserve(kBlockBytes + 4096);
+}
 
-    out.flush();
-    out.close();
+SSTableBuilder::~SSTableBuilder() {
+    if (_fd >= 0) ::close(_fd);
+    if (!_finished) {
+        std::error_code ec;
+        std::filesystem::remove(_path, ec);
+    }
+}
+
+bool
+SSTableBuilder::add(const std::string& key, SequenceNumber seq, const std::string& value)
+{
+    if (_fd < 0 || _finished) return false;
+    size_t before = _block.size();
+    encodeRecord(_block, key, seq, value);
+    _index.add(key, seq, static_cast<uint32_t>(value.size()), value == TOMB_STONE);
+    _file_size += _block.size() - before;
+    _num_entries++;
+    return _block.size() < kBlockBytes || flushBlock();
+}
+
+bool
+SSTableBuilder::flushBlock()
+{
+    const char* data = _block.data();
+    size_t left = _block.size();
+    if (_rate_limiter && left > 0) _rate_limiter->request(left, IoPriority::Low);
+    while (left > 0) {
+        ssize_t n = ::write(_fd, data, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[SSTableBuilder] Failed writing file: " << _path << "\n";
+            return false;
+        }
+        data += n;
+        left -= static_cast<size_t>(n);
+    }
+    _block.clear();
+    return true;
+}
+
+bool
+SSTableBuilder::finish()
+{
+    if (_fd < 0 || _finished) return false;
+    if (!flushBlock()) return false;
+    if (::fsync(_fd) != 0) {
+        std::cerr << "[SSTableBuilder] Cannot fsync file: " << _path << "\n";
+        return false;
+    }
+    ::close(_fd);
+    _fd = -1;
+    _finished = true;
     return true;
 }
 
-}
\ No newline at end of file
+uint64_t SSTableBuilder::fileNumber() const {
+    return _file_number;
+}
+
+uint64_t SSTableBuilder::fileSize() const {
+    return _file_size;
+}
+
+uint64_t SSTableBuilder::numEntries() const {
+    return _num_entries;
+}
+
+std::shared_ptr<TableFile> SSTableBuilder::table(int level) {
+    if (!_finished) return nullptr;
+    SSTableMeta meta;
+    meta.filename = std::filesystem::path(_path).filename().string();
+    meta.file_number = _file_number;
+    meta.level = level;
+    auto index = _index.finish(meta);
+    if (!index) return nullptr;
+    return std::make_shared<TableFile>(_path, std::move(meta), std::move(index));
+}
+
+}
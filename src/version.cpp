@@ -0,0 +1,207 @@
+#include "kv/version.hpp"
+#include "kv/kv_store.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace kv {
+
+TableIndexBuilder::TableIndexBuilder()
+    : _index(std::make_shared<KeyIndex>()),
+      _since_indexed(KeyIndex::kIndexInterval)
+{}
+
+// Index about every KeyIndex::kIndexInterval-th record, but only where a new key starts
+void TableIndexBuilder::add(const std::string& key, SequenceNumber seq, uint32_t value_len, bool tombstone) {
+    if (_since_indexed >= KeyIndex::kIndexInterval && (_record_count == 0 || key != _previous_key)) {
+        _index->add(key, _offset);
+        _since_indexed = 0;
+    }
+    _since_indexed++;
+    _offset += sizeof(uint32_t) + key.size() + sizeof(seq) + sizeof(value_len) + value_len;
+    if (tombstone) _meta.num_deletions++;
+
+    if (_record_count == 0) {
+        _meta.max_key = _meta.min_key = key;
+        _meta.max_seq = _meta.min_seq = seq;
+    } else {
+        if (key > _meta.max_key) _meta.max_key = key;
+        if (key < _meta.min_key) _meta.min_key = key;
+        _meta.max_seq = std::max(_meta.max_seq, seq);
+        _meta.min_seq = std::min(_meta.min_seq, seq);
+    }
+    _previous_key = key;
+    _record_count++;
+}
+
+std::shared_ptr<const KeyIndex> TableIndexBuilder::finish(SSTableMeta& meta) {
+    // This sstable has no key value pair
+    if (_record_count == 0) return nullptr;
+
+    _index->finish(_offset);
+    meta.min_key = _meta.min_key;
+    meta.max_key = _meta.max_key;
+    meta.max_seq = _meta.max_seq;
+    meta.min_seq = _meta.min_seq;
+    meta.file_size = _offset;
+    meta.num_entries = _record_count;
+    meta.num_deletions = _meta.num_deletions;
+    return _index;
+}
+
+// format: [key_len][key_data][seq][value_len][value_data]
+std::shared_ptr<const KeyIndex> scanSSTable(const std::string& path, SSTableMeta& meta)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return nullptr;
+
+    TableIndexBuilder builder;
+    while (true) {
+        uint32_t key_len;
+        if (!in.read(reinterpret_cast<char *>(&key_len), sizeof(key_len)))
+            break;
+
+        std::string key(key_len, '\0');
+        in.read(key.data(), key_len);
+        uint64_t seq;
+        in.read(reinterpret_cast<char *>(&seq), sizeof(seq));
+
+        // Skip the value bytes, only a value as long as a tombstone is worth a look
+        uint32_t value_len;
+        in.read(reinterpret_cast<char *>(&value_len), sizeof(value_len));
+        bool tombstone = false;
+        if (value_len == TOMB_STONE.size()) {
+            std::string value(value_len, '\0');
+            in.read(value.data(), value_len);
+            tombstone = value == TOMB_STONE;
+        } else {
+            in.seekg(value_len, std::ios::cur);
+        }
+        builder.add(key, seq, value_len, tombstone);
+    }
+    return builder.finish(meta);
+}
+
+TableFile::TableFile(std::string path, SSTableMeta meta, std::shared_ptr<const KeyIndex> index)
+    : _path(std::move(path)),
+      _meta(std::move(meta)),
+      _index(std::move(index)),
+      _obsolete(false),
+      _seeks(0)
+{}
+
+TableFile::TableFile(std::shared_ptr<TableFile> moved, int level)
+    : _path(moved->_path),
+      _meta(moved->_meta),
+      _obsolete(false),
+      _seeks(0),
+      _moved_from(std::move(moved))
+{
+    _meta.level = level;
+}
+
+TableFile::~TableFile() {
+    if (!_obsolete.load()) {
+        return;
+    }
+    if (_moved_from) {
+        // The original unlinks the file once the versions listing it are released too
+        _moved_from->markObsolete();
+        return;
+    }
+    std::error_code ec;
+    std::filesystem::remove(_path, ec);
+    if (ec) {
+        std::cerr << "ERROR: Failed to delete obsolete SSTable " << _path << ": " << ec.message() << std::endl;
+    } else {
+        std::cout << "DEBUG: Deleted obsolete SSTable: " << _meta.filename << std::endl;
+    }
+}
+
+const std::string& TableFile::path() const {
+    return _path;
+}
+
+const SSTableMeta& TableFile::meta() const {
+    return _meta;
+}
+
+std::shared_ptr<const KeyIndex> TableFile::index() const {
+    std::call_once(_index_once, [this] {
+        if (_index) return;
+        if (_moved_from) {
+            _index = _moved_from->index();
+            return;
+        }
+        SSTableMeta scanned;
+        _index = scanSSTable(_path, scanned);
+        if (!_index) {
+            std::cerr << "ERROR: Cannot index SSTable " << _path << ", treating it as empty" << std::endl;
+            auto empty = std::make_shared<KeyIndex>();
+            empty->finish(0);
+            _index = std::move(empty);
+        }
+    });
+    return _index;
+}
+
+void TableFile::markObsolete() {
+    _obsolete.store(true);
+}
+
+bool TableFile::chargeSeek() const {
+    return _seeks.fetch_add(1) + 1 == seekBudget();
+}
+
+uint64_t TableFile::seeksCharged() const {
+    return _seeks.load();
+}
+
+uint64_t TableFile::seekBudget() const {
+    return std::max<uint64_t>(100, _meta.file_size / (16 * 1024));
+}
+
+bool TableFile::seekBudgetExhausted() const {
+    return seeksCharged() >= seekBudget();
+}
+
+Version::Version(std::vector<std::shared_ptr<TableFile>> tables_newest_first,
+                 std::vector<RangeTombstone> tombstones)
+    : tables(std::move(tables_newest_first)),
+      range_tombstones(std::move(tombstones)),
+      range_tombstone_index(range_tombstones)
+{
+    std::vector<IntervalIndex::Interval> ranges;
+    ranges.reserve(tables.size());
+    for (size_t i = 0; i < tables.size(); ++i) {
+        ranges.push_back(IntervalIndex::Interval{tables[i]->meta().min_key, tables[i]->meta().max_key, i});
+    }
+    range_index.build(std::move(ranges));
+}
+
+std::vector<std::shared_ptr<TableFile>> Version::levelTables(int level) const {
+    std::vector<std::shared_ptr<TableFile>> out;
+    for (const auto& table : tables) {
+        if (table->meta().level == level) out.push_back(table);
+    }
+    return out;
+}
+
+uint64_t Version::levelBytes(int level) const {
+    uint64_t bytes = 0;
+    for (const auto& table : tables) {
+        if (table->meta().level == level) bytes += table->meta().file_size;
+    }
+    return bytes;
+}
+
+int Version::maxLevel() const {
+    int level = -1;
+    for (const auto& table : tables) {
+        level = std::max(level, table->meta().level);
+    }
+    return level;
+}
+
+} // namespace kv
@@ -0,0 +1,628 @@
+#include "kv/version_set.hpp"
+#include "kv/sstable_writer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace kv {
+
+namespace {
+
+// Field tags of an encoded VersionEdit
+enum Tag : uint8_t {
+    kNextFileNumber = 1,
+    kLastSequence   = 2,
+    kAddTable       = 3, // [u32 level][u64 file_number][str min_key][str max_key][u64 max_seq]
+    kRemoveTable    = 4, // [u64 file_number]
+    kAddRangeTombstone    = 5, // [u64 seq][str begin][str end]
+    kRemoveRangeTombstone = 6, // [u64 seq]
+    kAddTableWithMinSeq   = 7, // kAddTable fields, then [u64 min_seq]
+    kAddTableWithStats    = 8, // kAddTableWithMinSeq fields, then [u64 num_entries][u64 num_deletions]
+};
+
+void putU32(std::string& out, uint32_t v) { out.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+void putU64(std::string& out, uint64_t v) { out.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+void putString(std::string& out, const std::string& s) {
+    putU32(out, static_cast<uint32_t>(s.size()));
+    out.append(s);
+}
+
+// Bounds-checked decoding cursor over one payload
+struct Decoder {
+    const std::string& in;
+    size_t pos = 0;
+
+    template <typename T>
+    bool get(T& v) {
+        if (in.size() - pos < sizeof(T)) return false;
+        std::memcpy(&v, in.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+    bool getString(std::string& s) {
+        uint32_t len;
+        if (!get(len) || in.size() - pos < len) return false;
+        s.assign(in.data() + pos, len);
+        pos += len;
+        return true;
+    }
+};
+
+// FNV-1a, enough to tell a torn or garbled record from a complete one
+uint32_t checksum(const std::string& data) {
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool writeAll(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string frameRecord(const VersionEdit& edit) {
+    std::string payload = edit.encode();
+    std::string record;
+    putU32(record, static_cast<uint32_t>(payload.size()));
+    putU32(record, checksum(payload));
+    record.append(payload);
+    return record;
+}
+
+// Raise counter to at least value
+void raiseTo(std::atomic<uint64_t>& counter, uint64_t value) {
+    uint64_t current = counter.load();
+    while (current < value && !counter.compare_exchange_weak(current, value)) {}
+}
+
+} // namespace
+
+void VersionEdit::addTable(uint64_t file_number, int level) {
+    added.push_back(NewTable{file_number, level, {}, {}, 0});
+}
+
+void VersionEdit::addTable(std::shared_ptr<TableFile> table) {
+    const SSTableMeta& meta = table->meta();
+    added.push_back(NewTable{meta.file_number, meta.level, {}, {}, 0});
+    added.back().table = std::move(table);
+}
+
+void VersionEdit::removeTable(uint64_t file_number) {
+    removed.push_back(file_number);
+}
+
+void VersionEdit::moveTable(uint64_t file_number, int level) {
+    moved.push_back(NewTable{file_number, level, {}, {}, 0});
+}
+
+void VersionEdit::addRangeTombstone(const RangeTombstone& tombstone) {
+    added_range_tombstones.push_back(tombstone);
+}
+
+void VersionEdit::removeRangeTombstone(SequenceNumber seq) {
+    removed_range_tombstones.push_back(seq);
+}
+
+std::string VersionEdit::encode() const {
+    std::string out;
+    if (next_file_number) {
+        out.push_back(static_cast<char>(kNextFileNumber));
+        putU64(out, *next_file_number);
+    }
+    if (last_sequence) {
+        out.push_back(static_cast<char>(kLastSequence));
+        putU64(out, *last_sequence);
+    }
+    // Replay applies removes before adds, so a moved table comes back at its new level
+    std::vector<NewTable> listed = added;
+    listed.insert(listed.end(), moved.begin(), moved.end());
+    for (const auto& table : listed) {
+        out.push_back(static_cast<char>(kAddTableWithStats));
+        putU32(out, static_cast<uint32_t>(table.level));
+        putU64(out, table.file_number);
+        putString(out, table.min_key);
+        putString(out, table.max_key);
+        putU64(out, table.max_seq);
+        putU64(out, table.min_seq);
+        putU64(out, table.num_entries);
+        putU64(out, table.num_deletions);
+    }
+    std::vector<uint64_t> unlisted = removed;
+    for (const auto& table : moved) unlisted.push_back(table.file_number);
+    for (uint64_t number : unlisted) {
+        out.push_back(static_cast<char>(kRemoveTable));
+        putU64(out, number);
+    }
+    for (const auto& tombstone : added_range_tombstones) {
+        out.push_back(static_cast<char>(kAddRangeTombstone));
+        putU64(out, tombstone.seq);
+        putString(out, tombstone.begin);
+        putString(out, tombstone.end);
+    }
+    for (SequenceNumber seq : removed_range_tombstones) {
+        out.push_back(static_cast<char>(kRemoveRangeTombstone));
+        putU64(out, seq);
+    }
+    return out;
+}
+
+std::optional<VersionEdit> VersionEdit::decode(const std::string& payload) {
+    VersionEdit edit;
+    Decoder in{payload};
+    while (in.pos < payload.size()) {
+        uint8_t tag;
+        in.get(tag);
+        switch (tag) {
+        case kNextFileNumber: {
+            uint64_t v;
+            if (!in.get(v)) return std::nullopt;
+            edit.next_file_number = v;
+            break;
+        }
+        case kLastSequence: {
+            uint64_t v;
+            if (!in.get(v)) return std::nullopt;
+            edit.last_sequence = v;
+            break;
+        }
+        case kAddTable:
+        case kAddTableWithMinSeq:
+        case kAddTableWithStats: {
+            uint32_t level;
+            NewTable table;
+            if (!in.get(level) || !in.get(table.file_number) ||
+                !in.getString(table.min_key) || !in.getString(table.max_key) || !in.get(table.max_seq) ||
+                (tag != kAddTable && !in.get(table.min_seq)) ||
+                (tag == kAddTableWithStats && (!in.get(table.num_entries) || !in.get(table.num_deletions)))) {
+                return std::nullopt;
+            }
+            table.level = static_cast<int>(level);
+            edit.added.push_back(std::move(table));
+            break;
+        }
+        case kRemoveTable: {
+            uint64_t number;
+            if (!in.get(number)) return std::nullopt;
+            edit.removed.push_back(number);
+            break;
+        }
+        case kAddRangeTombstone: {
+            RangeTombstone tombstone;
+            if (!in.get(tombstone.seq) || !in.getString(tombstone.begin) || !in.getString(tombstone.end)) {
+                return std::nullopt;
+            }
+            edit.added_range_tombstones.push_back(std::move(tombstone));
+            break;
+        }
+        case kRemoveRangeTombstone: {
+            SequenceNumber seq;
+            if (!in.get(seq)) return std::nullopt;
+            edit.removed_range_tombstones.push_back(seq);
+            break;
+        }
+        default:
+            return std::nullopt;
+        }
+    }
+    return edit;
+}
+
+VersionSet::VersionSet(const std::string& data_dir)
+    : _data_dir(data_dir),
+      _manifest_path(data_dir + "/" + kManifestName),
+      _manifest_fd(-1),
+      _manifest_size(0),
+      _next_file_number(1),
+      _last_sequence(0),
+      _untracked_limit(1)
+{
+    std::filesystem::create_directories(data_dir);
+    recover();
+}
+
+VersionSet::~VersionSet() {
+    if (_manifest_fd >= 0) ::close(_manifest_fd);
+}
+
+std::shared_ptr<const Version> VersionSet::current() const {
+    return std::atomic_load(&_current);
+}
+
+uint64_t VersionSet::newFileNumber() {
+    return _next_file_number.fetch_add(1);
+}
+
+bool VersionSet::claimFileNumber(uint64_t number) {
+    uint64_t next = _next_file_number.load();
+    while (number >= next) {
+        if (_next_file_number.compare_exchange_weak(next, number + 1)) return true;
+    }
+    return false;
+}
+
+uint64_t VersionSet::lastSequence() const {
+    return _last_sequence.load();
+}
+
+void VersionSet::recover() {
+    std::vector<std::shared_ptr<TableFile>> tables;
+    std::vector<RangeTombstone> range_tombstones;
+
+    if (std::filesystem::exists(_manifest_path)) {
+        std::vector<VersionEdit::NewTable> live;
+        std::set<uint64_t> removed;
+        if (!replayManifest(live, removed, range_tombstones)) {
+            throw std::runtime_error("Cannot read MANIFEST: " + _manifest_path);
+        }
+
+        for (auto& entry : live) {
+            raiseTo(_next_file_number, entry.file_number + 1);
+            SSTableMeta meta;
+            meta.filename = makeSSTableFileName(entry.file_number);
+            meta.file_number = entry.file_number;
+            meta.level = entry.level;
+            meta.min_key = std::move(entry.min_key);
+            meta.max_key = std::move(entry.max_key);
+            meta.max_seq = entry.max_seq;
+            meta.min_seq = entry.min_seq;
+            meta.num_entries = entry.num_entries;
+            meta.num_deletions = entry.num_deletions;
+
+            std::string path = _data_dir + "/" + meta.filename;
+            if (!std::filesystem::exists(path)) {
+                std::cerr << "ERROR: SSTable " << meta.filename << " is in the MANIFEST but missing on disk" << std::endl;
+                continue;
+            }
+            std::error_code ec;
+            meta.file_size = std::filesystem::file_size(path, ec);
+            // Key range comes from the MANIFEST, the block index is built on first read
+            tables.push_back(std::make_shared<TableFile>(path, std::move(meta)));
+        }
+
+        // Tables compacted away before a crash may still be on disk
+        for (uint64_t number : removed) {
+            raiseTo(_next_file_number, number + 1);
+            std::error_code ec;
+            if (std::filesystem::remove(_data_dir + "/" + makeSSTableFileName(number), ec)) {
+                std::cout << "DEBUG: VersionSet::recover() - Deleted leftover SSTable: " << makeSSTableFileName(number) << std::endl;
+            }
+        }
+        std::cout << "DEBUG: VersionSet::recover() - Replayed MANIFEST: " << tables.size() << " live SSTables" << std::endl;
+    } else {
+        bootstrapFromDirectory(tables);
+        std::cout << "DEBUG: VersionSet::recover() - No MANIFEST, adopted " << tables.size() << " SSTables from directory" << std::endl;
+    }
+
+    // Sequence numbers continue past anything already stored in a table
+    for (const auto& table : tables) {
+        raiseTo(_last_sequence, table->meta().max_seq);
+    }
+    for (const auto& tombstone : range_tombstones) {
+        raiseTo(_last_sequence, tombstone.seq);
+    }
+
+    // Untracked files already on disk must never share a number with a new table
+    for (const auto& entry : std::filesystem::directory_iterator(_data_dir)) {
+        if (auto number = parseSSTableFileName(entry.path().filename().string())) {
+            raiseTo(_next_file_number, *number + 1);
+        }
+    }
+    _untracked_limit = _next_file_number.load();
+
+    install(std::move(tables), std::move(range_tombstones));
+    writeSnapshot();
+    std::cout << "DEBUG: VersionSet::recover() - Next file number " << _next_file_number.load()
+              << ", last sequence " << _last_sequence.load() << std::endl;
+}
+
+bool VersionSet::replayManifest(std::vector<VersionEdit::NewTable>& live, std::set<uint64_t>& removed,
+                                std::vector<RangeTombstone>& range_tombstones) {
+    std::ifstream in(_manifest_path, std::ios::binary);
+    if (!in.is_open()) return false;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::map<uint64_t, VersionEdit::NewTable> tables;
+    std::map<SequenceNumber, RangeTombstone> tombstones;
+    size_t pos = 0;
+    size_t edit_count = 0;
+    while (data.size() - pos >= 2 * sizeof(uint32_t)) {
+        uint32_t length, sum;
+        std::memcpy(&length, data.data() + pos, sizeof(length));
+        std::memcpy(&sum, data.data() + pos + sizeof(length), sizeof(sum));
+        if (data.size() - pos - 2 * sizeof(uint32_t) < length) {
+            break; // Torn tail
+        }
+        std::string payload = data.substr(pos + 2 * sizeof(uint32_t), length);
+        auto edit = checksum(payload) == sum ? VersionEdit::decode(payload) : std::nullopt;
+        if (!edit) {
+            std::cerr << "ERROR: Corrupt MANIFEST record at offset " << pos << ", ignoring the rest" << std::endl;
+            break;
+        }
+        pos += 2 * sizeof(uint32_t) + length;
+        edit_count++;
+
+        for (uint64_t number : edit->removed) {
+            tables.erase(number);
+            removed.insert(number);
+        }
+        for (auto& table : edit->added) {
+            removed.erase(table.file_number);
+            tables[table.file_number] = std::move(table);
+        }
+        for (SequenceNumber seq : edit->removed_range_tombstones) {
+            tombstones.erase(seq);
+        }
+        for (auto& tombstone : edit->added_range_tombstones) {
+            tombstones[tombstone.seq] = std::move(tombstone);
+        }
+        if (edit->next_file_number) raiseTo(_next_file_number, *edit->next_file_number);
+        if (edit->last_sequence) raiseTo(_last_sequence, *edit->last_sequence);
+    }
+
+    for (auto& [number, table] : tables) {
+        live.push_back(std::move(table));
+    }
+    for (auto& [seq, tombstone] : tombstones) {
+        range_tombstones.push_back(std::move(tombstone));
+    }
+    std::cout << "DEBUG: VersionSet::replayManifest() - Applied " << edit_count << " edits" << std::endl;
+    return true;
+}
+
+void VersionSet::bootstrapFromDirectory(std::vector<std::shared_ptr<TableFile>>& tables) {
+    for (const auto& entry : std::filesystem::directory_iterator(_data_dir)) {
+        auto number = parseSSTableFileName(entry.path().filename().string());
+        if (!number) continue;
+        raiseTo(_next_file_number, *number + 1);
+        if (auto table = loadTable(*number, 0)) {
+            tables.push_back(std::move(table));
+        }
+    }
+}
+
+void VersionSet::writeSnapshot() {
+    VersionEdit snapshot;
+    for (const auto& table : current()->tables) {
+        const SSTableMeta& meta = table->meta();
+        snapshot.added.push_back(VersionEdit::NewTable{meta.file_number, meta.level, meta.min_key, meta.max_key,
+                                                       meta.max_seq, meta.min_seq, meta.num_entries,
+                                                       meta.num_deletions});
+    }
+    snapshot.added_range_tombstones = current()->range_tombstones;
+    snapshot.next_file_number = _next_file_number.load();
+    snapshot.last_sequence = _last_sequence.load();
+
+    // Write aside and rename over, a crash leaves either the old or the new MANIFEST
+    std::string tmp_path = _manifest_path + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    std::string record = frameRecord(snapshot);
+    if (fd < 0 || !writeAll(fd, record) || ::fsync(fd) != 0) {
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("Cannot write MANIFEST snapshot: " + tmp_path);
+    }
+    ::close(fd);
+    std::filesystem::rename(tmp_path, _manifest_path);
+
+    // Make the rename itself durable
+    int dir_fd = ::open(_data_dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0) {
+        ::fsync(dir_fd);
+        ::close(dir_fd);
+    }
+
+    if (_manifest_fd >= 0) ::close(_manifest_fd);
+    _manifest_fd = ::open(_manifest_path.c_str(), O_WRONLY | O_APPEND);
+    if (_manifest_fd < 0) {
+        throw std::runtime_error("Cannot open MANIFEST: " + _manifest_path);
+    }
+    _manifest_size = record.size();
+}
+
+bool VersionSet::appendRecord(const VersionEdit& edit) {
+    if (_manifest_fd < 0) {
+        // An earlier failure left no usable MANIFEST, start a new one first
+        try {
+            writeSnapshot();
+        } catch (const std::exception& e) {
+            std::cerr << "ERROR: VersionSet::appendRecord() - " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    std::string record = frameRecord(edit);
+    if (writeAll(_manifest_fd, record) && ::fdatasync(_manifest_fd) == 0) {
+        _manifest_size += record.size();
+        return true;
+    }
+
+    // Replay stops at a torn record, so the edits appended after it would be
+    // lost: cut it off, or roll over to a new MANIFEST if that fails too
+    if (::ftruncate(_manifest_fd, static_cast<off_t>(_manifest_size)) == 0 && ::fdatasync(_manifest_fd) == 0) {
+        return false;
+    }
+    try {
+        writeSnapshot();
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: VersionSet::appendRecord() - " << e.what() << std::endl;
+        ::close(_manifest_fd);
+        _manifest_fd = -1;
+    }
+    return false;
+}
+
+void VersionSet::pruneObsolete() {
+    for (auto it = _obsolete.begin(); it != _obsolete.end();) {
+        std::error_code ec;
+        if (std::filesystem::exists(_data_dir + "/" + makeSSTableFileName(*it), ec) || ec) {
+            ++it;
+        } else {
+            it = _obsolete.erase(it);
+        }
+    }
+}
+
+std::shared_ptr<TableFile> VersionSet::loadTable(uint64_t file_number, int level) const {
+    SSTableMeta meta;
+    meta.filename = makeSSTableFileName(file_number);
+    meta.file_number = file_number;
+    meta.level = level;
+
+    std::string path = _data_dir + "/" + meta.filename;
+    auto index = scanSSTable(path, meta);
+    if (!index) return nullptr;
+    return std::make_shared<TableFile>(path, std::move(meta), std::move(index));
+}
+
+void VersionSet::install(std::vector<std::shared_ptr<TableFile>> tables, std::vector<RangeTombstone> range_tombstones) {
+    std::sort(tables.begin(),
+              tables.end(),
+              [](auto &a, auto &b){
+                // Shallower levels hold the newer versions of any key
+                if (a->meta().level != b->meta().level) return a->meta().level < b->meta().level;
+                if (a->meta().max_seq != b->meta().max_seq) return a->meta().max_seq > b->meta().max_seq;
+                return a->meta().file_number > b->meta().file_number;
+              });
+    std::atomic_store(&_current, std::shared_ptr<const Version>(
+        std::make_shared<Version>(std::move(tables), std::move(range_tombstones))));
+}
+
+void VersionSet::logAndApply(VersionEdit edit) {
+    // Outside the lock: only the liveness check, the MANIFEST append and the swap are serialized
+    for (auto& entry : edit.added) {
+        if (!entry.table) entry.table = loadTable(entry.file_number, entry.level);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::set<uint64_t> removed(edit.removed.begin(), edit.removed.end());
+    std::map<uint64_t, int> moves;
+    for (const auto& entry : edit.moved) moves[entry.file_number] = entry.level;
+    edit.moved.clear();
+    std::vector<std::shared_ptr<TableFile>> tables;
+    std::vector<std::shared_ptr<TableFile>> obsolete;
+    for (const auto& table : current()->tables) {
+        const SSTableMeta& meta = table->meta();
+        auto move = moves.find(meta.file_number);
+        if (removed.count(meta.file_number)) {
+            obsolete.push_back(table);
+        } else if (move != moves.end()) {
+            // Same file, new level: the metadata is copied, nothing is read
+            edit.moved.push_back(VersionEdit::NewTable{meta.file_number, move->second, meta.min_key, meta.max_key,
+                                                       meta.max_seq, meta.min_seq, meta.num_entries,
+                                                       meta.num_deletions});
+            tables.push_back(std::make_shared<TableFile>(table, move->second));
+        } else {
+            tables.push_back(table);
+        }
+    }
+
+    std::vector<VersionEdit::NewTable> added;
+    for (auto& entry : edit.added) {
+        raiseTo(_next_file_number, entry.file_number + 1);
+        auto table = std::move(entry.table);
+        if (!table) {
+            std::cout << "DEBUG: VersionSet::logAndApply() - Dropping empty SSTable: " << makeSSTableFileName(entry.file_number) << std::endl;
+            std::filesystem::remove(_data_dir + "/" + makeSSTableFileName(entry.file_number));
+            continue;
+        }
+        entry.min_key = table->meta().min_key;
+        entry.max_key = table->meta().max_key;
+        entry.max_seq = table->meta().max_seq;
+        entry.min_seq = table->meta().min_seq;
+        entry.num_entries = table->meta().num_entries;
+        entry.num_deletions = table->meta().num_deletions;
+        added.push_back(std::move(entry));
+        tables.push_back(std::move(table));
+    }
+    edit.added = std::move(added);
+
+    std::set<SequenceNumber> dropped(edit.removed_range_tombstones.begin(), edit.removed_range_tombstones.end());
+    std::vector<RangeTombstone> range_tombstones;
+    for (const auto& tombstone : current()->range_tombstones) {
+        if (!dropped.count(tombstone.seq)) range_tombstones.push_back(tombstone);
+    }
+    // Raised only once the edit is durable: a failed flush must not lend its
+    // sequence to the next edit, WAL replay would skip the lost writes
+    uint64_t last_sequence = _last_sequence.load();
+    for (const auto& tombstone : edit.added_range_tombstones) {
+        last_sequence = std::max<uint64_t>(last_sequence, tombstone.seq);
+        range_tombstones.push_back(tombstone);
+    }
+
+    if (edit.last_sequence) {
+        last_sequence = std::max<uint64_t>(last_sequence, *edit.last_sequence);
+    }
+    edit.next_file_number = _next_file_number.load();
+    edit.last_sequence = last_sequence;
+
+    // The edit is durable before anyone can see its version
+    if (!appendRecord(edit)) {
+        // Nothing refers to the added files, the caller writes new ones to retry
+        for (const auto& entry : edit.added) {
+            std::filesystem::remove(_data_dir + "/" + makeSSTableFileName(entry.file_number));
+        }
+        throw std::runtime_error("Failed to append edit to MANIFEST: " + _manifest_path);
+    }
+    raiseTo(_last_sequence, last_sequence);
+
+    for (const auto& table : obsolete) {
+        // Unlinked once the last version holding it is released
+        table->markObsolete();
+        _obsolete.insert(table->meta().file_number);
+    }
+    pruneObsolete();
+    install(std::move(tables), std::move(range_tombstones));
+    std::cout << "DEBUG: VersionSet::logAndApply() - +" << edit.added.size() << " -" << obsolete.size()
+              << " ~" << edit.moved.size() << " SSTables, " << current()->tables.size() << " live, "
+              << current()->range_tombstones.size() << " range tombstones" << std::endl;
+}
+
+size_t VersionSet::importUntrackedTables() {
+    VersionEdit edit;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::set<uint64_t> known;
+        for (const auto& table : current()->tables) known.insert(table->meta().file_number);
+        pruneObsolete();
+
+        std::set<uint64_t> untracked;
+        for (const auto& entry : std::filesystem::directory_iterator(_data_dir)) {
+            auto number = parseSSTableFileName(entry.path().filename().string());
+            if (!number || !entry.is_regular_file() || known.count(*number)) continue;
+            // Compacted away, only waiting for its last reader before being unlinked
+            if (_obsolete.count(*number)) continue;
+            untracked.insert(*number);
+        }
+        // Ascending, so claiming one number does not put the next one in the reserved range
+        for (uint64_t number : untracked) {
+            if (number >= _untracked_limit && !claimFileNumber(number)) {
+                // Handed out by newFileNumber(): a flush or compaction output
+                // still being written, or one that failed and was never installed
+                continue;
+            }
+            edit.addTable(number, 0);
+        }
+    }
+    if (edit.added.empty()) {
+        return 0;
+    }
+    logAndApply(edit);
+    return edit.added.size();
+}
+
+} // namespace kv